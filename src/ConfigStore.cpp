@@ -0,0 +1,266 @@
+#include "ConfigStore.h"
+#include "Trace.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+
+constexpr uint32_t kConfigMagic = 0x46434E50; // "PNCF"
+constexpr uint32_t kConfigFormatVersion = 1;
+
+struct ConfigHeader {
+    uint32_t magic;
+    uint32_t formatVersion;
+    uint32_t schemaVersion;
+    uint32_t recordCount;
+};
+
+template <typename T>
+void Append(std::string& out, T value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+#ifndef _WIN32
+bool WriteAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+#endif
+
+}
+
+bool ConfigReader::Read(void* out, size_t size) {
+    if (data.size() < size) {
+        return false;
+    }
+    memcpy(out, data.data(), size);
+    data.remove_prefix(size);
+    return true;
+}
+
+void EncodeConfigValue(std::string& out, bool value) {
+    Append<uint8_t>(out, value ? 1 : 0);
+}
+
+void EncodeConfigValue(std::string& out, int value) {
+    Append<int32_t>(out, value);
+}
+
+void EncodeConfigValue(std::string& out, unsigned value) {
+    Append<uint32_t>(out, value);
+}
+
+void EncodeConfigValue(std::string& out, float value) {
+    Append(out, value);
+}
+
+void EncodeConfigValue(std::string& out, const std::string& value) {
+    Append<uint32_t>(out, (uint32_t)value.size());
+    out += value;
+}
+
+bool DecodeConfigValue(ConfigReader& in, bool& value) {
+    uint8_t byte = 0;
+    if (!in.Read(&byte, sizeof(byte)) || byte > 1) {
+        return false;
+    }
+    value = byte != 0;
+    return true;
+}
+
+bool DecodeConfigValue(ConfigReader& in, int& value) {
+    int32_t decoded = 0;
+    if (!in.Read(&decoded, sizeof(decoded))) {
+        return false;
+    }
+    value = decoded;
+    return true;
+}
+
+bool DecodeConfigValue(ConfigReader& in, unsigned& value) {
+    uint32_t decoded = 0;
+    if (!in.Read(&decoded, sizeof(decoded))) {
+        return false;
+    }
+    value = decoded;
+    return true;
+}
+
+bool DecodeConfigValue(ConfigReader& in, float& value) {
+    return in.Read(&value, sizeof(value));
+}
+
+bool DecodeConfigValue(ConfigReader& in, std::string& value) {
+    uint32_t size = 0;
+    if (!in.Read(&size, sizeof(size)) || size > in.data.size()) {
+        return false;
+    }
+    value.assign(in.data.data(), size);
+    in.data.remove_prefix(size);
+    return true;
+}
+
+void ConfigEncoder::PutRaw(std::string_view key, std::string_view value) {
+    Append<uint16_t>(m_records, (uint16_t)key.size());
+    Append<uint32_t>(m_records, (uint32_t)value.size());
+    m_records.append(key.data(), key.size());
+    m_records.append(value.data(), value.size());
+    ++m_count;
+}
+
+std::string ConfigEncoder::Finish(uint32_t schemaVersion) const {
+    ConfigHeader header = {};
+    header.magic = kConfigMagic;
+    header.formatVersion = kConfigFormatVersion;
+    header.schemaVersion = schemaVersion;
+    header.recordCount = m_count;
+    std::string data((const char*)&header, sizeof(header));
+    data += m_records;
+    return data;
+}
+
+bool ConfigDecoder::Parse(std::string data) {
+    m_data = std::move(data);
+    m_values.clear();
+    m_schemaVersion = 0;
+
+    ConfigReader reader{ m_data };
+    ConfigHeader header;
+    if (!reader.Read(&header, sizeof(header)) || header.magic != kConfigMagic ||
+        header.formatVersion != kConfigFormatVersion) {
+        return false;
+    }
+    for (uint32_t i = 0; i < header.recordCount; ++i) {
+        uint16_t keyLength = 0;
+        uint32_t valueLength = 0;
+        if (!reader.Read(&keyLength, sizeof(keyLength)) || !reader.Read(&valueLength, sizeof(valueLength)) ||
+            reader.data.size() < (size_t)keyLength + valueLength) {
+            m_values.clear();
+            return false;
+        }
+        std::string_view key = reader.data.substr(0, keyLength);
+        m_values[key] = reader.data.substr(keyLength, valueLength);
+        reader.data.remove_prefix((size_t)keyLength + valueLength);
+    }
+    m_schemaVersion = header.schemaVersion;
+    return true;
+}
+
+bool ReadWholeFile(const std::string& path, std::string& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    TRACE_COUNT(BytesRead, data.size());
+    return !file.bad();
+}
+
+bool WriteFileAtomically(const std::string& path, const std::string& data) {
+    TRACE_SCOPE("WriteFileAtomically");
+    std::string tempPath = path + ".tmp";
+#ifdef _WIN32
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write(data.data(), data.size());
+        if (!file.flush()) {
+            return false;
+        }
+    }
+#else
+    // The data has to be on disk before the rename is, or a crash could leave an empty file behind
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = WriteAll(fd, data.data(), data.size()) && fsync(fd) == 0;
+    if (close(fd) != 0 || !written) {
+        unlink(tempPath.c_str());
+        return false;
+    }
+#endif
+    TRACE_COUNT(BytesWritten, data.size());
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    return !ec;
+}
+
+BackgroundWriter::BackgroundWriter(int delayMs) : m_delayMs(delayMs) {
+    m_worker = std::thread(&BackgroundWriter::Run, this);
+}
+
+BackgroundWriter::~BackgroundWriter() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    Flush();
+}
+
+void BackgroundWriter::Save(const std::string& path, std::string data) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending[path] = std::move(data);
+        m_lastSave = std::chrono::steady_clock::now();
+    }
+    m_wake.notify_one();
+}
+
+void BackgroundWriter::Flush() {
+    // Taking the write lock first means a batch the worker already took is on disk before we return
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    std::map<std::string, std::string> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pending.swap(m_pending);
+    }
+    for (const auto& file : pending) {
+        WriteFileAtomically(file.first, file.second);
+    }
+}
+
+void BackgroundWriter::Run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        if (m_pending.empty()) {
+            m_wake.wait(lock);
+            continue;
+        }
+        // Every Save pushes the deadline back, so a burst ends in one write
+        auto deadline = m_lastSave + std::chrono::milliseconds(m_delayMs);
+        if (std::chrono::steady_clock::now() < deadline) {
+            m_wake.wait_until(lock, deadline);
+            continue;
+        }
+        lock.unlock();
+        Flush();
+        lock.lock();
+    }
+}
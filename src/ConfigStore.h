@@ -0,0 +1,146 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Settings and UI state are stored as a flat list of key/value records:
+//
+//   header  { magic 'PNCF', format version, schema version, record count }
+//   record  { u16 key length, u32 value length, key bytes, value bytes }...
+//
+// Unknown keys are skipped and missing ones keep their defaults, so fields can
+// be added or dropped without touching the version. The schema version is for
+// changes in what an existing key means, which the reader migrates.
+
+// Cursor over one encoded value.
+struct ConfigReader {
+    std::string_view data;
+
+    bool Read(void* out, size_t size);
+    bool AtEnd() const { return data.empty(); }
+};
+
+// Encodings of the basic types. Other types add overloads of their own next to
+// their definition; ConfigEncoder/ConfigDecoder find them by argument-dependent lookup.
+void EncodeConfigValue(std::string& out, bool value);
+void EncodeConfigValue(std::string& out, int value);
+void EncodeConfigValue(std::string& out, unsigned value);
+void EncodeConfigValue(std::string& out, float value);
+void EncodeConfigValue(std::string& out, const std::string& value);
+bool DecodeConfigValue(ConfigReader& in, bool& value);
+bool DecodeConfigValue(ConfigReader& in, int& value);
+bool DecodeConfigValue(ConfigReader& in, unsigned& value);
+bool DecodeConfigValue(ConfigReader& in, float& value);
+bool DecodeConfigValue(ConfigReader& in, std::string& value);
+
+template <typename T>
+void EncodeConfigValue(std::string& out, const std::vector<T>& values) {
+    EncodeConfigValue(out, (unsigned)values.size());
+    for (const T& value : values) {
+        EncodeConfigValue(out, value);
+    }
+}
+
+template <typename T>
+bool DecodeConfigValue(ConfigReader& in, std::vector<T>& values) {
+    unsigned count = 0;
+    if (!DecodeConfigValue(in, count) || count > in.data.size()) {
+        return false;
+    }
+    values.clear();
+    for (unsigned i = 0; i < count; ++i) {
+        T value{};
+        if (!DecodeConfigValue(in, value)) {
+            return false;
+        }
+        values.push_back(std::move(value));
+    }
+    return true;
+}
+
+class ConfigEncoder {
+public:
+    template <typename T>
+    void Put(std::string_view key, const T& value) {
+        std::string bytes;
+        EncodeConfigValue(bytes, value);
+        PutRaw(key, bytes);
+    }
+    void PutRaw(std::string_view key, std::string_view value);
+
+    std::string Finish(uint32_t schemaVersion) const;
+
+private:
+    std::string m_records;
+    uint32_t m_count = 0;
+};
+
+class ConfigDecoder {
+public:
+    // Returns false if data isn't a config file in a format this build reads.
+    bool Parse(std::string data);
+    uint32_t SchemaVersion() const { return m_schemaVersion; }
+
+    // Leaves value as it was if key is missing or doesn't decode as a T.
+    template <typename T>
+    bool Get(std::string_view key, T& value) const {
+        auto it = m_values.find(key);
+        if (it == m_values.end()) {
+            return false;
+        }
+        ConfigReader reader{ it->second };
+        T decoded{};
+        if (!DecodeConfigValue(reader, decoded) || !reader.AtEnd()) {
+            return false;
+        }
+        value = std::move(decoded);
+        return true;
+    }
+
+private:
+    std::string m_data;
+    std::unordered_map<std::string_view, std::string_view> m_values; // into m_data
+    uint32_t m_schemaVersion = 0;
+};
+
+bool ReadWholeFile(const std::string& path, std::string& data);
+// Writes path + ".tmp", flushes it to disk and renames it over path, so a
+// crash leaves either the old file or the new one, never a truncated one.
+bool WriteFileAtomically(const std::string& path, const std::string& data);
+
+// Writes files on a background thread. Saving a path again before its earlier
+// save was written replaces it, so a burst of changes (typing, dragging the
+// window) costs one write once things have been quiet for delayMs.
+class BackgroundWriter {
+public:
+    explicit BackgroundWriter(int delayMs = 500);
+    ~BackgroundWriter();
+
+    BackgroundWriter(const BackgroundWriter&) = delete;
+    BackgroundWriter& operator=(const BackgroundWriter&) = delete;
+
+    void Save(const std::string& path, std::string data);
+    // Writes everything still pending on the calling thread and returns once it is on disk.
+    void Flush();
+
+private:
+    void Run();
+
+    int m_delayMs;
+    std::thread m_worker;
+    std::mutex m_writeMutex; // held while writing, so Flush() and the worker never write at once
+
+    std::mutex m_mutex; // guards everything below
+    std::condition_variable m_wake;
+    std::map<std::string, std::string> m_pending; // by path
+    std::chrono::steady_clock::time_point m_lastSave;
+    bool m_stop = false;
+};
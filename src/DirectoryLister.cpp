@@ -0,0 +1,175 @@
+#include "DirectoryLister.h"
+#include "Trace.h"
+
+#include <system_error>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+bool FileIdentitySet::Insert(const FileIdentity& id) {
+    Shard& shard = m_shards[((id.inode * 0x9E3779B97F4A7C15ull ^ id.device) >> 32) % kShards];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.ids.insert({ id.device, id.inode }).second;
+}
+
+void ListDirectory(const std::filesystem::path& path, std::vector<DirEntry>& entries, int64_t& mtime,
+    ScanCounters& counters, FileIdentity* identity) {
+    std::error_code ec;
+    if (!ListDirectory(path, entries, mtime, counters, ec, identity)) {
+        throw std::filesystem::filesystem_error("directory_iterator::directory_iterator", path, ec);
+    }
+}
+
+#ifdef __linux__
+
+namespace {
+int64_t ToNanoseconds(const struct timespec& time) {
+    return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+}
+
+bool ListDirectory(const std::filesystem::path& path, std::vector<DirEntry>& entries, int64_t& mtime,
+    ScanCounters& counters, std::error_code& ec, FileIdentity* identity) {
+    TRACE_SCOPE("ListDirectory");
+    entries.clear();
+    ec.clear();
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        ec = std::error_code(errno, std::generic_category());
+        return false;
+    }
+    counters.directoriesListed.fetch_add(1, std::memory_order_relaxed);
+    int fd = dirfd(dir);
+
+    uint64_t seen = 0;
+    uint64_t stats = 1;
+    // fstat on the open descriptor skips path resolution; done before reading so a
+    // change made mid-listing leaves a newer mtime on disk than the one recorded
+    struct stat dirStat;
+    bool statted = fstat(fd, &dirStat) == 0;
+    mtime = statted ? ToNanoseconds(dirStat.st_mtim) : 0;
+    if (identity && statted) {
+        identity->device = dirStat.st_dev;
+        identity->inode = dirStat.st_ino;
+    }
+    // readdir returns null both at the end and on failure; only errno tells them apart
+    errno = 0;
+    while (dirent* ent = readdir(dir)) {
+        const char* name = ent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        ++seen;
+
+        DirEntry entry;
+        entry.name = name;
+        unsigned char type = ent->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            ++stats;
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+                type = S_ISLNK(st.st_mode) ? DT_LNK : S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+            }
+        }
+        if (type == DT_DIR) {
+            entry.isDirectory = true;
+        } else if (type == DT_LNK) {
+            entry.isSymlink = true;
+            struct stat st;
+            ++stats;
+            entry.isDirectory = fstatat(fd, name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+        }
+        entries.push_back(std::move(entry));
+        errno = 0;
+    }
+    if (errno != 0) {
+        ec = std::error_code(errno, std::generic_category());
+    }
+    closedir(dir);
+
+    counters.entriesSeen.fetch_add(seen, std::memory_order_relaxed);
+    counters.statCalls.fetch_add(stats, std::memory_order_relaxed);
+    // Plus the open, the close and readdir's getdents, which it doesn't show:
+    // counted as the two a directory that fits one buffer takes, the second
+    // finding the end
+    uint64_t syscalls = stats + 4;
+    counters.syscalls.fetch_add(syscalls, std::memory_order_relaxed);
+    TRACE_COUNT(DirectoriesListed, 1);
+    TRACE_COUNT(EntriesSeen, seen);
+    TRACE_COUNT(Syscalls, syscalls);
+    return !ec;
+}
+
+bool GetDirectoryMTime(const std::filesystem::path& path, int64_t& mtime, ScanCounters& counters,
+    FileIdentity* identity) {
+    counters.statCalls.fetch_add(1, std::memory_order_relaxed);
+    counters.syscalls.fetch_add(1, std::memory_order_relaxed);
+    TRACE_COUNT(Syscalls, 1);
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    mtime = ToNanoseconds(st.st_mtim);
+    if (identity) {
+        identity->device = st.st_dev;
+        identity->inode = st.st_ino;
+    }
+    return true;
+}
+
+#else
+
+bool ListDirectory(const std::filesystem::path& path, std::vector<DirEntry>& entries, int64_t& mtime,
+    ScanCounters& counters, std::error_code& ec, FileIdentity* identity) {
+    TRACE_SCOPE("ListDirectory");
+    entries.clear();
+    if (!GetDirectoryMTime(path, mtime, counters, identity)) {
+        mtime = 0;
+    }
+    // No skip_permission_denied: a folder we can't read is a failure the caller
+    // records, not an empty folder
+    std::filesystem::directory_iterator it(path, ec);
+    if (ec) {
+        return false;
+    }
+    counters.directoriesListed.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t seen = 0;
+    for (std::filesystem::directory_iterator end; it != end; it.increment(ec)) {
+        const auto& item = *it;
+        ++seen;
+        // The find data already carries the attributes, so these don't touch the disk
+        std::error_code typeError;
+        DirEntry entry;
+        entry.name = item.path().filename().string();
+        entry.isDirectory = item.is_directory(typeError);
+        entry.isSymlink = item.is_symlink(typeError);
+        entries.push_back(std::move(entry));
+    }
+    counters.entriesSeen.fetch_add(seen, std::memory_order_relaxed);
+    TRACE_COUNT(DirectoriesListed, 1);
+    TRACE_COUNT(EntriesSeen, seen);
+    return !ec;
+}
+
+bool GetDirectoryMTime(const std::filesystem::path& path, int64_t& mtime, ScanCounters& counters,
+    FileIdentity* identity) {
+    (void)identity; // std::filesystem has no file identity
+    counters.statCalls.fetch_add(1, std::memory_order_relaxed);
+    counters.syscalls.fetch_add(1, std::memory_order_relaxed);
+    TRACE_COUNT(Syscalls, 1);
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    mtime = (int64_t)time.time_since_epoch().count();
+    return true;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ScanCounters.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_set>
+#include <vector>
+
+// Which file a path refers to, whatever the route taken to it (symlinks, bind
+// mounts, overlapping roots). Only filled in on Linux; elsewhere it stays invalid.
+struct FileIdentity {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+
+    bool Valid() const { return inode != 0; }
+};
+
+// Thread-safe set of FileIdentity. Sharded so threads inserting different files
+// rarely wait on each other.
+class FileIdentitySet {
+public:
+    // Returns true if id wasn't in the set yet.
+    bool Insert(const FileIdentity& id);
+
+private:
+    struct Hash {
+        size_t operator()(const std::pair<uint64_t, uint64_t>& id) const {
+            return (size_t)(id.second * 0x9E3779B97F4A7C15ull ^ id.first);
+        }
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_set<std::pair<uint64_t, uint64_t>, Hash> ids;
+    };
+    static constexpr size_t kShards = 16;
+    Shard m_shards[kShards];
+};
+
+struct DirEntry {
+    std::string name;
+    bool isDirectory = false; // follows symlinks, like directory_entry::is_directory()
+    bool isSymlink = false;
+};
+
+// Lists path exactly once into entries (cleared first, "." and ".." skipped).
+// Entry types come from the listing itself (d_type on Linux, the find data on
+// Windows); a stat is only issued for symlinks and for filesystems that don't
+// report a type. mtime receives the directory's own modification time, taken
+// before the entries are read, and identity (if given) the directory's own
+// identity from the same stat. Returns false with ec set if path can't be
+// opened or reading it fails partway; entries are then incomplete.
+bool ListDirectory(const std::filesystem::path& path, std::vector<DirEntry>& entries, int64_t& mtime,
+    ScanCounters& counters, std::error_code& ec, FileIdentity* identity = nullptr);
+// As above, but throws std::filesystem::filesystem_error instead.
+void ListDirectory(const std::filesystem::path& path, std::vector<DirEntry>& entries, int64_t& mtime,
+    ScanCounters& counters, FileIdentity* identity = nullptr);
+
+// Modification time of a directory in the same units ListDirectory reports, and
+// optionally its identity. Returns false if it can't be read.
+bool GetDirectoryMTime(const std::filesystem::path& path, int64_t& mtime, ScanCounters& counters,
+    FileIdentity* identity = nullptr);
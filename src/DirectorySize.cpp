@@ -0,0 +1,348 @@
+#include "DirectorySize.h"
+
+#include "DirectoryLister.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <system_error>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+void DirectorySize::Add(const DirectorySize& other) {
+    apparentBytes += other.apparentBytes;
+    allocatedBytes += other.allocatedBytes;
+    files += other.files;
+    directories += other.directories;
+    modified = std::max(modified, other.modified);
+}
+
+namespace {
+
+void SortFolders(std::vector<FolderSize>& folders) {
+    std::stable_sort(folders.begin(), folders.end(), [](const FolderSize& a, const FolderSize& b) {
+        return a.size.allocatedBytes > b.size.allocatedBytes;
+    });
+}
+
+}
+
+#ifdef __linux__
+
+namespace {
+
+constexpr uint32_t kNoFolder = UINT32_MAX;
+
+struct EntryStat {
+    bool isDirectory = false;
+    bool isRegular = false;
+    uint64_t size = 0;
+    uint64_t blocks = 0; // 512-byte units
+    uint64_t links = 1;
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    int64_t modified = 0;
+};
+
+// statx where the kernel has it, fstatat otherwise. Either way relative to the
+// parent's descriptor and without following a trailing symlink.
+bool StatEntry(int dirFd, const char* name, EntryStat& out) {
+#ifdef STATX_BASIC_STATS
+    static std::atomic<bool> statxMissing{false};
+    if (!statxMissing.load(std::memory_order_relaxed)) {
+        struct statx stx;
+        unsigned mask = STATX_TYPE | STATX_SIZE | STATX_BLOCKS | STATX_NLINK | STATX_INO | STATX_MTIME;
+        if (statx(dirFd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC, mask, &stx) == 0) {
+            out.isDirectory = S_ISDIR(stx.stx_mode);
+            out.isRegular = S_ISREG(stx.stx_mode);
+            out.size = stx.stx_size;
+            out.blocks = stx.stx_blocks;
+            out.links = stx.stx_nlink;
+            out.device = ((uint64_t)stx.stx_dev_major << 32) | stx.stx_dev_minor;
+            out.inode = stx.stx_ino;
+            out.modified = stx.stx_mtime.tv_sec;
+            return true;
+        }
+        if (errno != ENOSYS) {
+            return false;
+        }
+        statxMissing = true;
+    }
+#endif
+    struct stat st;
+    if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT) != 0) {
+        return false;
+    }
+    out.isDirectory = S_ISDIR(st.st_mode);
+    out.isRegular = S_ISREG(st.st_mode);
+    out.size = (uint64_t)st.st_size;
+    out.blocks = (uint64_t)st.st_blocks;
+    out.links = st.st_nlink;
+    out.device = st.st_dev;
+    out.inode = st.st_ino;
+    out.modified = st.st_mtim.tv_sec;
+    return true;
+}
+
+// An open directory. Its subdirectories are opened relative to it from other
+// tasks, so it stays open until the last of them has done so.
+struct OpenDirectory {
+    DIR* dir = nullptr;
+    int fd = -1;
+
+    explicit OpenDirectory(DIR* d) : dir(d), fd(dirfd(d)) {}
+    ~OpenDirectory() { closedir(dir); }
+
+    OpenDirectory(const OpenDirectory&) = delete;
+    OpenDirectory& operator=(const OpenDirectory&) = delete;
+};
+
+// Shared by every task of one MeasureDirectory call, which outlives them all.
+struct Measurement {
+    WorkStealingPool& pool;
+    const std::atomic<bool>& cancel;
+    SizeProgress* progress;
+    FileIdentitySet links; // files with more than one link, so each is counted once
+
+    std::atomic<size_t> pending{0};
+    std::mutex mutex; // guards everything below
+    std::condition_variable finished;
+    DirectorySize total;
+    std::vector<FolderSize> folders;
+    uint64_t errors = 0;
+
+    Measurement(WorkStealingPool& p, const std::atomic<bool>& c, SizeProgress* progress)
+        : pool(p), cancel(c), progress(progress) {}
+
+    void Submit(std::shared_ptr<OpenDirectory> parent, std::string name, uint32_t folder);
+    void Visit(DIR* dir, uint32_t folder);
+    void Finish();
+};
+
+void Measurement::Submit(std::shared_ptr<OpenDirectory> parent, std::string name, uint32_t folder) {
+    pending.fetch_add(1);
+    pool.Submit([this, parent = std::move(parent), name = std::move(name), folder]() mutable {
+        if (!cancel.load(std::memory_order_relaxed)) {
+            int fd = openat(parent->fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            parent.reset(); // release the parent as soon as it isn't needed
+            DIR* dir = fd >= 0 ? fdopendir(fd) : nullptr;
+            if (dir) {
+                Visit(dir, folder);
+            } else {
+                if (fd >= 0) {
+                    close(fd);
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                ++errors;
+            }
+        }
+        Finish();
+    });
+}
+
+void Measurement::Visit(DIR* dir, uint32_t folder) {
+    TRACE_SCOPE("SizeDirectory");
+    auto directory = std::make_shared<OpenDirectory>(dir);
+    bool isRoot = folder == kNoFolder;
+
+    // Summed locally and merged once, so the lock is taken once per directory
+    DirectorySize local;
+    uint64_t localErrors = 0;
+    uint64_t seen = 0;
+    std::vector<FolderSize> newFolders;
+    std::vector<std::string> subdirectories;
+    while (dirent* ent = readdir(dir)) {
+        const char* name = ent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        ++seen;
+        EntryStat st;
+        if (!StatEntry(directory->fd, name, st)) {
+            ++localErrors;
+            continue;
+        }
+        if (st.links > 1 && !st.isDirectory && !links.Insert({ st.device, st.inode })) {
+            continue; // another link to a file already counted
+        }
+
+        DirectorySize entry;
+        entry.allocatedBytes = st.blocks * 512;
+        entry.modified = st.modified;
+        if (st.isDirectory) {
+            entry.directories = 1;
+            subdirectories.push_back(name);
+        } else {
+            entry.apparentBytes = st.size;
+            entry.files = st.isRegular ? 1 : 0;
+        }
+        if (isRoot && st.isDirectory) {
+            newFolders.push_back({ name, entry });
+        } else {
+            local.Add(entry);
+        }
+    }
+
+    TRACE_COUNT(DirectoriesListed, 1);
+    TRACE_COUNT(EntriesSeen, seen);
+    TRACE_COUNT(Syscalls, seen + 2); // a stat per entry, plus the open and close
+    if (progress) {
+        progress->directories.fetch_add(1, std::memory_order_relaxed);
+        progress->files.fetch_add(local.files, std::memory_order_relaxed);
+        progress->allocatedBytes.fetch_add(local.allocatedBytes, std::memory_order_relaxed);
+    }
+
+    uint32_t firstFolder = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        errors += localErrors;
+        if (isRoot) {
+            total.Add(local);
+            firstFolder = (uint32_t)folders.size();
+            for (FolderSize& newFolder : newFolders) {
+                total.Add(newFolder.size);
+                folders.push_back(std::move(newFolder));
+            }
+        } else {
+            total.Add(local);
+            folders[folder].size.Add(local);
+        }
+    }
+
+    for (size_t i = 0; i < subdirectories.size(); ++i) {
+        Submit(directory, std::move(subdirectories[i]), isRoot ? firstFolder + (uint32_t)i : folder);
+    }
+}
+
+void Measurement::Finish() {
+    // Under the lock, so the waiter can't see zero and destroy this before the notify
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pending.fetch_sub(1) == 1) {
+        finished.notify_all();
+    }
+}
+
+}
+
+bool MeasureDirectory(const std::string& path, WorkStealingPool& pool, const std::atomic<bool>& cancel,
+    SizeReport& report, SizeProgress* progress) {
+    TRACE_SCOPE("MeasureDirectory");
+    report = SizeReport();
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        report.errors = 1;
+        return !cancel.load();
+    }
+
+    Measurement measurement(pool, cancel, progress);
+    struct stat st;
+    if (fstat(dirfd(dir), &st) == 0) {
+        measurement.total.allocatedBytes = (uint64_t)st.st_blocks * 512;
+        measurement.total.modified = st.st_mtim.tv_sec;
+    }
+    // The root is listed here; everything below it runs on the pool
+    measurement.pending = 1;
+    measurement.Visit(dir, kNoFolder);
+    measurement.Finish();
+    {
+        std::unique_lock<std::mutex> lock(measurement.mutex);
+        measurement.finished.wait(lock, [&] { return measurement.pending.load() == 0; });
+    }
+
+    report.total = measurement.total;
+    report.folders = std::move(measurement.folders);
+    report.errors = measurement.errors;
+    SortFolders(report.folders);
+    return !cancel.load();
+}
+
+#else
+
+namespace {
+
+DirectorySize MeasureEntry(const std::filesystem::directory_entry& item, uint64_t& errors) {
+    DirectorySize size;
+    std::error_code ec;
+    if (item.is_symlink(ec) || !item.is_regular_file(ec)) {
+        return size;
+    }
+    uint64_t bytes = item.file_size(ec);
+    if (ec) {
+        ++errors;
+        return size;
+    }
+    size.apparentBytes = bytes;
+    size.allocatedBytes = bytes; // no portable way to ask for allocated blocks
+    size.files = 1;
+    auto time = item.last_write_time(ec);
+    if (!ec) {
+#ifdef _WIN32
+        // MSVC's file clock counts 100ns ticks from 1601
+        size.modified = (int64_t)(time.time_since_epoch().count() / 10000000) - 11644473600LL;
+#else
+        size.modified = (int64_t)std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+#endif
+    }
+    return size;
+}
+
+}
+
+bool MeasureDirectory(const std::string& path, WorkStealingPool& pool, const std::atomic<bool>& cancel,
+    SizeReport& report, SizeProgress* progress) {
+    TRACE_SCOPE("MeasureDirectory");
+    (void)pool;
+    report = SizeReport();
+    std::error_code ec;
+    for (std::filesystem::directory_iterator top(path, ec), end; !ec && top != end; top.increment(ec)) {
+        std::error_code entryError;
+        if (top->is_symlink(entryError) || !top->is_directory(entryError)) {
+            report.total.Add(MeasureEntry(*top, report.errors));
+            continue;
+        }
+
+        FolderSize folder;
+        folder.name = top->path().filename().string();
+        folder.size.directories = 1;
+        auto options = std::filesystem::directory_options::skip_permission_denied;
+        std::filesystem::recursive_directory_iterator it(top->path(), options, entryError);
+        for (std::filesystem::recursive_directory_iterator last; !entryError && it != last; it.increment(entryError)) {
+            if (cancel.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            std::error_code typeError;
+            if (it->is_directory(typeError) && !it->is_symlink(typeError)) {
+                ++folder.size.directories;
+                continue;
+            }
+            DirectorySize file = MeasureEntry(*it, report.errors);
+            folder.size.Add(file);
+            if (progress) {
+                progress->files.fetch_add(file.files, std::memory_order_relaxed);
+                progress->allocatedBytes.fetch_add(file.allocatedBytes, std::memory_order_relaxed);
+            }
+        }
+        if (entryError) {
+            ++report.errors;
+        }
+        report.total.Add(folder.size);
+        report.folders.push_back(std::move(folder));
+    }
+    if (ec) {
+        ++report.errors;
+    }
+    SortFolders(report.folders);
+    return !cancel.load();
+}
+
+#endif
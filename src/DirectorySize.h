@@ -0,0 +1,52 @@
+#pragma once
+
+#include "WorkStealingPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Totals for everything under a directory.
+struct DirectorySize {
+    uint64_t apparentBytes = 0;  // sum of file sizes, as ls shows them
+    uint64_t allocatedBytes = 0; // disk space actually used, as du shows it; less than apparent for sparse files
+    uint64_t files = 0;
+    uint64_t directories = 0;
+    int64_t modified = 0;        // newest modification time of anything inside, in seconds since the epoch
+
+    void Add(const DirectorySize& other);
+};
+
+struct FolderSize {
+    std::string name;
+    DirectorySize size;
+};
+
+struct SizeReport {
+    DirectorySize total;
+    std::vector<FolderSize> folders; // one per top-level subdirectory, most allocated first
+    uint64_t errors = 0;             // directories or entries that couldn't be read
+};
+
+// Live counters updated while a measurement runs. Safe to read from any thread.
+struct SizeProgress {
+    std::atomic<uint64_t> files{0};
+    std::atomic<uint64_t> directories{0};
+    std::atomic<uint64_t> allocatedBytes{0};
+};
+
+// Measures the tree under path, the way du would: symlinks are not followed, a
+// file with several hard links inside the tree is counted once, and both the
+// apparent and the allocated size are reported, in total and per top-level
+// subdirectory. Unreadable entries are counted in errors and skipped.
+//
+// On Linux every directory is a task on pool, so measuring one large tree uses
+// all of its threads while other callers share them. Entries are stat'ed with
+// statx (fstatat on older kernels) relative to their directory's open
+// descriptor, so no path is ever resolved from the root again. Elsewhere the
+// tree is walked on the calling thread with std::filesystem.
+//
+// Blocks until done. Returns false, leaving report partial, if cancel was set first.
+bool MeasureDirectory(const std::string& path, WorkStealingPool& pool, const std::atomic<bool>& cancel,
+    SizeReport& report, SizeProgress* progress = nullptr);
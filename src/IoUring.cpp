@@ -0,0 +1,284 @@
+#include "IoUring.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#endif
+
+#ifdef __linux__
+
+namespace {
+
+int SetupRing(unsigned entries, io_uring_params& params) {
+    return (int)syscall(__NR_io_uring_setup, entries, &params);
+}
+
+int EnterRing(int fd, unsigned submit, unsigned waitFor, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, waitFor, flags, nullptr, 0);
+}
+
+int RegisterRing(int fd, unsigned opcode, void* arg, unsigned count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+// The kernel reads and writes the ring indexes concurrently with us
+uint32_t LoadAcquire(const uint32_t* value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+void StoreRelease(uint32_t* value, uint32_t newValue) {
+    __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+
+uint32_t* At(void* base, uint32_t offset) {
+    return (uint32_t*)((char*)base + offset);
+}
+
+bool SupportsOperations(int fd) {
+    const unsigned kOps = 256;
+    size_t size = sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op);
+    std::unique_ptr<char[]> buffer(new char[size]());
+    io_uring_probe* probe = (io_uring_probe*)buffer.get();
+    if (RegisterRing(fd, IORING_REGISTER_PROBE, probe, kOps) < 0) {
+        return false; // no probing before 5.6, which is also when OPENAT and STATX arrived
+    }
+    for (unsigned op : { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_CLOSE }) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+IoUring::~IoUring() {
+    Close();
+}
+
+void IoUring::Close() {
+    if (m_submissions) {
+        munmap(m_submissions, m_submissionsSize);
+    }
+    if (m_completionMemory) {
+        munmap(m_completionMemory, m_completionSize);
+    }
+    if (m_ringMemory) {
+        munmap(m_ringMemory, m_ringSize);
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+    m_fd = -1;
+    m_submissions = m_completionMemory = m_ringMemory = nullptr;
+    m_queued = m_inFlight = 0;
+}
+
+bool IoUring::Open(unsigned entries, std::error_code& ec) {
+    Close();
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    m_fd = SetupRing(entries, params);
+    if (m_fd < 0) {
+        ec = std::error_code(errno, std::generic_category());
+        return false;
+    }
+    if (!SupportsOperations(m_fd)) {
+        Close();
+        ec = std::make_error_code(std::errc::function_not_supported);
+        return false;
+    }
+
+    m_ringSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    size_t completionSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap && completionSize > m_ringSize) {
+        m_ringSize = completionSize;
+    }
+    m_ringMemory = mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+    void* completionBase = m_ringMemory;
+    if (m_ringMemory != MAP_FAILED && !singleMap) {
+        m_completionSize = completionSize;
+        m_completionMemory = mmap(nullptr, completionSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+            IORING_OFF_CQ_RING);
+        completionBase = m_completionMemory;
+    }
+    m_submissionsSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_submissions = mmap(nullptr, m_submissionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+        IORING_OFF_SQES);
+    if (m_ringMemory == MAP_FAILED || completionBase == MAP_FAILED || m_submissions == MAP_FAILED) {
+        ec = std::error_code(errno, std::generic_category());
+        if (m_ringMemory == MAP_FAILED) {
+            m_ringMemory = nullptr;
+        }
+        if (m_completionMemory == MAP_FAILED) {
+            m_completionMemory = nullptr;
+        }
+        if (m_submissions == MAP_FAILED) {
+            m_submissions = nullptr;
+        }
+        Close();
+        return false;
+    }
+
+    m_sqHead = At(m_ringMemory, params.sq_off.head);
+    m_sqTail = At(m_ringMemory, params.sq_off.tail);
+    m_sqMask = *At(m_ringMemory, params.sq_off.ring_mask);
+    m_sqArray = At(m_ringMemory, params.sq_off.array);
+    m_cqHead = At(completionBase, params.cq_off.head);
+    m_cqTail = At(completionBase, params.cq_off.tail);
+    m_cqMask = *At(completionBase, params.cq_off.ring_mask);
+    m_cqes = (char*)completionBase + params.cq_off.cqes;
+    // The completion ring is at least as large, so it can't overflow with this many in flight
+    m_entries = params.sq_entries;
+    return true;
+}
+
+void* IoUring::NextSubmission() {
+    if (m_fd < 0 || Free() == 0) {
+        return nullptr;
+    }
+    uint32_t tail = *m_sqTail + m_queued;
+    uint32_t index = tail & m_sqMask;
+    io_uring_sqe* sqe = (io_uring_sqe*)m_submissions + index;
+    memset(sqe, 0, sizeof(*sqe));
+    m_sqArray[index] = index;
+    ++m_queued;
+    return sqe;
+}
+
+bool IoUring::PrepareOpenDirectory(const char* path, uint64_t userData) {
+    io_uring_sqe* sqe = (io_uring_sqe*)NextSubmission();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)path;
+    sqe->open_flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::PrepareStatx(int dirfd, const char* path, int flags, unsigned mask, struct statx* out, uint64_t userData) {
+    io_uring_sqe* sqe = (io_uring_sqe*)NextSubmission();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = dirfd;
+    sqe->addr = (uint64_t)(uintptr_t)path;
+    sqe->len = mask;
+    sqe->off = (uint64_t)(uintptr_t)out;
+    sqe->statx_flags = (uint32_t)flags;
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::PrepareClose(int fd, uint64_t userData) {
+    io_uring_sqe* sqe = (io_uring_sqe*)NextSubmission();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::Submit(unsigned waitFor, std::error_code& ec) {
+    if (m_queued) {
+        StoreRelease(m_sqTail, *m_sqTail + m_queued);
+    }
+    // Includes anything an earlier call left unconsumed
+    unsigned submit = *m_sqTail - LoadAcquire(m_sqHead);
+    m_inFlight += m_queued;
+    m_queued = 0;
+    if (waitFor > m_inFlight) {
+        waitFor = m_inFlight;
+    }
+    if (submit == 0 && waitFor == 0) {
+        return true;
+    }
+    // With a ready completion in hand there's no need to wait
+    if (waitFor && LoadAcquire(m_cqTail) != *m_cqHead) {
+        waitFor = 0;
+        if (submit == 0) {
+            return true;
+        }
+    }
+    while (true) {
+        ++m_enters;
+        int result = EnterRing(m_fd, submit, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0);
+        if (result >= 0) {
+            return true;
+        }
+        if (errno != EINTR) {
+            ec = std::error_code(errno, std::generic_category());
+            return false;
+        }
+        // Interrupted while waiting; the submissions already went through
+        submit = 0;
+    }
+}
+
+bool IoUring::PopCompletion(uint64_t& userData, int& result) {
+    if (m_fd < 0) {
+        return false;
+    }
+    uint32_t head = *m_cqHead;
+    if (head == LoadAcquire(m_cqTail)) {
+        return false;
+    }
+    const io_uring_cqe* cqe = (const io_uring_cqe*)m_cqes + (head & m_cqMask);
+    userData = cqe->user_data;
+    result = cqe->res;
+    StoreRelease(m_cqHead, head + 1);
+    --m_inFlight;
+    return true;
+}
+
+bool IoUringAvailable() {
+    static const bool available = [] {
+        IoUring ring;
+        std::error_code ec;
+        return ring.Open(4, ec);
+    }();
+    return available;
+}
+
+#else
+
+IoUring::~IoUring() {}
+
+void IoUring::Close() {}
+
+bool IoUring::Open(unsigned, std::error_code& ec) {
+    ec = std::make_error_code(std::errc::function_not_supported);
+    return false;
+}
+
+void* IoUring::NextSubmission() { return nullptr; }
+bool IoUring::PrepareOpenDirectory(const char*, uint64_t) { return false; }
+bool IoUring::PrepareStatx(int, const char*, int, unsigned, struct statx*, uint64_t) { return false; }
+bool IoUring::PrepareClose(int, uint64_t) { return false; }
+
+bool IoUring::Submit(unsigned, std::error_code& ec) {
+    ec = std::make_error_code(std::errc::function_not_supported);
+    return false;
+}
+
+bool IoUring::PopCompletion(uint64_t&, int&) { return false; }
+
+bool IoUringAvailable() {
+    return false;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <system_error>
+
+struct statx;
+
+// A minimal io_uring submission/completion ring for batching filesystem calls,
+// set up with the raw system calls so there is no liburing dependency. Only the
+// operations the scanner needs are wrapped: opening a directory, statx and
+// close. Linux only; elsewhere Open() always fails.
+//
+// Prepare*() queue a request without entering the kernel and return false when
+// the ring has no room left; Submit() hands everything queued to the kernel in
+// one call. Anything a request points to (paths, statx buffers) must stay put
+// until its completion has been taken with PopCompletion(). One thread per ring.
+class IoUring {
+public:
+    IoUring() = default;
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Sets up a ring with room for entries requests in flight. Fails if the
+    // kernel lacks io_uring or any of the wrapped operations (before 5.6), or it
+    // is turned off (seccomp filters in containers, the io_uring_disabled sysctl).
+    bool Open(unsigned entries, std::error_code& ec);
+    bool IsOpen() const { return m_fd >= 0; }
+
+    // Requests that can still be queued before the ring is full, counting ones
+    // in flight whose completions haven't been taken yet.
+    unsigned Free() const { return m_entries - m_queued - m_inFlight; }
+    unsigned InFlight() const { return m_inFlight; }
+    // io_uring_enter calls made so far; Submit() skips the kernel when it has nothing to do.
+    uint64_t Enters() const { return m_enters; }
+
+    bool PrepareOpenDirectory(const char* path, uint64_t userData);
+    // flags are AT_* flags such as AT_SYMLINK_NOFOLLOW; path is relative to dirfd.
+    bool PrepareStatx(int dirfd, const char* path, int flags, unsigned mask, struct statx* out, uint64_t userData);
+    bool PrepareClose(int fd, uint64_t userData);
+
+    // Submits everything queued and waits until at least waitFor completions are
+    // ready. Returns false with ec set if the kernel refused.
+    bool Submit(unsigned waitFor, std::error_code& ec);
+    // Takes the next ready completion. result is what the system call would have
+    // returned, or -errno.
+    bool PopCompletion(uint64_t& userData, int& result);
+
+private:
+    void* NextSubmission();
+    void Close();
+
+    int m_fd = -1;
+    unsigned m_entries = 0;
+    unsigned m_queued = 0;   // prepared, not yet submitted
+    unsigned m_inFlight = 0; // submitted, completion not yet taken
+    uint64_t m_enters = 0;
+    void* m_ringMemory = nullptr;
+    size_t m_ringSize = 0;
+    void* m_completionMemory = nullptr; // separate mapping on kernels without IORING_FEAT_SINGLE_MMAP
+    size_t m_completionSize = 0;
+    void* m_submissions = nullptr;
+    size_t m_submissionsSize = 0;
+
+    // Into the mappings above
+    uint32_t* m_sqHead = nullptr;
+    uint32_t* m_sqTail = nullptr;
+    uint32_t m_sqMask = 0;
+    uint32_t* m_sqArray = nullptr;
+    uint32_t* m_cqHead = nullptr;
+    uint32_t* m_cqTail = nullptr;
+    uint32_t m_cqMask = 0;
+    void* m_cqes = nullptr;
+};
+
+// Whether an IoUring can be opened on this system. Probed once and cached.
+bool IoUringAvailable();
@@ -0,0 +1,651 @@
+#include "ProjectAnalysis.h"
+#include "ConfigStore.h"
+
+#include "DirectoryLister.h"
+#include "ProjectTypes.h"
+#include "Scanner.h"
+#include "Trace.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iterator>
+#include <numeric>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t kCacheMagic = 0x4E414E50; // "PNAN"
+constexpr uint32_t kCacheVersion = 1;
+// Levels of the asset folder that go into the manifest
+constexpr int kManifestDepth = 4;
+// Identity files are settings, not assets; anything bigger only has its start hashed
+constexpr size_t kMaxIdentityBytes = 16u << 20;
+// Signatures are split into bands for bucketing; projects sharing any band are compared
+constexpr size_t kBands = 4;
+constexpr size_t kBandSize = ProjectFingerprint::kSignatureSize / kBands;
+constexpr int64_t kSecondsPerMonth = 2629746; // a Gregorian year / 12
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+// Followed by the path
+struct CacheRecord {
+    int64_t directoryMTime;
+    uint64_t stamp;
+    int64_t walked;
+    uint64_t identity;
+    uint64_t manifestFiles;
+    uint64_t manifestBytes;
+    uint64_t signature[ProjectFingerprint::kSignatureSize];
+    uint64_t apparentBytes;
+    uint64_t allocatedBytes;
+    uint64_t files;
+    uint64_t directories;
+    int64_t modified;
+    uint32_t identityFiles;
+    uint32_t pathLength;
+};
+
+// xxHash64 (Yann Collet's algorithm): four independent multiply-rotate lanes
+// over 32-byte stripes, so it runs at memory speed on settings files.
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+uint64_t Rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t Read64(const unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t Read32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    return Rotl(acc, 31) * kPrime1;
+}
+
+uint64_t MergeRound(uint64_t acc, uint64_t value) {
+    acc ^= Round(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+
+uint64_t Hash64(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* end = p + size;
+    uint64_t hash;
+    if (size >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+        }
+        hash = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        hash = MergeRound(hash, v1);
+        hash = MergeRound(hash, v2);
+        hash = MergeRound(hash, v3);
+        hash = MergeRound(hash, v4);
+    } else {
+        hash = seed + kPrime5;
+    }
+    hash += size;
+    for (; p + 8 <= end; p += 8) {
+        hash ^= Round(0, Read64(p));
+        hash = Rotl(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= Read32(p) * kPrime1;
+        hash = Rotl(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * kPrime5;
+        hash = Rotl(hash, 11) * kPrime1;
+    }
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t Hash64(std::string_view text, uint64_t seed) {
+    return Hash64(text.data(), text.size(), seed);
+}
+
+// One of the signature's hash functions: a SplitMix64 finalizer over the entry hash
+uint64_t Permute(uint64_t hash, size_t function) {
+    hash += (function + 1) * 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+}
+
+// A read-only view of a whole file through the page cache, without copying it.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const fs::path& path) {
+        Close();
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER size;
+        bool opened = GetFileSizeEx(file, &size) != 0;
+        if (opened && size.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            m_data = mapping ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (mapping) {
+                CloseHandle(mapping); // the view keeps it alive
+            }
+            m_size = m_data ? (size_t)size.QuadPart : 0;
+            opened = m_data != nullptr;
+        }
+        CloseHandle(file);
+        return opened;
+#else
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        bool opened = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+        if (opened && info.st_size > 0) {
+            void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            opened = data != MAP_FAILED;
+            if (opened) {
+                m_data = (const char*)data;
+                m_size = (size_t)info.st_size;
+                madvise(data, m_size, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+        return opened;
+#endif
+    }
+
+    void Close() {
+        if (!m_data) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap((void*)m_data, m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// The files whose content identifies path as a project of its type, by name.
+std::vector<fs::path> IdentityFiles(const fs::path& path, ProjectType type) {
+    std::vector<fs::path> files;
+    std::vector<DirEntry> entries;
+    int64_t mtime = 0;
+    ScanCounters counters;
+    std::error_code ec;
+    if (type == ProjectType::Unity) {
+        fs::path settings = path / "ProjectSettings";
+        ListDirectory(settings, entries, mtime, counters, ec);
+        for (const DirEntry& entry : entries) {
+            if (!entry.isDirectory && entry.name.size() > 6 && entry.name.compare(entry.name.size() - 6, 6, ".asset") == 0) {
+                files.push_back(settings / entry.name);
+            }
+        }
+    } else if (const ProjectTypeDefinition* definition = CurrentProjectTypes()->Registry().Find(type)) {
+        ListDirectory(path, entries, mtime, counters, ec);
+        for (const DirEntry& entry : entries) {
+            if (entry.isDirectory) {
+                continue;
+            }
+            bool marker = std::any_of(definition->markers.begin(), definition->markers.end(), [&](const MarkerRule& rule) {
+                if (rule.kind == MarkerRule::Kind::File) {
+                    return entry.name == rule.name;
+                }
+                return rule.kind == MarkerRule::Kind::Extension && entry.name.size() > rule.name.size() &&
+                    entry.name.compare(entry.name.size() - rule.name.size(), rule.name.size(), rule.name) == 0;
+            });
+            if (marker) {
+                files.push_back(path / entry.name);
+            }
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+fs::path AssetFolder(const fs::path& path, ProjectType type) {
+    if (type == ProjectType::Unity) {
+        return path / "Assets";
+    }
+    if (type == ProjectType::Unreal) {
+        return path / "Content";
+    }
+    return path;
+}
+
+// Cheap to check: the names and mtimes of the identity files and the asset folder's mtime.
+uint64_t IdentityStamp(const fs::path& path, ProjectType type) {
+    ScanCounters counters;
+    uint64_t stamp = 0;
+    for (const fs::path& file : IdentityFiles(path, type)) {
+        int64_t mtime = 0;
+        GetDirectoryMTime(file, mtime, counters);
+        stamp = Hash64(file.filename().string(), stamp ^ (uint64_t)mtime);
+    }
+    int64_t assetsMTime = 0;
+    GetDirectoryMTime(AssetFolder(path, type), assetsMTime, counters);
+    return Hash64(&assetsMTime, sizeof(assetsMTime), stamp);
+}
+
+// Adds every file under folder down to kManifestDepth levels to fingerprint's manifest.
+void AddManifest(const fs::path& folder, const std::string& relative, int depth,
+    const std::vector<std::string>& skip, ProjectFingerprint& fingerprint) {
+    std::error_code ec;
+    std::string name;
+    for (fs::directory_iterator it(folder, ec), end; !ec && it != end; it.increment(ec)) {
+        name = relative;
+        name += it->path().filename().string();
+        std::error_code entryError;
+        if (it->is_symlink(entryError)) {
+            continue;
+        }
+        if (it->is_directory(entryError)) {
+            if (depth + 1 < kManifestDepth &&
+                    std::find(skip.begin(), skip.end(), it->path().filename().string()) == skip.end()) {
+                AddManifest(it->path(), name + "/", depth + 1, skip, fingerprint);
+            }
+            continue;
+        }
+        uint64_t size = it->file_size(entryError);
+        if (entryError) {
+            continue;
+        }
+        // Relative path and size: a copy has the same entries wherever it lives
+        uint64_t hash = Hash64(name, size);
+        for (size_t i = 0; i < ProjectFingerprint::kSignatureSize; ++i) {
+            fingerprint.signature[i] = std::min(fingerprint.signature[i], Permute(hash, i));
+        }
+        ++fingerprint.manifestFiles;
+        fingerprint.manifestBytes += size;
+    }
+}
+
+int64_t NowSeconds() {
+    return (int64_t)std::time(nullptr);
+}
+
+// Union-find over project indices, for merging duplicate pairs into groups.
+struct DisjointSets {
+    std::vector<uint32_t> parent;
+
+    explicit DisjointSets(size_t count) : parent(count) { std::iota(parent.begin(), parent.end(), 0u); }
+
+    uint32_t Find(uint32_t item) {
+        while (parent[item] != item) {
+            parent[item] = parent[parent[item]];
+            item = parent[item];
+        }
+        return item;
+    }
+    void Merge(uint32_t a, uint32_t b) { parent[Find(a)] = Find(b); }
+};
+
+bool LikelyDuplicates(const AnalyzedProject& a, const AnalyzedProject& b, double similarity) {
+    if (a.type != b.type) {
+        return false;
+    }
+    const ProjectFingerprint& x = a.fingerprint;
+    const ProjectFingerprint& y = b.fingerprint;
+    bool sameIdentity = x.identity != 0 && x.identity == y.identity;
+    if (x.manifestFiles == 0 || y.manifestFiles == 0) {
+        return sameIdentity && x.manifestFiles == y.manifestFiles;
+    }
+    double alike = x.Similarity(y);
+    return alike >= similarity || (sameIdentity && alike >= similarity / 2);
+}
+
+}
+
+double ProjectFingerprint::Similarity(const ProjectFingerprint& other) const {
+    if (manifestFiles == 0 || other.manifestFiles == 0) {
+        return 0.0;
+    }
+    size_t same = 0;
+    for (size_t i = 0; i < kSignatureSize; ++i) {
+        same += signature[i] == other.signature[i];
+    }
+    return (double)same / kSignatureSize;
+}
+
+bool ProjectFingerprint::Identical(const ProjectFingerprint& other) const {
+    return identity == other.identity && identityFiles == other.identityFiles && manifestFiles == other.manifestFiles &&
+        manifestBytes == other.manifestBytes && memcmp(signature, other.signature, sizeof(signature)) == 0;
+}
+
+ProjectFingerprint FingerprintProject(const std::string& path, ProjectType type) {
+    TRACE_SCOPE("FingerprintProject");
+    ProjectFingerprint fingerprint;
+    fs::path root(path);
+    MappedFile file;
+    for (const fs::path& identityFile : IdentityFiles(root, type)) {
+        if (!file.Open(identityFile)) {
+            continue;
+        }
+        size_t size = std::min(file.Size(), kMaxIdentityBytes);
+        TRACE_COUNT(BytesRead, size);
+        // Names as well as contents, so renaming a settings file counts as a change
+        uint64_t hash = Hash64(identityFile.filename().string(), fingerprint.identity);
+        fingerprint.identity = Hash64(file.Data(), size, hash);
+        ++fingerprint.identityFiles;
+    }
+    for (uint64_t& minimum : fingerprint.signature) {
+        minimum = UINT64_MAX;
+    }
+    AddManifest(AssetFolder(root, type), std::string(), 0, ParseNameList(kDefaultSkipDirectories), fingerprint);
+    return fingerprint;
+}
+
+bool ProjectAnalyzer::LoadCache(const std::string& path) {
+    m_cachePath = path;
+    m_entries.clear();
+
+    std::string data;
+    if (!ReadWholeFile(path, data)) {
+        return false;
+    }
+
+    CacheHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != kCacheMagic || header.version != kCacheVersion) {
+        return false;
+    }
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.entryCount; ++i) {
+        CacheRecord record;
+        if (data.size() - offset < sizeof(record)) {
+            return false;
+        }
+        memcpy(&record, data.data() + offset, sizeof(record));
+        offset += sizeof(record);
+        if (data.size() - offset < record.pathLength) {
+            return false;
+        }
+        Entry entry;
+        entry.directoryMTime = record.directoryMTime;
+        entry.stamp = record.stamp;
+        entry.walked = record.walked;
+        entry.fingerprint.identity = record.identity;
+        entry.fingerprint.identityFiles = record.identityFiles;
+        entry.fingerprint.manifestFiles = record.manifestFiles;
+        entry.fingerprint.manifestBytes = record.manifestBytes;
+        memcpy(entry.fingerprint.signature, record.signature, sizeof(record.signature));
+        entry.size.apparentBytes = record.apparentBytes;
+        entry.size.allocatedBytes = record.allocatedBytes;
+        entry.size.files = record.files;
+        entry.size.directories = record.directories;
+        entry.size.modified = record.modified;
+        m_entries[std::string(data.data() + offset, record.pathLength)] = entry;
+        offset += record.pathLength;
+    }
+    return true;
+}
+
+bool ProjectAnalyzer::SaveCache() const {
+    if (m_cachePath.empty()) {
+        return false;
+    }
+    CacheHeader header = {};
+    header.magic = kCacheMagic;
+    header.version = kCacheVersion;
+    header.entryCount = (uint32_t)m_entries.size();
+
+    std::string data;
+    data.append((const char*)&header, sizeof(header));
+    for (const auto& item : m_entries) {
+        const Entry& entry = item.second;
+        CacheRecord record = {};
+        record.directoryMTime = entry.directoryMTime;
+        record.stamp = entry.stamp;
+        record.walked = entry.walked;
+        record.identity = entry.fingerprint.identity;
+        record.identityFiles = entry.fingerprint.identityFiles;
+        record.manifestFiles = entry.fingerprint.manifestFiles;
+        record.manifestBytes = entry.fingerprint.manifestBytes;
+        memcpy(record.signature, entry.fingerprint.signature, sizeof(record.signature));
+        record.apparentBytes = entry.size.apparentBytes;
+        record.allocatedBytes = entry.size.allocatedBytes;
+        record.files = entry.size.files;
+        record.directories = entry.size.directories;
+        record.modified = entry.size.modified;
+        record.pathLength = (uint32_t)item.first.size();
+        data.append((const char*)&record, sizeof(record));
+        data.append(item.first);
+    }
+    return WriteFileAtomically(m_cachePath, data);
+}
+
+bool ProjectAnalyzer::Analyze(const std::vector<std::shared_ptr<const ScanIndex>>& indexes,
+    const AnalysisOptions& options, const std::atomic<bool>& cancel, AnalysisReport& report,
+    AnalysisProgress* progress) {
+    TRACE_SCOPE("AnalyzeProjects");
+    report = AnalysisReport();
+    int64_t now = options.now ? options.now : NowSeconds();
+
+    // Overlapping roots list a project more than once; it is analyzed once
+    std::vector<int64_t> directoryMTimes;
+    std::unordered_set<std::string> seen;
+    for (const std::shared_ptr<const ScanIndex>& index : indexes) {
+        if (!index) {
+            continue;
+        }
+        index->ForEachDirectory([&](const std::string& path, const ScanIndex::Record& record) {
+            if (ScanIndex::Type(record) == ProjectType::None || !seen.insert(path).second) {
+                return;
+            }
+            AnalyzedProject project;
+            project.path = path;
+            project.type = ScanIndex::Type(record);
+            report.projects.push_back(std::move(project));
+            directoryMTimes.push_back(record.mtime);
+        });
+    }
+    if (progress) {
+        progress->total = report.projects.size();
+        progress->done = 0;
+    }
+
+    // Sizes are measured on a shared pool; each worker here blocks on one MeasureDirectory at a time
+    unsigned threads = options.threadCount ? options.threadCount : std::max(1u, std::thread::hardware_concurrency());
+    WorkStealingPool sizePool(threads);
+    std::vector<Entry> updated(report.projects.size());
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> fingerprinted{0};
+    std::atomic<size_t> measured{0};
+    auto work = [&]() {
+        for (size_t i = next++; i < report.projects.size() && !cancel; i = next++) {
+            AnalyzedProject& project = report.projects[i];
+            Entry& entry = updated[i];
+            entry.directoryMTime = directoryMTimes[i];
+            entry.stamp = IdentityStamp(project.path, project.type);
+            auto cached = m_entries.find(project.path);
+            // The stamp only sees the top of the asset folder, so files added
+            // deeper in the manifest go unnoticed; fingerprints expire with sizes
+            project.reused = cached != m_entries.end() && cached->second.directoryMTime == entry.directoryMTime &&
+                cached->second.stamp == entry.stamp && now - cached->second.walked < options.remeasureAfterSeconds;
+            if (project.reused) {
+                entry.fingerprint = cached->second.fingerprint;
+                entry.size = cached->second.size;
+                entry.walked = cached->second.walked;
+            } else {
+                entry.fingerprint = FingerprintProject(project.path, project.type);
+                ++fingerprinted;
+                SizeReport size;
+                MeasureDirectory(project.path, sizePool, cancel, size);
+                entry.size = size.total;
+                entry.walked = now;
+                ++measured;
+            }
+            project.fingerprint = entry.fingerprint;
+            project.size = entry.size;
+            if (progress) {
+                ++progress->done;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    size_t workerCount = std::min<size_t>(threads, report.projects.size());
+    for (size_t i = 1; i < workerCount; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (cancel) {
+        return false;
+    }
+    report.fingerprinted = fingerprinted;
+    report.measured = measured;
+
+    // Projects under the analyzed roots that weren't found again are gone
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        bool under = std::any_of(indexes.begin(), indexes.end(), [&](const std::shared_ptr<const ScanIndex>& index) {
+            return index && IsSameOrUnder(it->first, index->Root());
+        });
+        it = under ? m_entries.erase(it) : std::next(it);
+    }
+    for (size_t i = 0; i < report.projects.size(); ++i) {
+        m_entries[report.projects[i].path] = updated[i];
+    }
+
+    // Candidate pairs share an identity or a signature band; only those are compared
+    std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+    for (uint32_t i = 0; i < report.projects.size(); ++i) {
+        const AnalyzedProject& project = report.projects[i];
+        uint64_t type = (uint64_t)project.type;
+        if (project.fingerprint.identity) {
+            buckets[Hash64(&project.fingerprint.identity, sizeof(uint64_t), type)].push_back(i);
+        }
+        if (project.fingerprint.manifestFiles) {
+            for (size_t band = 0; band < kBands; ++band) {
+                const uint64_t* values = project.fingerprint.signature + band * kBandSize;
+                buckets[Hash64(values, kBandSize * sizeof(uint64_t), type * kBands + band + 1)].push_back(i);
+            }
+        }
+    }
+    DisjointSets sets(report.projects.size());
+    for (const auto& bucket : buckets) {
+        const std::vector<uint32_t>& members = bucket.second;
+        for (size_t a = 0; a < members.size(); ++a) {
+            for (size_t b = a + 1; b < members.size(); ++b) {
+                if (sets.Find(members[a]) != sets.Find(members[b]) &&
+                        LikelyDuplicates(report.projects[members[a]], report.projects[members[b]], options.similarity)) {
+                    sets.Merge(members[a], members[b]);
+                }
+            }
+        }
+    }
+    std::vector<uint32_t> setSize(report.projects.size(), 0);
+    for (uint32_t i = 0; i < report.projects.size(); ++i) {
+        ++setSize[sets.Find(i)];
+    }
+    std::unordered_map<uint32_t, size_t> groupOf; // set representative -> index into duplicates
+    for (uint32_t i = 0; i < report.projects.size(); ++i) {
+        uint32_t set = sets.Find(i);
+        if (setSize[set] < 2) {
+            continue;
+        }
+        auto group = groupOf.find(set);
+        if (group == groupOf.end()) {
+            group = groupOf.emplace(set, report.duplicates.size()).first;
+            report.duplicates.emplace_back();
+        }
+        report.duplicates[group->second].projects.push_back(i);
+    }
+    for (DuplicateGroup& group : report.duplicates) {
+        // The copy changed last is the one to keep
+        std::stable_sort(group.projects.begin(), group.projects.end(), [&](size_t a, size_t b) {
+            return report.projects[a].size.modified > report.projects[b].size.modified;
+        });
+        const ProjectFingerprint& kept = report.projects[group.projects[0]].fingerprint;
+        group.identical = true;
+        for (size_t i = 1; i < group.projects.size(); ++i) {
+            const AnalyzedProject& copy = report.projects[group.projects[i]];
+            group.identical = group.identical && copy.fingerprint.Identical(kept);
+            group.reclaimableBytes += copy.size.allocatedBytes;
+        }
+    }
+    std::stable_sort(report.duplicates.begin(), report.duplicates.end(),
+        [](const DuplicateGroup& a, const DuplicateGroup& b) { return a.reclaimableBytes > b.reclaimableBytes; });
+
+    int64_t staleBefore = now - (int64_t)options.staleMonths * kSecondsPerMonth;
+    for (size_t i = 0; i < report.projects.size(); ++i) {
+        AnalyzedProject& project = report.projects[i];
+        // Nothing readable inside means nothing to go by
+        project.stale = project.size.modified > 0 && project.size.modified < staleBefore;
+        if (project.stale) {
+            report.stale.push_back(i);
+            report.staleBytes += project.size.allocatedBytes;
+        }
+    }
+    std::stable_sort(report.stale.begin(), report.stale.end(), [&](size_t a, size_t b) {
+        return report.projects[a].size.modified < report.projects[b].size.modified;
+    });
+    return true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "DirectorySize.h"
+#include "ProjectInfo.h"
+#include "ScanIndex.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What a project is made of, found cheaply enough to run over a whole share:
+// a hash of the files that identify it and a sketch of its asset manifest.
+struct ProjectFingerprint {
+    static constexpr size_t kSignatureSize = 16;
+
+    // Hash of the identity files, by name and content: ProjectSettings/*.asset
+    // for Unity, otherwise the files its type's markers match (the .uproject,
+    // project.godot, ...). 0 if there are none.
+    uint64_t identity = 0;
+    uint32_t identityFiles = 0;
+    // The manifest is every file in the asset folder (Assets, Content, or the
+    // project itself for other types) down to a few levels, by relative path
+    // and size. signature is its MinHash: for each of kSignatureSize hash
+    // functions, the smallest hash of any entry.
+    uint64_t manifestFiles = 0;
+    uint64_t manifestBytes = 0;
+    uint64_t signature[kSignatureSize] = {};
+
+    // Estimated share of manifest entries the two have in common, 0 to 1.
+    double Similarity(const ProjectFingerprint& other) const;
+    // Same identity files and, as far as the sketch can tell, the same assets.
+    bool Identical(const ProjectFingerprint& other) const;
+};
+
+// Fingerprints the project at path. Identity files are read through memory maps.
+ProjectFingerprint FingerprintProject(const std::string& path, ProjectType type);
+
+struct AnalysisOptions {
+    unsigned threadCount = 0; // projects analyzed at once, and size threads; 0 = one per hardware thread
+    int staleMonths = 12;     // a project nothing inside has changed for this long is stale
+    double similarity = 0.8;  // manifests at least this similar make likely duplicates
+    // Edits deep inside a project don't show in its directory's mtime, so sizes
+    // and fingerprints are taken again after this long even when nothing looks changed
+    int64_t remeasureAfterSeconds = 7 * 24 * 60 * 60;
+    int64_t now = 0; // seconds since the epoch; 0 = the current time
+};
+
+struct AnalyzedProject {
+    std::string path;
+    ProjectType type = ProjectType::None;
+    ProjectFingerprint fingerprint;
+    DirectorySize size;  // size.modified is the newest change anywhere inside
+    bool stale = false;
+    bool reused = false; // fingerprint came from the cache
+};
+
+struct DuplicateGroup {
+    std::vector<size_t> projects; // into AnalysisReport::projects, most recently changed first
+    bool identical = false;       // every copy is Identical() to the first
+    uint64_t reclaimableBytes = 0; // allocated size of every copy but the first
+};
+
+struct AnalysisReport {
+    std::vector<AnalyzedProject> projects;  // in index order
+    std::vector<DuplicateGroup> duplicates; // most reclaimable first
+    std::vector<size_t> stale;              // into projects, least recently changed first
+    uint64_t staleBytes = 0;
+    size_t fingerprinted = 0; // projects read this time; the rest came from the cache
+    size_t measured = 0;      // projects whose size was measured this time
+};
+
+// Live counters for a running Analyze(). Safe to read from any thread.
+struct AnalysisProgress {
+    std::atomic<size_t> total{0};
+    std::atomic<size_t> done{0};
+};
+
+// Finds likely duplicate and stale projects among those in a set of scan
+// indexes. Projects are fingerprinted and measured (MeasureDirectory) on
+// several threads at once.
+//
+// Incremental: results are kept in a cache file keyed by path, and a project
+// whose directory mtime in the index and whose identity files and asset folder
+// are unchanged keeps its cached fingerprint and size, so a re-run after a
+// rescan only reads the projects that changed. Both are taken again once older
+// than remeasureAfterSeconds, which catches edits deeper in the asset folder.
+//
+// Duplicates are found without comparing every pair: projects are bucketed by
+// identity hash and by bands of their signatures (locality-sensitive hashing),
+// and only projects sharing a bucket are compared. Two projects of the same
+// type are duplicates if their manifests are at least options.similarity
+// alike, or half that with the same identity files.
+class ProjectAnalyzer {
+public:
+    // Loads results saved by an earlier run; SaveCache() writes back to the same path.
+    bool LoadCache(const std::string& path);
+    bool SaveCache() const;
+
+    // Blocks until done. Returns false, leaving report partial, if cancel was set first.
+    bool Analyze(const std::vector<std::shared_ptr<const ScanIndex>>& indexes, const AnalysisOptions& options,
+        const std::atomic<bool>& cancel, AnalysisReport& report, AnalysisProgress* progress = nullptr);
+
+private:
+    struct Entry {
+        int64_t directoryMTime = 0; // from the scan index
+        uint64_t stamp = 0;         // names and mtimes of the identity files and the asset folder
+        int64_t walked = 0;         // when the size and fingerprint were taken, in seconds since the epoch
+        ProjectFingerprint fingerprint;
+        DirectorySize size;
+    };
+
+    std::string m_cachePath;
+    std::unordered_map<std::string, Entry> m_entries;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Stored as one byte in ProjectStore and in the scan index, so values must stay stable.
+// These are the built-in types; see ProjectTypeRegistry for how they are detected.
+enum class ProjectType : uint8_t {
+    None = 0,
+    Unity = 1,
+    Unreal = 2,
+    Godot = 3,
+    VisualStudio = 4,
+    CMake = 5,
+};
+
+// Types declared at runtime (ProjectTypeRegistry::AddCustom) are numbered from here.
+constexpr uint8_t kFirstCustomProjectType = 64;
+
+// Name of a built-in type or one set with SetProjectTypes; "" if unknown.
+const char* ProjectTypeName(ProjectType type);
+
+// A single project as reported by a walk. Lists of them are kept in a ProjectStore.
+struct ProjectInfo {
+    std::string name;
+    std::string path;
+    ProjectType type = ProjectType::None;
+};
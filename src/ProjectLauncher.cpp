@@ -0,0 +1,378 @@
+#include "ProjectLauncher.h"
+#include "ProjectMetadata.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <cerrno>
+extern char** environ;
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool IsFile(const std::string& path) {
+    std::error_code ec;
+    return !path.empty() && fs::is_regular_file(path, ec);
+}
+
+// Where the Unity Hub and the Epic Games launcher put a given engine version.
+std::vector<std::string> StandardEditorLocations(ProjectType type, const std::string& version) {
+    std::vector<std::string> locations;
+    if (version.empty()) {
+        return locations;
+    }
+#ifdef _WIN32
+    if (type == ProjectType::Unity) {
+        locations.push_back("C:\\Program Files\\Unity\\Hub\\Editor\\" + version + "\\Editor\\Unity.exe");
+    } else if (type == ProjectType::Unreal) {
+        std::string engine = "C:\\Program Files\\Epic Games\\UE_" + version + "\\Engine\\Binaries\\Win64\\";
+        locations.push_back(engine + "UnrealEditor.exe");
+        locations.push_back(engine + "UE4Editor.exe");
+    }
+#elif defined(__APPLE__)
+    if (type == ProjectType::Unity) {
+        locations.push_back("/Applications/Unity/Hub/Editor/" + version + "/Unity.app/Contents/MacOS/Unity");
+    } else if (type == ProjectType::Unreal) {
+        std::string engine = "/Users/Shared/Epic Games/UE_" + version + "/Engine/Binaries/Mac/";
+        locations.push_back(engine + "UnrealEditor.app/Contents/MacOS/UnrealEditor");
+        locations.push_back(engine + "UE4Editor.app/Contents/MacOS/UE4Editor");
+    }
+#else
+    const char* home = getenv("HOME");
+    if (type == ProjectType::Unity && home) {
+        locations.push_back(std::string(home) + "/Unity/Hub/Editor/" + version + "/Editor/Unity");
+    }
+#endif
+    return locations;
+}
+
+// Unreal opens a project through its .uproject file rather than the folder.
+std::string FindProjectFile(const std::string& path) {
+    std::error_code ec;
+    for (fs::directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() == ".uproject") {
+            return it->path().string();
+        }
+    }
+    return std::string();
+}
+
+#ifdef _WIN32
+
+// Quotes an argument the way CommandLineToArgvW splits it again.
+std::string QuoteArgument(const std::string& arg) {
+    std::string quoted = "\"";
+    size_t backslashes = 0;
+    for (char c : arg) {
+        if (c == '\\') {
+            ++backslashes;
+            continue;
+        }
+        quoted.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+        backslashes = 0;
+        quoted += c;
+    }
+    quoted.append(backslashes * 2, '\\');
+    quoted += '"';
+    return quoted;
+}
+
+bool Spawn(const std::vector<std::string>& args, void*& process, std::string& error) {
+    std::string commandLine;
+    for (const std::string& arg : args) {
+        commandLine += (commandLine.empty() ? "" : " ") + QuoteArgument(arg);
+    }
+    STARTUPINFOA startup = {};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION info = {};
+    if (!CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, FALSE, DETACHED_PROCESS, nullptr, nullptr,
+            &startup, &info)) {
+        error = std::system_category().message((int)GetLastError());
+        return false;
+    }
+    CloseHandle(info.hThread);
+    process = info.hProcess;
+    return true;
+}
+
+#else
+
+// Output goes to /dev/null and the child gets its own process group, so
+// neither a full pipe nor a Ctrl+C in our terminal can take an editor down.
+bool Spawn(const std::vector<std::string>& args, int& pid, std::string& error) {
+    std::vector<char*> argv;
+    for (const std::string& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attributes, &signals);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+
+    pid_t child = -1;
+    int result = posix_spawnp(&child, argv[0], &actions, &attributes, argv.data(), environ);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    if (result != 0) {
+        error = strerror(result);
+        return false;
+    }
+    pid = (int)child;
+    return true;
+}
+
+#endif
+
+}
+
+std::string FindEditor(const EditorPaths& paths, ProjectType type, const std::string& version) {
+    const std::map<std::string, std::string>* configured =
+        type == ProjectType::Unity ? &paths.unity : type == ProjectType::Unreal ? &paths.unreal : nullptr;
+    if (!configured) {
+        return std::string();
+    }
+    auto it = configured->find(version);
+    if (!version.empty() && it != configured->end() && IsFile(it->second)) {
+        return it->second;
+    }
+    for (const std::string& location : StandardEditorLocations(type, version)) {
+        if (IsFile(location)) {
+            return location;
+        }
+    }
+    it = configured->find("");
+    if (it != configured->end() && IsFile(it->second)) {
+        return it->second;
+    }
+    return std::string();
+}
+
+ProjectLauncher::ProjectLauncher() {
+    m_worker = std::thread(&ProjectLauncher::Run, this);
+}
+
+ProjectLauncher::~ProjectLauncher() {
+    Stop();
+}
+
+void ProjectLauncher::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_requests.clear();
+    }
+    m_wake.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+#ifdef _WIN32
+    for (Child& child : m_children) {
+        CloseHandle((HANDLE)child.process);
+    }
+#endif
+    m_children.clear();
+}
+
+void ProjectLauncher::SetEditorPaths(EditorPaths paths) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_paths = std::move(paths);
+}
+
+void ProjectLauncher::OpenInEditor(const std::string& path, ProjectType type, const std::string& engineVersion) {
+    m_starting.insert(path);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requests.push_back({ path, type, engineVersion, true });
+    }
+    m_wake.notify_one();
+}
+
+void ProjectLauncher::OpenFolder(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requests.push_back({ path, ProjectType::None, std::string(), false });
+    }
+    m_wake.notify_one();
+}
+
+bool ProjectLauncher::Drain() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_changed) {
+        return false;
+    }
+    m_changed = false;
+    m_open = m_running;
+    // Anything still queued or in the worker's current batch is still starting
+    std::set<std::string> queued(m_launching.begin(), m_launching.end());
+    for (const Request& request : m_requests) {
+        if (request.editor) {
+            queued.insert(request.path);
+        }
+    }
+    m_starting.swap(queued);
+    m_lastError = m_latestError;
+    return true;
+}
+
+void ProjectLauncher::Run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        if (m_requests.empty()) {
+            // Exits can only be noticed by asking, so check a few times a second while anything runs
+            if (m_children.empty()) {
+                m_wake.wait(lock);
+            } else {
+                m_wake.wait_for(lock, std::chrono::milliseconds(250));
+            }
+        }
+        if (m_stop) {
+            break;
+        }
+        std::vector<Request> requests;
+        requests.swap(m_requests);
+        for (const Request& request : requests) {
+            if (request.editor) {
+                m_launching.insert(request.path);
+            }
+        }
+        lock.unlock();
+
+        for (const Request& request : requests) {
+            Launch(request);
+        }
+        bool changed = ReapChildren() || !requests.empty();
+        if (changed && m_resultsCallback) {
+            m_resultsCallback();
+        }
+        lock.lock();
+    }
+}
+
+void ProjectLauncher::Launch(const Request& request) {
+    std::vector<std::string> args;
+    std::string error;
+    // Only the engines have an editor to find; anything else goes to the system's handler for the folder
+    if (request.editor && (request.type == ProjectType::Unity || request.type == ProjectType::Unreal)) {
+        std::string version = request.engineVersion;
+        if (version.empty()) {
+            int64_t stampMTime = 0;
+            version = ReadEngineVersion(request.path, request.type, stampMTime);
+        }
+        EditorPaths paths;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            paths = m_paths;
+        }
+        std::string editor = FindEditor(paths, request.type, version);
+        if (editor.empty()) {
+            error = std::string("No ") + ProjectTypeName(request.type) + " editor found for version " +
+                (version.empty() ? "(unknown)" : version) + "; set one in Settings > Editors";
+        } else if (request.type == ProjectType::Unity) {
+            args = { editor, "-projectPath", request.path };
+        } else {
+            std::string projectFile = FindProjectFile(request.path);
+            if (projectFile.empty()) {
+                error = "No .uproject file in " + request.path;
+            } else {
+                args = { editor, projectFile };
+            }
+        }
+    } else {
+#ifdef _WIN32
+        args = { "explorer.exe", request.path };
+#elif defined(__APPLE__)
+        args = { "open", request.path };
+#else
+        args = { "xdg-open", request.path };
+#endif
+    }
+
+    Child child;
+    child.path = request.path;
+    child.editor = request.editor;
+    if (error.empty()) {
+#ifdef _WIN32
+        bool spawned = Spawn(args, child.process, error);
+#else
+        bool spawned = Spawn(args, child.pid, error);
+#endif
+        if (!spawned) {
+            error = "Couldn't start " + args[0] + ": " + error;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (request.editor) {
+        m_launching.erase(m_launching.find(request.path));
+    }
+    m_changed = true;
+    m_latestError = error;
+    if (!error.empty()) {
+        return;
+    }
+    if (child.editor) {
+        m_running.insert(child.path);
+    }
+    m_children.push_back(std::move(child));
+}
+
+bool ProjectLauncher::ReapChildren() {
+    bool reaped = false;
+    for (size_t i = 0; i < m_children.size();) {
+        Child& child = m_children[i];
+#ifdef _WIN32
+        bool exited = WaitForSingleObject((HANDLE)child.process, 0) == WAIT_OBJECT_0;
+        if (exited) {
+            CloseHandle((HANDLE)child.process);
+        }
+#else
+        int status = 0;
+        pid_t result = waitpid(child.pid, &status, WNOHANG);
+        bool exited = result == child.pid || (result < 0 && errno == ECHILD);
+#endif
+        if (!exited) {
+            ++i;
+            continue;
+        }
+        reaped = reaped || child.editor;
+        m_children.erase(m_children.begin() + i);
+    }
+    if (!reaped) {
+        return false;
+    }
+
+    std::set<std::string> running;
+    for (const Child& child : m_children) {
+        if (child.editor) {
+            running.insert(child.path);
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running.swap(running);
+    m_changed = true;
+    return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ProjectInfo.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Editor executables by engine version: Unity's m_EditorVersion (e.g.
+// "2022.3.10f1") or Unreal's EngineAssociation (e.g. "5.3"). The "" entry of
+// each map is used for versions that have none of their own.
+struct EditorPaths {
+    std::map<std::string, std::string> unity;
+    std::map<std::string, std::string> unreal;
+};
+
+// The editor to open a project of this type and version with: the path set
+// for its version, else the standard install location of that version (Unity
+// Hub, Epic Games launcher), else the "" default. Empty if none exists on disk.
+std::string FindEditor(const EditorPaths& paths, ProjectType type, const std::string& version);
+
+// Starts editors and file managers without ever blocking the caller. Requests
+// are handed to a worker thread, which resolves the editor, spawns it
+// (posix_spawn on POSIX, CreateProcess on Windows) with its output discarded,
+// and reaps it once it exits. Editors are left running when the launcher is
+// destroyed.
+//
+// The UI thread calls Drain() once per frame to pick up what changed, then
+// asks IsOpen()/IsStarting() per row.
+class ProjectLauncher {
+public:
+    ProjectLauncher();
+    ~ProjectLauncher();
+
+    ProjectLauncher(const ProjectLauncher&) = delete;
+    ProjectLauncher& operator=(const ProjectLauncher&) = delete;
+
+    // Called from the worker thread when there is something for Drain(). Set it before the first request.
+    void SetResultsCallback(std::function<void()> callback) { m_resultsCallback = std::move(callback); }
+    // Used by requests made from now on.
+    void SetEditorPaths(EditorPaths paths);
+
+    // Opens the project at path in its engine's editor. engineVersion may be
+    // empty if it isn't known yet; it is then read from the project. Types without
+    // an engine editor (Godot, CMake, custom types) are opened like OpenFolder.
+    void OpenInEditor(const std::string& path, ProjectType type, const std::string& engineVersion);
+    // Shows path in the platform's file manager.
+    void OpenFolder(const std::string& path);
+
+    // UI thread only. Takes in launches, exits and errors; returns true if anything changed.
+    bool Drain();
+    // UI thread only. Whether an editor started from here has path open, or is still being started.
+    bool IsOpen(const std::string& path) const { return m_open.count(path) != 0; }
+    bool IsStarting(const std::string& path) const { return m_starting.count(path) != 0; }
+    size_t OpenCount() const { return m_open.size(); }
+    // UI thread only. Why the latest request failed; empty once a later one succeeds.
+    const std::string& LastError() const { return m_lastError; }
+
+    // Stops the worker. Running editors are not touched.
+    void Stop();
+
+private:
+    struct Request {
+        std::string path;
+        ProjectType type = ProjectType::None;
+        std::string engineVersion;
+        bool editor = false; // false: open the folder
+    };
+
+    // A process started by the worker, until it is reaped
+    struct Child {
+        std::string path;
+        bool editor = false;
+#ifdef _WIN32
+        void* process = nullptr;
+#else
+        int pid = -1;
+#endif
+    };
+
+    void Run();
+    void Launch(const Request& request);
+    bool ReapChildren();
+
+    std::thread m_worker;
+    std::function<void()> m_resultsCallback;
+    std::vector<Child> m_children; // worker thread only
+
+    // UI thread only
+    std::set<std::string> m_open;
+    std::set<std::string> m_starting;
+    std::string m_lastError;
+
+    std::mutex m_mutex; // guards everything below
+    std::condition_variable m_wake;
+    bool m_stop = false;
+    EditorPaths m_paths;
+    std::vector<Request> m_requests;
+    std::multiset<std::string> m_launching; // editor requests the worker has taken but not yet launched
+    std::set<std::string> m_running; // paths with an editor child alive
+    std::string m_latestError; // of the last request handled
+    bool m_changed = false;
+};
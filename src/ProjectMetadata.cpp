@@ -0,0 +1,443 @@
+#include "ProjectMetadata.h"
+#include "ConfigStore.h"
+
+#include "DirectoryLister.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+namespace {
+
+constexpr uint32_t kCacheMagic = 0x444D4E50; // "PNMD"
+constexpr uint32_t kCacheVersion = 2;
+// Queued requests beyond this are dropped, least urgent first
+constexpr size_t kMaxQueued = 1024;
+// Edits deep inside a project don't touch its directory's mtime, so sizes are re-measured at least this often
+constexpr int64_t kRewalkAfterSeconds = 24 * 60 * 60;
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct CacheSize {
+    uint64_t apparentBytes;
+    uint64_t allocatedBytes;
+    uint64_t files;
+    uint64_t directories;
+    int64_t modified;
+};
+
+// Followed by the path, the version, then folderCount CacheFolders each followed by its name
+struct CacheRecord {
+    int64_t directoryMTime;
+    int64_t stampMTime;
+    int64_t walked;
+    CacheSize total;
+    uint64_t errors;
+    uint32_t pathLength;
+    uint32_t versionLength;
+    uint32_t folderCount;
+    uint32_t reserved;
+};
+
+struct CacheFolder {
+    CacheSize size;
+    uint32_t nameLength;
+    uint32_t reserved;
+};
+
+CacheSize ToCache(const DirectorySize& size) {
+    return { size.apparentBytes, size.allocatedBytes, size.files, size.directories, size.modified };
+}
+
+DirectorySize FromCache(const CacheSize& cached) {
+    DirectorySize size;
+    size.apparentBytes = cached.apparentBytes;
+    size.allocatedBytes = cached.allocatedBytes;
+    size.files = cached.files;
+    size.directories = cached.directories;
+    size.modified = cached.modified;
+    return size;
+}
+
+std::string Trim(std::string_view text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string_view::npos) {
+        return std::string();
+    }
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return std::string(text.substr(begin, end - begin + 1));
+}
+
+// Value of a top-level string field in a .uproject file. Not a JSON parser: enough for a
+// field the editor writes on one line as "Key": "value".
+std::string JsonStringField(std::string_view json, std::string_view key) {
+    std::string quoted = "\"" + std::string(key) + "\"";
+    size_t at = json.find(quoted);
+    if (at == std::string_view::npos) {
+        return std::string();
+    }
+    at = json.find_first_not_of(" \t\r\n", at + quoted.size());
+    if (at == std::string_view::npos || json[at] != ':') {
+        return std::string();
+    }
+    at = json.find_first_not_of(" \t\r\n", at + 1);
+    if (at == std::string_view::npos || json[at] != '"') {
+        return std::string();
+    }
+    size_t end = json.find('"', at + 1);
+    if (end == std::string_view::npos) {
+        return std::string();
+    }
+    return std::string(json.substr(at + 1, end - at - 1));
+}
+
+int64_t NowSeconds() {
+    return (int64_t)std::time(nullptr);
+}
+
+}
+
+std::string ReadEngineVersion(const std::string& path, ProjectType type, int64_t& stampMTime) {
+    stampMTime = 0;
+    ScanCounters counters;
+    std::error_code ec;
+
+    if (type == ProjectType::Unity) {
+        std::filesystem::path versionFile = std::filesystem::path(path) / "ProjectSettings" / "ProjectVersion.txt";
+        std::ifstream file(versionFile);
+        if (!file.is_open()) {
+            return std::string();
+        }
+        GetDirectoryMTime(versionFile, stampMTime, counters);
+        std::string line;
+        while (std::getline(file, line)) {
+            TRACE_COUNT(BytesRead, line.size() + 1);
+            if (line.compare(0, 16, "m_EditorVersion:") == 0) {
+                return Trim(std::string_view(line).substr(16));
+            }
+        }
+        return std::string();
+    }
+
+    if (type == ProjectType::Unreal) {
+        for (std::filesystem::directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec)) {
+            if (it->path().extension() != ".uproject") {
+                continue;
+            }
+            std::ifstream file(it->path(), std::ios::binary);
+            if (!file.is_open()) {
+                continue;
+            }
+            GetDirectoryMTime(it->path(), stampMTime, counters);
+            std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            TRACE_COUNT(BytesRead, json.size());
+            // Empty or a GUID for source builds; shown as-is either way
+            return JsonStringField(json, "EngineAssociation");
+        }
+    }
+    return std::string();
+}
+
+MetadataPipeline::MetadataPipeline(unsigned threadCount) {
+    threadCount = std::max(1u, threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_active.push_back(std::make_unique<Active>());
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_workers.emplace_back(&MetadataPipeline::Run, this, (size_t)i);
+    }
+}
+
+MetadataPipeline::~MetadataPipeline() {
+    Stop();
+}
+
+void MetadataPipeline::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+        m_queued.clear();
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    m_workers.clear();
+}
+
+bool MetadataPipeline::LoadCache(const std::string& path) {
+    m_cachePath = path;
+    m_entries.clear();
+
+    std::string data;
+    if (!ReadWholeFile(path, data)) {
+        return false;
+    }
+
+    CacheHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != kCacheMagic || header.version != kCacheVersion) {
+        return false;
+    }
+
+    // Filled in full before it replaces m_entries, so a truncated cache loads nothing
+    std::unordered_map<std::string, Entry> entries;
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.entryCount; ++i) {
+        CacheRecord record;
+        if (data.size() - offset < sizeof(record)) {
+            return false;
+        }
+        memcpy(&record, data.data() + offset, sizeof(record));
+        offset += sizeof(record);
+        if (data.size() - offset < (uint64_t)record.pathLength + record.versionLength) {
+            return false;
+        }
+
+        Entry entry;
+        entry.directoryMTime = record.directoryMTime;
+        entry.stampMTime = record.stampMTime;
+        entry.walked = record.walked;
+        entry.metadata.size.total = FromCache(record.total);
+        entry.metadata.size.errors = record.errors;
+        entry.hasValue = true;
+        std::string projectPath(data.data() + offset, record.pathLength);
+        offset += record.pathLength;
+        entry.metadata.engineVersion.assign(data.data() + offset, record.versionLength);
+        offset += record.versionLength;
+        for (uint32_t f = 0; f < record.folderCount; ++f) {
+            CacheFolder cached;
+            if (data.size() - offset < sizeof(cached)) {
+                return false;
+            }
+            memcpy(&cached, data.data() + offset, sizeof(cached));
+            offset += sizeof(cached);
+            if (data.size() - offset < cached.nameLength) {
+                return false;
+            }
+            FolderSize folder;
+            folder.name.assign(data.data() + offset, cached.nameLength);
+            folder.size = FromCache(cached.size);
+            offset += cached.nameLength;
+            entry.metadata.size.folders.push_back(std::move(folder));
+        }
+        entries[std::move(projectPath)] = std::move(entry);
+    }
+    m_entries = std::move(entries);
+    return true;
+}
+
+bool MetadataPipeline::SaveCache() const {
+    if (m_cachePath.empty()) {
+        return false;
+    }
+
+    CacheHeader header = {};
+    header.magic = kCacheMagic;
+    header.version = kCacheVersion;
+    for (const auto& item : m_entries) {
+        header.entryCount += item.second.hasValue;
+    }
+
+    std::string data;
+    data.append((const char*)&header, sizeof(header));
+    for (const auto& item : m_entries) {
+        const Entry& entry = item.second;
+        if (!entry.hasValue) {
+            continue;
+        }
+        const SizeReport& size = entry.metadata.size;
+        CacheRecord record = {};
+        record.directoryMTime = entry.directoryMTime;
+        record.stampMTime = entry.stampMTime;
+        record.walked = entry.walked;
+        record.total = ToCache(size.total);
+        record.errors = size.errors;
+        record.pathLength = (uint32_t)item.first.size();
+        record.versionLength = (uint32_t)entry.metadata.engineVersion.size();
+        record.folderCount = (uint32_t)size.folders.size();
+        data.append((const char*)&record, sizeof(record));
+        data.append(item.first);
+        data.append(entry.metadata.engineVersion);
+        for (const FolderSize& folder : size.folders) {
+            CacheFolder cached = {};
+            cached.size = ToCache(folder.size);
+            cached.nameLength = (uint32_t)folder.name.size();
+            data.append((const char*)&cached, sizeof(cached));
+            data.append(folder.name);
+        }
+    }
+    return WriteFileAtomically(m_cachePath, data);
+}
+
+const ProjectMetadata* MetadataPipeline::Get(const std::string& path, ProjectType type, bool urgent) {
+    auto it = m_entries.find(path);
+    if (it == m_entries.end()) {
+        it = m_entries.emplace(path, Entry()).first;
+    }
+    Entry& entry = it->second;
+    if (!entry.current && (!entry.requested || urgent)) {
+        Enqueue(path, type, entry, urgent);
+    }
+    return entry.hasValue ? &entry.metadata : nullptr;
+}
+
+void MetadataPipeline::Enqueue(const std::string& path, ProjectType type, Entry& entry, bool urgent) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stop) {
+        return;
+    }
+    auto queued = m_queued.find(path);
+    if (queued != m_queued.end()) {
+        // Already waiting; an urgent request moves it ahead of everything else
+        if (urgent) {
+            m_queue.splice(m_queue.begin(), m_queue, queued->second);
+        }
+        return;
+    }
+    if (entry.requested) {
+        return; // being worked on
+    }
+
+    Job job;
+    job.path = path;
+    job.type = type;
+    job.previous = entry;
+    auto position = urgent ? m_queue.begin() : m_queue.end();
+    m_queued.emplace(path, m_queue.insert(position, std::move(job)));
+    entry.requested = true;
+
+    if (m_queue.size() > kMaxQueued) {
+        m_queued.erase(m_queue.back().path);
+        m_dropped.push_back(std::move(m_queue.back().path));
+        m_queue.pop_back();
+    }
+    m_wake.notify_one();
+}
+
+bool MetadataPipeline::Drain() {
+    std::vector<Result> finished;
+    std::vector<std::string> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_finished.empty() && m_dropped.empty()) {
+            return false;
+        }
+        finished.swap(m_finished);
+        dropped.swap(m_dropped);
+    }
+    for (const std::string& path : dropped) {
+        auto it = m_entries.find(path);
+        if (it != m_entries.end()) {
+            it->second.requested = false;
+        }
+    }
+    for (Result& result : finished) {
+        m_entries[result.path] = std::move(result.entry);
+    }
+    return !finished.empty();
+}
+
+bool MetadataPipeline::Measuring(const std::string& path, uint64_t& allocatedBytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& active : m_active) {
+        if (active->path == path) {
+            allocatedBytes = active->progress.allocatedBytes.load(std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MetadataPipeline::Busy() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_queue.empty()) {
+        return true;
+    }
+    for (const auto& active : m_active) {
+        if (!active->path.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MetadataPipeline::Run(size_t worker) {
+    Active& active = *m_active[worker];
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop.load() || !m_queue.empty(); });
+            if (m_stop) {
+                return;
+            }
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_queued.erase(job.path);
+        }
+
+        Entry entry = Process(job, active);
+        if (m_stop) {
+            return;
+        }
+
+        bool first;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            active.path.clear();
+            first = m_finished.empty();
+            m_finished.push_back({ std::move(job.path), std::move(entry) });
+        }
+        if (first && m_resultsCallback) {
+            m_resultsCallback();
+        }
+    }
+}
+
+MetadataPipeline::Entry MetadataPipeline::Process(const Job& job, Active& active) {
+    TRACE_SCOPE("ProjectMetadata");
+    Entry entry;
+    entry.current = true;
+    ScanCounters counters;
+    if (!GetDirectoryMTime(job.path, entry.directoryMTime, counters)) {
+        return entry; // gone; nothing to show
+    }
+    entry.metadata.engineVersion = ReadEngineVersion(job.path, job.type, entry.stampMTime);
+
+    const Entry& previous = job.previous;
+    int64_t now = NowSeconds();
+    if (previous.hasValue && previous.directoryMTime == entry.directoryMTime && previous.stampMTime == entry.stampMTime &&
+        now - previous.walked < kRewalkAfterSeconds) {
+        entry.metadata.size = previous.metadata.size;
+        entry.walked = previous.walked;
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            active.path = job.path;
+            active.progress.files = 0;
+            active.progress.directories = 0;
+            active.progress.allocatedBytes = 0;
+        }
+        MeasureDirectory(job.path, m_sizePool, m_stop, entry.metadata.size, &active.progress);
+        entry.walked = now;
+    }
+    entry.hasValue = true;
+    return entry;
+}
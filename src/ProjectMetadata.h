@@ -0,0 +1,119 @@
+#pragma once
+
+#include "DirectorySize.h"
+#include "ProjectInfo.h"
+#include "WorkStealingPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Details shown next to a project that take I/O to find out.
+struct ProjectMetadata {
+    std::string engineVersion; // Unity editor version or Unreal EngineAssociation; empty if unknown
+    SizeReport size;           // total.modified is the newest change anywhere in the project
+};
+
+// Engine version from ProjectSettings/ProjectVersion.txt (Unity) or the .uproject
+// file's EngineAssociation (Unreal). stampMTime receives the modification time of
+// the file it came from, in GetDirectoryMTime units, or 0 if there isn't one.
+std::string ReadEngineVersion(const std::string& path, ProjectType type, int64_t& stampMTime);
+
+// Fills in ProjectMetadata lazily on a few worker threads, so the UI never
+// waits on disk. Sizes are measured with MeasureDirectory on a shared pool, so
+// one large project gets every thread while it is the only one in progress. The UI asks for the rows it is showing each frame;
+// those go to the front of the queue, so what is on screen is always worked on
+// first, and the queue is bounded so a fast scroll can't pile up stale work.
+//
+// Results are kept in a cache file keyed by path. A cached entry is shown
+// straight away and re-checked in the background when next asked for: if the
+// project directory's mtime and its version file's mtime are unchanged and the
+// tree was walked within the last day, the cached size is kept instead of
+// walking the tree again.
+class MetadataPipeline {
+public:
+    explicit MetadataPipeline(unsigned threadCount = 2);
+    ~MetadataPipeline();
+
+    MetadataPipeline(const MetadataPipeline&) = delete;
+    MetadataPipeline& operator=(const MetadataPipeline&) = delete;
+
+    // Loads results saved by an earlier run; SaveCache() writes back to the same path.
+    bool LoadCache(const std::string& path);
+    bool SaveCache() const;
+
+    // Called from a worker thread when there is something for Drain(). Set it before the first Get().
+    void SetResultsCallback(std::function<void()> callback) { m_resultsCallback = std::move(callback); }
+
+    // UI thread only. Returns what is known about path so far (possibly a cached
+    // value still being re-checked), or null. Queues path unless it is already
+    // current or queued; urgent requests jump ahead of everything else.
+    const ProjectMetadata* Get(const std::string& path, ProjectType type, bool urgent);
+    // UI thread only. Takes in finished results; returns true if there were any.
+    bool Drain();
+
+    // UI thread only. True if path is being measured right now; allocatedBytes
+    // receives how much has been counted so far.
+    bool Measuring(const std::string& path, uint64_t& allocatedBytes);
+    bool Busy();
+
+    // Abandons queued work, cancels measurements in progress and waits for the workers to exit.
+    void Stop();
+
+private:
+    struct Entry {
+        ProjectMetadata metadata;
+        int64_t directoryMTime = 0;
+        int64_t stampMTime = 0;
+        int64_t walked = 0; // when the size was measured, in seconds since the epoch
+        bool hasValue = false;
+        bool current = false; // computed or re-checked by this run
+        bool requested = false;
+    };
+
+    struct Job {
+        std::string path;
+        ProjectType type = ProjectType::None;
+        Entry previous;
+    };
+
+    struct Result {
+        std::string path;
+        Entry entry;
+    };
+
+    // A measurement in progress, one slot per worker
+    struct Active {
+        std::string path;
+        SizeProgress progress;
+    };
+
+    void Enqueue(const std::string& path, ProjectType type, Entry& entry, bool urgent);
+    void Run(size_t worker);
+    Entry Process(const Job& job, Active& active);
+
+    WorkStealingPool m_sizePool;
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<Active>> m_active;
+    std::atomic<bool> m_stop{false};
+    std::function<void()> m_resultsCallback;
+    std::string m_cachePath;
+
+    // UI thread only
+    std::unordered_map<std::string, Entry> m_entries;
+
+    std::mutex m_mutex; // guards everything below
+    std::condition_variable m_wake;
+    std::list<Job> m_queue; // most urgent first
+    std::unordered_map<std::string, std::list<Job>::iterator> m_queued;
+    std::vector<Result> m_finished;
+    std::vector<std::string> m_dropped; // fell off the end of the queue; may be asked for again
+};
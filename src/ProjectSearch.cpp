@@ -0,0 +1,338 @@
+#include "ProjectSearch.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+namespace {
+
+// Name matches always outrank matches found only in the directory or through a typo.
+constexpr int kNameMatchBonus = 1000;
+// Above any typo match, which scores the number of shared trigrams (at most 255).
+constexpr int kDirectoryMatchScore = 300;
+// Trigrams in more than 1 in this many names are left out of typo matching.
+constexpr size_t kCommonTrigramShare = 16;
+
+char ToLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+bool IsUpper(char c) {
+    return c >= 'A' && c <= 'Z';
+}
+
+bool IsWordStart(std::string_view text, size_t at) {
+    if (at == 0) {
+        return true;
+    }
+    char previous = text[at - 1];
+    if (previous == ' ' || previous == '_' || previous == '-' || previous == '.' || previous == '/' || previous == '\\') {
+        return true;
+    }
+    return IsUpper(text[at]) && !IsUpper(previous);
+}
+
+// One bit per letter and digit; everything else shares the remaining 28 bits.
+uint64_t CharacterMask(std::string_view text) {
+    uint64_t mask = 0;
+    for (char c : text) {
+        unsigned char lower = (unsigned char)ToLower(c);
+        unsigned bit;
+        if (lower >= 'a' && lower <= 'z') {
+            bit = lower - 'a';
+        } else if (lower >= '0' && lower <= '9') {
+            bit = 26 + (lower - '0');
+        } else {
+            bit = 36 + lower % 28;
+        }
+        mask |= uint64_t(1) << bit;
+    }
+    return mask;
+}
+
+uint32_t Trigram(char a, char b, char c) {
+    return ((uint32_t)(unsigned char)ToLower(a) << 16) | ((uint32_t)(unsigned char)ToLower(b) << 8) |
+        (uint32_t)(unsigned char)ToLower(c);
+}
+
+int CompareIgnoreCase(std::string_view a, std::string_view b) {
+    size_t count = std::min(a.size(), b.size());
+    for (size_t i = 0; i < count; ++i) {
+        char x = ToLower(a[i]);
+        char y = ToLower(b[i]);
+        if (x != y) {
+            return (unsigned char)x < (unsigned char)y ? -1 : 1;
+        }
+    }
+    return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+
+size_t FindIgnoreCase(std::string_view text, std::string_view lowerQuery) {
+    if (lowerQuery.size() > text.size()) {
+        return std::string_view::npos;
+    }
+    for (size_t at = 0; at + lowerQuery.size() <= text.size(); ++at) {
+        size_t i = 0;
+        while (i < lowerQuery.size() && ToLower(text[at + i]) == lowerQuery[i]) {
+            ++i;
+        }
+        if (i == lowerQuery.size()) {
+            return at;
+        }
+    }
+    return std::string_view::npos;
+}
+
+bool IsSubsequence(std::string_view lowerText, std::string_view lowerQuery) {
+    size_t matched = 0;
+    for (size_t i = 0; i < lowerText.size() && matched < lowerQuery.size(); ++i) {
+        matched += lowerText[i] == lowerQuery[matched];
+    }
+    return matched == lowerQuery.size();
+}
+
+// Scores a name whose lower-cased form contains lowerQuery as a subsequence.
+int FuzzyScore(std::string_view text, std::string_view lowerText, std::string_view lowerQuery) {
+    size_t at = lowerText.find(lowerQuery);
+    if (at != std::string_view::npos) {
+        int score = 100 + 8 * (int)lowerQuery.size() - (int)std::min<size_t>(at, 30);
+        if (at == 0) {
+            score += 50;
+        } else if (IsWordStart(text, at)) {
+            score += 25;
+        }
+        return score;
+    }
+
+    int score = 1;
+    size_t matched = 0;
+    size_t last = std::string_view::npos;
+    for (size_t i = 0; i < text.size() && matched < lowerQuery.size(); ++i) {
+        if (lowerText[i] != lowerQuery[matched]) {
+            continue;
+        }
+        score += 4;
+        if (last != std::string_view::npos && i == last + 1) {
+            score += 6;
+        }
+        if (IsWordStart(text, i)) {
+            score += 8;
+        }
+        last = i;
+        ++matched;
+    }
+    return score;
+}
+
+bool BetterMatch(const ProjectSearch::Match& a, const ProjectSearch::Match& b) {
+    return a.score != b.score ? a.score > b.score : a.project < b.project;
+}
+
+}
+
+void ProjectSearch::Clear() {
+    m_nameMasks.clear();
+    m_lowerNames.clear();
+    m_nameOffsets.clear();
+    m_directoryMasks.clear();
+    m_trigrams.clear();
+    m_byName.clear();
+    m_indexed = 0;
+    m_candidatesQuery.clear();
+    m_candidates.clear();
+}
+
+void ProjectSearch::Update(const ProjectStore& projects) {
+    TRACE_SCOPE("SearchIndexUpdate");
+    size_t first = m_indexed;
+    size_t count = projects.Size();
+    if (count <= first) {
+        return;
+    }
+
+    for (size_t id = m_directoryMasks.size(); id < projects.DirectoryCount(); ++id) {
+        m_directoryMasks.push_back(CharacterMask(projects.DirectoryById((uint32_t)id)));
+    }
+    if (m_nameOffsets.empty()) {
+        m_nameOffsets.push_back(0);
+    }
+    m_nameMasks.reserve(count);
+    m_nameOffsets.reserve(count + 1);
+    for (size_t i = first; i < count; ++i) {
+        std::string_view name = projects.Name(i);
+        m_nameMasks.push_back(CharacterMask(name));
+        for (char c : name) {
+            m_lowerNames.push_back(ToLower(c));
+        }
+        m_nameOffsets.push_back((uint32_t)m_lowerNames.size());
+        for (size_t at = 0; at + 3 <= name.size(); ++at) {
+            std::vector<uint32_t>& posting = m_trigrams[Trigram(name[at], name[at + 1], name[at + 2])];
+            if (posting.empty() || posting.back() != (uint32_t)i) {
+                posting.push_back((uint32_t)i);
+            }
+        }
+    }
+
+    // Sort only the new names, then merge them into the existing order
+    auto byName = [&](uint32_t a, uint32_t b) {
+        int order = CompareIgnoreCase(projects.Name(a), projects.Name(b));
+        return order != 0 ? order < 0 : a < b;
+    };
+    size_t sorted = m_byName.size();
+    for (size_t i = first; i < count; ++i) {
+        m_byName.push_back((uint32_t)i);
+    }
+    std::sort(m_byName.begin() + sorted, m_byName.end(), byName);
+    std::inplace_merge(m_byName.begin(), m_byName.begin() + sorted, m_byName.end(), byName);
+
+    m_indexed = count;
+}
+
+void ProjectSearch::Find(const ProjectStore& projects, std::string_view query, std::vector<Match>& results) {
+    results.clear();
+    Extend(projects, query, 0, results);
+}
+
+void ProjectSearch::Extend(const ProjectStore& projects, std::string_view query, size_t first, std::vector<Match>& results) {
+    TRACE_SCOPE("Search");
+    std::string lowerQuery(query);
+    for (char& c : lowerQuery) {
+        c = ToLower(c);
+    }
+    uint64_t queryMask = CharacterMask(lowerQuery);
+
+    // Typo candidates: names sharing most of the query's trigrams. Trigrams found
+    // in a large share of all names say little and would cost the most to count,
+    // so only the selective ones take part.
+    std::vector<uint32_t> queryTrigrams;
+    for (size_t at = 0; at + 3 <= lowerQuery.size(); ++at) {
+        queryTrigrams.push_back(Trigram(lowerQuery[at], lowerQuery[at + 1], lowerQuery[at + 2]));
+    }
+    std::sort(queryTrigrams.begin(), queryTrigrams.end());
+    queryTrigrams.erase(std::unique(queryTrigrams.begin(), queryTrigrams.end()), queryTrigrams.end());
+    std::vector<const std::vector<uint32_t>*> postings;
+    if (queryTrigrams.size() >= 3) {
+        for (uint32_t trigram : queryTrigrams) {
+            auto it = m_trigrams.find(trigram);
+            if (it == m_trigrams.end()) {
+                postings.push_back(nullptr); // shared by nothing, still counts against
+            } else if (it->second.size() * kCommonTrigramShare <= m_indexed) {
+                postings.push_back(&it->second);
+            }
+        }
+    }
+    size_t required = 0;
+    if (postings.size() >= 3) {
+        required = std::max<size_t>(2, (postings.size() * 2 + 2) / 3);
+        m_shared.resize(m_indexed, 0);
+        for (const std::vector<uint32_t>* posting : postings) {
+            if (!posting) {
+                continue;
+            }
+            for (auto p = std::lower_bound(posting->begin(), posting->end(), (uint32_t)first); p != posting->end(); ++p) {
+                if (m_shared[*p] == 0) {
+                    m_touched.push_back(*p);
+                }
+                if (m_shared[*p] < 255) {
+                    ++m_shared[*p];
+                }
+            }
+        }
+    }
+
+    // Scattered letters across a long path match almost anything, so directories
+    // need the whole query. There are far fewer of them than projects.
+    m_directoryMatches.assign(m_directoryMasks.size(), 0);
+    bool anyDirectory = false;
+    for (size_t id = 0; id < m_directoryMasks.size(); ++id) {
+        if ((m_directoryMasks[id] & queryMask) == queryMask &&
+            FindIgnoreCase(projects.DirectoryById((uint32_t)id), lowerQuery) != std::string_view::npos) {
+            m_directoryMatches[id] = 1;
+            anyDirectory = true;
+        }
+    }
+
+    // Typing another character can only narrow name and directory matches, so a
+    // query extending the previous one re-tests only the previous candidates
+    bool refine = first == 0 && m_candidatesIndexed == m_indexed && !m_candidatesQuery.empty() &&
+        lowerQuery.size() > m_candidatesQuery.size() &&
+        lowerQuery.compare(0, m_candidatesQuery.size(), m_candidatesQuery) == 0;
+
+    m_found.clear();
+    m_nextCandidates.clear();
+    int bestScore = 0;
+    std::string_view lowerNames = m_lowerNames;
+    auto visit = [&](uint32_t i) {
+        int score = 0;
+        if ((m_nameMasks[i] & queryMask) == queryMask) {
+            std::string_view lowerName = lowerNames.substr(m_nameOffsets[i], m_nameOffsets[i + 1] - m_nameOffsets[i]);
+            if (IsSubsequence(lowerName, lowerQuery)) {
+                score = kNameMatchBonus + FuzzyScore(projects.Name(i), lowerName, lowerQuery);
+            }
+        }
+        if (score == 0 && anyDirectory && m_directoryMatches[projects.DirectoryId(i)]) {
+            score = kDirectoryMatchScore;
+        }
+        if (score > 0) {
+            m_found.push_back({ i, score });
+            m_nextCandidates.push_back(i);
+            bestScore = std::max(bestScore, score);
+            if (required > 0) {
+                m_shared[i] = 0; // already matched; not a typo candidate
+            }
+        }
+    };
+    if (refine) {
+        for (uint32_t i : m_candidates) {
+            visit(i);
+        }
+    } else {
+        for (size_t i = first; i < m_indexed; ++i) {
+            visit((uint32_t)i);
+        }
+    }
+
+    size_t typos = m_found.size();
+    for (uint32_t project : m_touched) {
+        if (m_shared[project] >= required) {
+            m_found.push_back({ project, m_shared[project] });
+            bestScore = std::max(bestScore, (int)m_shared[project]);
+        }
+        m_shared[project] = 0;
+    }
+    m_touched.clear();
+    std::sort(m_found.begin() + typos, m_found.end(), [](const Match& a, const Match& b) { return a.project < b.project; });
+
+    if (first == 0) {
+        m_candidatesQuery = lowerQuery;
+        m_candidatesIndexed = m_indexed;
+        m_candidates.swap(m_nextCandidates);
+    } else if (first == m_candidatesIndexed && lowerQuery == m_candidatesQuery) {
+        m_candidates.insert(m_candidates.end(), m_nextCandidates.begin(), m_nextCandidates.end());
+        m_candidatesIndexed = m_indexed;
+    } else {
+        m_candidatesQuery.clear();
+    }
+
+    // Scores are small integers, so rank with a counting sort. Name and directory
+    // matches were visited in store order and typo matches sorted, and the two
+    // never share a score, so equal scores stay in store order.
+    m_scoreStarts.assign(bestScore + 2, 0);
+    for (const Match& match : m_found) {
+        ++m_scoreStarts[bestScore - match.score + 1];
+    }
+    for (size_t i = 1; i < m_scoreStarts.size(); ++i) {
+        m_scoreStarts[i] += m_scoreStarts[i - 1];
+    }
+    m_ranked.resize(m_found.size());
+    for (const Match& match : m_found) {
+        m_ranked[m_scoreStarts[bestScore - match.score]++] = match;
+    }
+
+    if (results.empty()) {
+        results.swap(m_ranked);
+        return;
+    }
+    size_t ranked = results.size();
+    results.insert(results.end(), m_ranked.begin(), m_ranked.end());
+    std::inplace_merge(results.begin(), results.begin() + ranked, results.end(), BetterMatch);
+}
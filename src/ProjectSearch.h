@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ProjectStore.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Filtering and ordering for a ProjectStore. The index is built once per scan
+// and extended as projects are appended, so nothing is rebuilt while typing.
+//
+// Matching is case-insensitive and fuzzy: the query's characters have to show
+// up in order in the name, with whole substrings, word starts and runs ranking
+// higher; failing that, the whole query has to appear in the parent directory.
+// Queries of five or more characters also match names sharing most of their
+// trigrams, which lets a typo through.
+//
+// Names are kept lower-cased back to back, a per-project character mask rejects
+// most of them with one AND, directories are tested once each rather than once
+// per project, typo candidates come from trigram posting lists, and results are
+// ranked with a counting sort over their (small, integer) scores. While the user
+// types, a query that extends the previous one only re-checks its matches.
+class ProjectSearch {
+public:
+    struct Match {
+        uint32_t project;
+        int score;
+    };
+
+    // Forgets everything; call whenever the store is reordered, shrunk or replaced.
+    void Clear();
+    // Indexes the projects appended to the store since the last call.
+    void Update(const ProjectStore& projects);
+    size_t Indexed() const { return m_indexed; }
+
+    // Every indexed project, ordered by name (case-insensitive, then store order).
+    const std::vector<uint32_t>& ByName() const { return m_byName; }
+
+    // Replaces results with the matches for query, best first and in store order among equal scores.
+    void Find(const ProjectStore& projects, std::string_view query, std::vector<Match>& results);
+    // Merges the matches among projects [first, Indexed()) into results, keeping them ranked.
+    void Extend(const ProjectStore& projects, std::string_view query, size_t first, std::vector<Match>& results);
+
+private:
+    std::vector<uint64_t> m_nameMasks;      // per project
+    std::string m_lowerNames;               // every name lower-cased, back to back
+    std::vector<uint32_t> m_nameOffsets;    // project i is [offset[i], offset[i + 1])
+    std::vector<uint64_t> m_directoryMasks; // per interned directory
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_trigrams; // name trigram -> ascending projects
+    std::vector<uint32_t> m_byName;
+    size_t m_indexed = 0;
+
+    // Reused between queries
+    std::vector<uint8_t> m_shared;
+    std::vector<uint32_t> m_touched;
+    std::vector<uint8_t> m_directoryMatches;
+    std::vector<Match> m_found;
+    std::vector<uint32_t> m_scoreStarts;
+    std::vector<Match> m_ranked;
+    std::vector<uint32_t> m_nextCandidates;
+
+    // Name and directory matches of the last query, covering projects [0, m_candidatesIndexed)
+    std::string m_candidatesQuery;
+    std::vector<uint32_t> m_candidates;
+    size_t m_candidatesIndexed = 0;
+};
@@ -0,0 +1,146 @@
+#include "ProjectStore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+constexpr size_t kBlockSize = 64 * 1024;
+
+bool IsSeparator(char c) {
+    return c == '/' || c == '\\';
+}
+
+}
+
+bool IsSameOrUnder(std::string_view path, std::string_view prefix) {
+    if (prefix.empty() || path.size() < prefix.size() || path.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    return path.size() == prefix.size() || IsSeparator(prefix.back()) || IsSeparator(path[prefix.size()]);
+}
+
+void ProjectStore::Clear() {
+    m_types.clear();
+    m_directoryOf.clear();
+    m_names.clear();
+    m_directories.clear();
+    m_directoryIds.clear();
+    m_blocks.clear();
+    m_blockUsed = 0;
+    m_blockSize = 0;
+    m_arenaBytes = 0;
+}
+
+void ProjectStore::Reserve(size_t count) {
+    m_types.reserve(count);
+    m_directoryOf.reserve(count);
+    m_names.reserve(count);
+}
+
+void ProjectStore::Swap(ProjectStore& other) {
+    std::swap(*this, other);
+}
+
+std::string_view ProjectStore::Intern(std::string_view text) {
+    size_t needed = text.size() + 1;
+    if (m_blockUsed + needed > m_blockSize) {
+        m_blockSize = std::max(kBlockSize, needed);
+        m_blocks.push_back(std::make_unique<char[]>(m_blockSize));
+        m_blockUsed = 0;
+        m_arenaBytes += m_blockSize;
+    }
+    char* data = m_blocks.back().get() + m_blockUsed;
+    memcpy(data, text.data(), text.size());
+    data[text.size()] = '\0';
+    m_blockUsed += needed;
+    return std::string_view(data, text.size());
+}
+
+void ProjectStore::Add(std::string_view path, ProjectType type) {
+    size_t split = path.find_last_of("/\\");
+    split = split == std::string_view::npos ? 0 : split + 1;
+    std::string_view directory = path.substr(0, split);
+
+    auto it = m_directoryIds.find(directory);
+    if (it == m_directoryIds.end()) {
+        std::string_view interned = Intern(directory);
+        it = m_directoryIds.emplace(interned, (uint32_t)m_directories.size()).first;
+        m_directories.push_back(interned);
+    }
+
+    m_types.push_back(type);
+    m_directoryOf.push_back(it->second);
+    m_names.push_back(Intern(path.substr(split)));
+}
+
+std::string ProjectStore::Path(size_t index) const {
+    std::string path;
+    AppendPath(index, path);
+    return path;
+}
+
+void ProjectStore::AppendPath(size_t index, std::string& out) const {
+    std::string_view directory = Directory(index);
+    std::string_view name = Name(index);
+    out.append(directory.data(), directory.size());
+    out.append(name.data(), name.size());
+}
+
+ProjectInfo ProjectStore::Get(size_t index) const {
+    return { std::string(Name(index)), Path(index), Type(index) };
+}
+
+void ProjectStore::Reorder(const std::vector<size_t>& order) {
+    if (order.size() != Size()) {
+        return;
+    }
+    std::vector<ProjectType> types(order.size());
+    std::vector<uint32_t> directoryOf(order.size());
+    std::vector<std::string_view> names(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        types[i] = m_types[order[i]];
+        directoryOf[i] = m_directoryOf[order[i]];
+        names[i] = m_names[order[i]];
+    }
+    m_types.swap(types);
+    m_directoryOf.swap(directoryOf);
+    m_names.swap(names);
+}
+
+size_t ProjectStore::RemoveUnder(const std::vector<std::string>& prefixes) {
+    if (prefixes.empty()) {
+        return 0;
+    }
+    std::string path;
+    size_t kept = 0;
+    for (size_t i = 0; i < Size(); ++i) {
+        path.clear();
+        AppendPath(i, path);
+        bool removed = std::any_of(prefixes.begin(), prefixes.end(),
+            [&](const std::string& prefix) { return IsSameOrUnder(path, prefix); });
+        if (removed) {
+            continue;
+        }
+        m_types[kept] = m_types[i];
+        m_directoryOf[kept] = m_directoryOf[i];
+        m_names[kept] = m_names[i];
+        ++kept;
+    }
+    size_t removedCount = Size() - kept;
+    m_types.resize(kept);
+    m_directoryOf.resize(kept);
+    m_names.resize(kept);
+    return removedCount;
+}
+
+size_t ProjectStore::MemoryUsage() const {
+    return m_types.capacity() * sizeof(ProjectType) +
+        m_directoryOf.capacity() * sizeof(uint32_t) +
+        m_names.capacity() * sizeof(std::string_view) +
+        m_directories.capacity() * sizeof(std::string_view) +
+        m_directoryIds.size() * (sizeof(std::string_view) + sizeof(uint32_t) + 2 * sizeof(void*)) +
+        m_directoryIds.bucket_count() * sizeof(void*) +
+        m_arenaBytes;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ProjectInfo.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Compact storage for a large project list. Instead of three heap strings per
+// project, each one is a type byte, the id of its parent directory and a name
+// in a shared arena. Parent directories are interned, so sibling projects share
+// one copy of their (usually long) common prefix, and the full path is only
+// rebuilt when it is needed. Columns are kept as separate arrays so passes that
+// filter or group by type or name touch only the bytes they use.
+class ProjectStore {
+public:
+    ProjectStore() = default;
+    ProjectStore(ProjectStore&&) = default;
+    ProjectStore& operator=(ProjectStore&&) = default;
+    ProjectStore(const ProjectStore&) = delete;
+    ProjectStore& operator=(const ProjectStore&) = delete;
+
+    size_t Size() const { return m_types.size(); }
+    bool Empty() const { return m_types.empty(); }
+    void Clear();
+    void Reserve(size_t count);
+    void Swap(ProjectStore& other);
+
+    void Add(std::string_view path, ProjectType type);
+    void Add(const ProjectInfo& project) { Add(project.path, project.type); }
+
+    ProjectType Type(size_t index) const { return m_types[index]; }
+    const std::vector<ProjectType>& Types() const { return m_types; }
+    // The last path component. Its data() is null-terminated.
+    std::string_view Name(size_t index) const { return m_names[index]; }
+    // The parent directory, including its trailing separator.
+    std::string_view Directory(size_t index) const { return m_directories[m_directoryOf[index]]; }
+    // Interned directories are numbered from 0 in the order they were first seen.
+    uint32_t DirectoryId(size_t index) const { return m_directoryOf[index]; }
+    size_t DirectoryCount() const { return m_directories.size(); }
+    std::string_view DirectoryById(uint32_t id) const { return m_directories[id]; }
+    std::string Path(size_t index) const;
+    void AppendPath(size_t index, std::string& out) const;
+    ProjectInfo Get(size_t index) const;
+
+    // Rearranges the projects so that position i holds what was at order[i].
+    void Reorder(const std::vector<size_t>& order);
+    // Drops every project at or below one of prefixes, keeping the rest in order.
+    // Their strings stay in the arena until Clear().
+    size_t RemoveUnder(const std::vector<std::string>& prefixes);
+
+    // Bytes held by the columns, the arena and the directory table.
+    size_t MemoryUsage() const;
+
+private:
+    std::string_view Intern(std::string_view text);
+
+    std::vector<ProjectType> m_types;
+    std::vector<uint32_t> m_directoryOf;
+    std::vector<std::string_view> m_names;
+
+    std::vector<std::string_view> m_directories;
+    std::unordered_map<std::string_view, uint32_t> m_directoryIds;
+
+    // Strings are copied into fixed blocks that never move, so views stay valid
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    size_t m_blockUsed = 0;
+    size_t m_blockSize = 0;
+    size_t m_arenaBytes = 0;
+};
+
+// Whether path is prefix or lies below it. Either separator counts, and a
+// prefix ending in one (a root given as "/work/") works too. An empty prefix
+// matches nothing.
+bool IsSameOrUnder(std::string_view path, std::string_view prefix);
@@ -0,0 +1,415 @@
+#include "ProjectTypes.h"
+
+#include "DirectoryLister.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+namespace {
+
+uint64_t Fnv1a(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string Lowercase(std::string text) {
+    for (char& c : text) {
+        c = (char)tolower((unsigned char)c);
+    }
+    return text;
+}
+
+std::string Trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = text.find_last_not_of(" \t");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Whether the start of the file at path contains probe, which is already lowercase.
+bool ProbeFile(const std::filesystem::path& path, const std::string& probe) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    char buffer[ProjectTypeRegistry::kProbeBytes];
+    file.read(buffer, sizeof(buffer));
+    std::string text = Lowercase(std::string(buffer, (size_t)file.gcount()));
+    return text.find(probe) != std::string::npos;
+}
+
+MarkerRule Rule(MarkerRule::Kind kind, const char* name, const char* contains = "") {
+    MarkerRule rule;
+    rule.kind = kind;
+    rule.name = name;
+    rule.contains = contains;
+    return rule;
+}
+
+ProjectTypeDefinition Definition(ProjectType type, const char* name, uint32_t color, bool prune,
+    std::vector<MarkerRule> markers) {
+    ProjectTypeDefinition definition;
+    definition.type = type;
+    definition.name = name;
+    definition.color = color;
+    definition.prune = prune;
+    definition.markers = std::move(markers);
+    return definition;
+}
+
+// What ProjectTypeName and ProjectTypeRgb read, kept apart from the matcher so
+// they are lock-free. Names are interned and never freed, so a pointer handed
+// out stays valid after the types change.
+struct TypeTable {
+    std::mutex mutex;
+    std::shared_ptr<const ProjectMatcher> current;
+    std::deque<std::string> interned;
+    std::atomic<const char*> names[256];
+    std::atomic<uint32_t> colors[256];
+
+    void Publish(std::shared_ptr<const ProjectMatcher> matcher) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < 256; ++i) {
+            names[i].store("", std::memory_order_relaxed);
+            colors[i].store(0xCCCCCC, std::memory_order_relaxed);
+        }
+        for (const ProjectTypeDefinition& definition : matcher->Registry().Types()) {
+            auto known = std::find(interned.begin(), interned.end(), definition.name);
+            if (known == interned.end()) {
+                known = interned.insert(interned.end(), definition.name);
+            }
+            names[(uint8_t)definition.type].store(known->c_str(), std::memory_order_release);
+            colors[(uint8_t)definition.type].store(definition.color, std::memory_order_relaxed);
+        }
+        current = std::move(matcher);
+    }
+};
+
+TypeTable& Table() {
+    // Never destroyed, so scans still running at exit can look names up
+    static TypeTable* table = [] {
+        TypeTable* created = new TypeTable;
+        created->Publish(std::make_shared<ProjectMatcher>(ProjectTypeRegistry::BuiltIn()));
+        return created;
+    }();
+    return *table;
+}
+
+}
+
+ProjectTypeRegistry ProjectTypeRegistry::BuiltIn() {
+    using Kind = MarkerRule::Kind;
+    ProjectTypeRegistry registry;
+    std::string error;
+    registry.Add(Definition(ProjectType::Unity, "Unity", 0x3366CC, true,
+        { Rule(Kind::Directory, "Assets"), Rule(Kind::Directory, "ProjectSettings") }), error);
+    registry.Add(Definition(ProjectType::Unreal, "Unreal", 0xCC3333, true,
+        { Rule(Kind::Extension, ".uproject") }), error);
+    registry.Add(Definition(ProjectType::Godot, "Godot", 0x478CBF, true,
+        { Rule(Kind::File, "project.godot") }), error);
+    registry.Add(Definition(ProjectType::VisualStudio, "Visual Studio", 0x9966CC, false,
+        { Rule(Kind::Extension, ".sln", "Microsoft Visual Studio Solution File") }), error);
+    // Every folder of a CMake tree has a CMakeLists.txt; only the top one declares the project
+    registry.Add(Definition(ProjectType::CMake, "CMake", 0x33A05A, false,
+        { Rule(Kind::File, "CMakeLists.txt", "project(") }), error);
+    return registry;
+}
+
+bool ProjectTypeRegistry::Add(ProjectTypeDefinition definition, std::string& error) {
+    if (definition.type == ProjectType::None || Find(definition.type)) {
+        error = "Project type " + std::to_string((int)definition.type) + " is already registered";
+        return false;
+    }
+    if (definition.name.empty()) {
+        error = "A project type needs a name";
+        return false;
+    }
+    for (const ProjectTypeDefinition& existing : m_types) {
+        if (existing.name == definition.name) {
+            error = "There is already a project type called " + definition.name;
+            return false;
+        }
+    }
+    if (definition.markers.empty() || definition.markers.size() > kMaxMarkers) {
+        error = definition.name + " needs between 1 and " + std::to_string(kMaxMarkers) + " marker rules";
+        return false;
+    }
+    for (MarkerRule& rule : definition.markers) {
+        if (rule.name.empty()) {
+            error = definition.name + " has a marker rule without a name";
+            return false;
+        }
+        if (rule.kind == MarkerRule::Kind::Extension && (rule.name[0] != '.' || rule.name.find('.', 1) != std::string::npos)) {
+            error = definition.name + ": an extension starts with its only dot, like .uproject";
+            return false;
+        }
+        if (rule.kind == MarkerRule::Kind::Directory && !rule.contains.empty()) {
+            error = definition.name + ": only files can have a content probe";
+            return false;
+        }
+        if (rule.contains.size() > kProbeBytes) {
+            error = definition.name + ": a content probe can't be longer than the part of the file read";
+            return false;
+        }
+        rule.contains = Lowercase(rule.contains);
+    }
+    m_types.push_back(std::move(definition));
+    return true;
+}
+
+bool ProjectTypeRegistry::AddCustom(const std::string& spec, std::string& error) {
+    ProjectTypeDefinition definition;
+    if (!ParseProjectTypeSpec(spec, definition, error)) {
+        return false;
+    }
+    unsigned type = kFirstCustomProjectType;
+    while (type < 256 && Find((ProjectType)type)) {
+        ++type;
+    }
+    if (type == 256) {
+        error = "Too many project types";
+        return false;
+    }
+    definition.type = (ProjectType)type;
+    return Add(std::move(definition), error);
+}
+
+const ProjectTypeDefinition* ProjectTypeRegistry::Find(ProjectType type) const {
+    for (const ProjectTypeDefinition& definition : m_types) {
+        if (definition.type == type) {
+            return &definition;
+        }
+    }
+    return nullptr;
+}
+
+uint64_t ProjectTypeRegistry::Fingerprint() const {
+    uint64_t hash = 14695981039346656037ull;
+    for (const ProjectTypeDefinition& definition : m_types) {
+        hash = Fnv1a(hash, &definition.type, sizeof(definition.type));
+        hash = Fnv1a(hash, definition.name.c_str(), definition.name.size() + 1);
+        hash = Fnv1a(hash, &definition.prune, sizeof(definition.prune));
+        for (const MarkerRule& rule : definition.markers) {
+            hash = Fnv1a(hash, &rule.kind, sizeof(rule.kind));
+            hash = Fnv1a(hash, rule.name.c_str(), rule.name.size() + 1);
+            hash = Fnv1a(hash, rule.contains.c_str(), rule.contains.size() + 1);
+        }
+    }
+    return hash;
+}
+
+bool ParseProjectTypeSpec(const std::string& spec, ProjectTypeDefinition& definition, std::string& error) {
+    size_t colon = spec.find(':');
+    if (colon == std::string::npos) {
+        error = "Expected \"Name: rule, rule, ...\" in " + spec;
+        return false;
+    }
+    definition = ProjectTypeDefinition();
+    definition.name = Trim(spec.substr(0, colon));
+    size_t start = colon + 1;
+    while (start <= spec.size()) {
+        size_t comma = spec.find(',', start);
+        if (comma == std::string::npos) {
+            comma = spec.size();
+        }
+        std::string rule = Trim(spec.substr(start, comma - start));
+        start = comma + 1;
+        if (rule.empty()) {
+            continue;
+        }
+        size_t equals = rule.find('=');
+        std::string key = equals == std::string::npos ? rule : Trim(rule.substr(0, equals));
+        std::string value = equals == std::string::npos ? std::string() : Trim(rule.substr(equals + 1));
+        if (value.empty()) {
+            error = "Expected key=value, not " + rule;
+            return false;
+        }
+        if (key == "contains") {
+            if (definition.markers.empty()) {
+                error = "contains= has to follow the file= or ext= rule it probes";
+                return false;
+            }
+            definition.markers.back().contains = value;
+            continue;
+        }
+        MarkerRule marker;
+        if (key == "dir") {
+            marker.kind = MarkerRule::Kind::Directory;
+        } else if (key == "file") {
+            marker.kind = MarkerRule::Kind::File;
+        } else if (key == "ext") {
+            marker.kind = MarkerRule::Kind::Extension;
+        } else {
+            error = "Unknown rule " + key + "; expected dir, file, ext or contains";
+            return false;
+        }
+        marker.name = value;
+        definition.markers.push_back(std::move(marker));
+    }
+    return true;
+}
+
+std::string FormatProjectTypeSpec(const ProjectTypeDefinition& definition) {
+    std::string spec = definition.name + ":";
+    for (const MarkerRule& rule : definition.markers) {
+        spec += spec.back() == ':' ? " " : ", ";
+        spec += rule.kind == MarkerRule::Kind::Directory ? "dir=" : rule.kind == MarkerRule::Kind::File ? "file=" : "ext=";
+        spec += rule.name;
+        if (!rule.contains.empty()) {
+            spec += ", contains=" + rule.contains;
+        }
+    }
+    return spec;
+}
+
+ProjectMatcher::ProjectMatcher(ProjectTypeRegistry registry) : m_registry(std::move(registry)) {
+    m_fingerprint = m_registry.Fingerprint();
+    const std::vector<ProjectTypeDefinition>& types = m_registry.Types();
+    m_required.resize(types.size());
+    m_probed.resize(types.size());
+    for (size_t type = 0; type < types.size(); ++type) {
+        const ProjectTypeDefinition& definition = types[type];
+        m_prunes[(uint8_t)definition.type] = definition.prune;
+        for (size_t rule = 0; rule < definition.markers.size(); ++rule) {
+            const MarkerRule& marker = definition.markers[rule];
+            m_required[type] |= 1u << rule;
+            if (!marker.contains.empty()) {
+                m_probed[type] |= 1u << rule;
+                m_hasProbes = true;
+            }
+            auto& table = marker.kind == MarkerRule::Kind::Extension ? m_extensions : m_names;
+            table[marker.name].push_back({ (uint16_t)type, (uint8_t)rule, marker.kind == MarkerRule::Kind::Directory });
+        }
+    }
+}
+
+ProjectType ProjectMatcher::Classify(const std::filesystem::path& directory, const std::vector<DirEntry>& entries,
+    bool* probed) const {
+    // Types with at least one marker present, and the entries that still need probing.
+    // Most directories match nothing, so these stay empty and never allocate.
+    struct Candidate {
+        uint16_t type;
+        uint32_t found;
+    };
+    struct Probe {
+        uint16_t type;
+        uint8_t rule;
+        uint32_t entry;
+    };
+    std::vector<Candidate> candidates;
+    std::vector<Probe> probes;
+    auto mark = [&](const std::vector<Marker>& markers, const DirEntry& entry, size_t index) {
+        for (const Marker& marker : markers) {
+            if (marker.directory != entry.isDirectory) {
+                continue;
+            }
+            auto candidate = std::find_if(candidates.begin(), candidates.end(),
+                [&](const Candidate& c) { return c.type == marker.type; });
+            if (candidate == candidates.end()) {
+                candidate = candidates.insert(candidates.end(), { marker.type, 0 });
+            }
+            candidate->found |= 1u << marker.rule;
+            if (m_probed[marker.type] & (1u << marker.rule)) {
+                probes.push_back({ marker.type, marker.rule, (uint32_t)index });
+            }
+        }
+    };
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const DirEntry& entry = entries[i];
+        auto named = m_names.find(entry.name);
+        if (named != m_names.end()) {
+            mark(named->second, entry, i);
+        }
+        size_t dot = entry.isDirectory || m_extensions.empty() ? std::string::npos : entry.name.rfind('.');
+        if (dot != std::string::npos && dot > 0) {
+            auto extension = m_extensions.find(std::string_view(entry.name).substr(dot));
+            if (extension != m_extensions.end()) {
+                mark(extension->second, entry, i);
+            }
+        }
+    }
+    if (candidates.empty()) {
+        return ProjectType::None;
+    }
+
+    // Registration order decides between types that all match
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.type < b.type; });
+    const std::vector<ProjectTypeDefinition>& types = m_registry.Types();
+    for (const Candidate& candidate : candidates) {
+        if ((candidate.found & m_required[candidate.type]) != m_required[candidate.type]) {
+            continue;
+        }
+        if (probed && m_probed[candidate.type]) {
+            *probed = true;
+        }
+        bool passed = true;
+        for (size_t rule = 0; passed && rule < ProjectTypeRegistry::kMaxMarkers; ++rule) {
+            if (!(m_probed[candidate.type] & (1u << rule))) {
+                continue;
+            }
+            // Any one of the matching files will do, e.g. one of several .sln files
+            const std::string& text = types[candidate.type].markers[rule].contains;
+            passed = std::any_of(probes.begin(), probes.end(), [&](const Probe& probe) {
+                return probe.type == candidate.type && probe.rule == rule &&
+                    ProbeFile(directory / entries[probe.entry].name, text);
+            });
+        }
+        if (passed) {
+            return types[candidate.type].type;
+        }
+    }
+    return ProjectType::None;
+}
+
+bool ProjectMatcher::ProbesFile(std::string_view name) const {
+    if (!m_hasProbes) {
+        return false;
+    }
+    auto probesAny = [this](const std::vector<Marker>& markers) {
+        return std::any_of(markers.begin(), markers.end(), [this](const Marker& marker) {
+            return !marker.directory && (m_probed[marker.type] & (1u << marker.rule));
+        });
+    };
+    auto named = m_names.find(name);
+    if (named != m_names.end() && probesAny(named->second)) {
+        return true;
+    }
+    size_t dot = name.rfind('.');
+    if (dot == std::string_view::npos || dot == 0) {
+        return false;
+    }
+    auto extension = m_extensions.find(name.substr(dot));
+    return extension != m_extensions.end() && probesAny(extension->second);
+}
+
+bool ProjectMatcher::Prunes(ProjectType type) const {
+    return m_prunes[(uint8_t)type];
+}
+
+void SetProjectTypes(ProjectTypeRegistry registry) {
+    Table().Publish(std::make_shared<ProjectMatcher>(std::move(registry)));
+}
+
+std::shared_ptr<const ProjectMatcher> CurrentProjectTypes() {
+    TypeTable& table = Table();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    return table.current;
+}
+
+const char* ProjectTypeName(ProjectType type) {
+    return Table().names[(uint8_t)type].load(std::memory_order_acquire);
+}
+
+uint32_t ProjectTypeRgb(ProjectType type) {
+    return Table().colors[(uint8_t)type].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "ProjectInfo.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct DirEntry;
+
+// Something a directory has to contain to be a project of some type.
+struct MarkerRule {
+    enum class Kind : uint8_t {
+        Directory, // a subdirectory called name
+        File,      // a file called name
+        Extension, // any file whose name ends in name, e.g. ".uproject"
+    };
+    Kind kind = Kind::File;
+    std::string name;
+    // Content probe for File and Extension rules: the file must contain this
+    // text, ignoring case, within its first kProbeBytes. Empty = no probe.
+    std::string contains;
+};
+
+// One kind of project the scanner looks for. A directory is one when every marker matches.
+struct ProjectTypeDefinition {
+    ProjectType type = ProjectType::None;
+    std::string name;          // shown in the UI and written by the CLI, e.g. "Unity"
+    uint32_t color = 0xCCCCCC; // 0xRRGGBB for its panel and rows
+    // false for build-system types such as CMake: engine projects often sit
+    // inside one, so the walk carries on below it instead of stopping there.
+    bool prune = true;
+    std::vector<MarkerRule> markers;
+};
+
+// The project types a scan recognises, in priority order: when a directory
+// matches several, the first wins (an Unreal project usually has a .sln and
+// Unity generates one too, so engines come before build systems).
+class ProjectTypeRegistry {
+public:
+    static constexpr size_t kMaxMarkers = 32;
+    static constexpr size_t kProbeBytes = 4096;
+
+    // Unity, Unreal, Godot, Visual Studio and CMake.
+    static ProjectTypeRegistry BuiltIn();
+
+    // Adds a type with its own value. Fails on a value or name already taken,
+    // no markers, more than kMaxMarkers, or a probe on a Directory rule.
+    bool Add(ProjectTypeDefinition definition, std::string& error);
+    // Adds a type described by spec (see ParseProjectTypeSpec) with the first
+    // free value from kFirstCustomProjectType on.
+    bool AddCustom(const std::string& spec, std::string& error);
+
+    const std::vector<ProjectTypeDefinition>& Types() const { return m_types; }
+    const ProjectTypeDefinition* Find(ProjectType type) const;
+    // Changes whenever the set of types or their rules change; part of the
+    // scan index's options hash so an index built with other rules isn't reused.
+    uint64_t Fingerprint() const;
+
+private:
+    std::vector<ProjectTypeDefinition> m_types;
+};
+
+// Reads a custom type written as "Name: rule, rule, ...", where each rule is
+// dir=NAME, file=NAME or ext=.EXT, and contains=TEXT adds a content probe to
+// the rule before it. For example
+//   Forge: file=forge.project, dir=Content, ext=.fmap, contains=forge-engine
+// Probe text can't contain commas. The type is left to the caller.
+bool ParseProjectTypeSpec(const std::string& spec, ProjectTypeDefinition& definition, std::string& error);
+// The spec ParseProjectTypeSpec reads back into definition's name and markers.
+std::string FormatProjectTypeSpec(const ProjectTypeDefinition& definition);
+
+// A registry compiled for classifying directories. Marker names and extensions
+// of every type go into two hash tables, so a listing is classified in a single
+// pass over its entries with at most two lookups each, however many types are
+// registered. Content probes only read files once a type's name rules have all
+// matched. Immutable; one is shared by every thread of a walk.
+class ProjectMatcher {
+public:
+    explicit ProjectMatcher(ProjectTypeRegistry registry);
+    ProjectMatcher(const ProjectMatcher&) = delete;
+    ProjectMatcher& operator=(const ProjectMatcher&) = delete;
+
+    // What kind of project directory is, from its listing. Only reads files for
+    // content probes, and sets *probed if it read any: the result then depends
+    // on file contents, not just names. Returns ProjectType::None for anything else.
+    ProjectType Classify(const std::filesystem::path& directory, const std::vector<DirEntry>& entries,
+        bool* probed = nullptr) const;
+    // Whether some type has a content probe on a file named name, so editing it
+    // can change what its directory is.
+    bool ProbesFile(std::string_view name) const;
+    bool HasProbes() const { return m_hasProbes; }
+    // Whether a walk stops at a project of this type (see ProjectTypeDefinition::prune).
+    bool Prunes(ProjectType type) const;
+
+    const ProjectTypeRegistry& Registry() const { return m_registry; }
+    uint64_t Fingerprint() const { return m_fingerprint; }
+
+private:
+    struct Marker {
+        uint16_t type;    // into m_registry.Types()
+        uint8_t rule;     // into that type's markers
+        bool directory;   // the entry must be a directory (else a file)
+    };
+
+    ProjectTypeRegistry m_registry;
+    uint64_t m_fingerprint = 0;
+    std::vector<uint32_t> m_required; // per type, a bit per marker
+    std::vector<uint32_t> m_probed;   // per type, the markers with a content probe
+    bool m_prunes[256] = {};          // by ProjectType value
+    bool m_hasProbes = false;
+    // Keys point into m_registry's rule names
+    std::unordered_map<std::string_view, std::vector<Marker>> m_names;
+    std::unordered_map<std::string_view, std::vector<Marker>> m_extensions;
+};
+
+// The types scans look for when ScanOptions::projectTypes isn't set. Starts out
+// as ProjectTypeRegistry::BuiltIn(). Walks already running keep the types they
+// started with.
+void SetProjectTypes(ProjectTypeRegistry registry);
+std::shared_ptr<const ProjectMatcher> CurrentProjectTypes();
+
+// Color of a type set with SetProjectTypes, as 0xRRGGBB; light grey if unknown.
+uint32_t ProjectTypeRgb(ProjectType type);
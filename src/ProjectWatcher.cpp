@@ -0,0 +1,385 @@
+#include "ProjectWatcher.h"
+#include "DirectoryLister.h"
+#include "ProjectTypes.h"
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Events are applied once the tree has been quiet this long, so a large copy
+// is handled as one batch instead of thousands of tiny ones.
+constexpr auto kDebounce = std::chrono::milliseconds(300);
+// A directory that never goes quiet (build output, temp files) would hold the
+// batch back forever; it is applied this long after its first event regardless.
+constexpr auto kMaxBatchDelay = std::chrono::seconds(2);
+// With the watch limit hit some directories are unwatched; check them this often.
+constexpr auto kUnwatchedRescanInterval = std::chrono::seconds(60);
+
+// Calls erase on every key in an ordered container that is prefix or below it.
+template <typename Container, typename Erase>
+void ForEachUnder(Container& container, const std::string& prefix, Erase erase) {
+    // Children sort between "prefix/" and "prefix" + the character after the separator
+    std::string first = prefix + (char)fs::path::preferred_separator;
+    std::string last = prefix + (char)(fs::path::preferred_separator + 1);
+    auto exact = container.find(prefix);
+    if (exact != container.end()) {
+        erase(exact);
+    }
+    auto it = container.lower_bound(first);
+    auto end = container.lower_bound(last);
+    while (it != end) {
+        it = erase(it);
+    }
+}
+
+}
+
+void ApplyProjectChanges(ProjectStore& projects, const ProjectChanges& changes) {
+    projects.RemoveUnder(changes.removed);
+    for (const auto& project : changes.added) {
+        projects.Add(project);
+    }
+}
+
+ProjectWatcher::~ProjectWatcher() {
+    Stop();
+}
+
+bool ProjectWatcher::IsSupported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ProjectWatcher::Start(const std::string& root, const ScanOptions& options, std::shared_ptr<const ScanIndex> index) {
+    Stop();
+    if (!IsSupported() || !index) {
+        return false;
+    }
+
+    m_root = root;
+    m_options = options;
+    m_options.parallel = false;
+    m_options.previous = nullptr;
+    m_options.record = nullptr;
+    if (!m_options.projectTypes) {
+        m_options.projectTypes = CurrentProjectTypes();
+    }
+    m_index = std::move(index);
+    m_watchCount = 0;
+    m_limitHit = false;
+    m_rescanRequested = false;
+    m_stop = false;
+    m_running = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_changes = ProjectChanges();
+    }
+    m_thread = std::thread(&ProjectWatcher::Run, this);
+    return true;
+}
+
+void ProjectWatcher::Stop() {
+    m_stop = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    m_running = false;
+}
+
+bool ProjectWatcher::Drain(ProjectChanges& changes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_changes.Empty()) {
+        return false;
+    }
+    changes = std::move(m_changes);
+    m_changes = ProjectChanges();
+    return true;
+}
+
+bool ProjectWatcher::RescanRequested() {
+    return m_rescanRequested.exchange(false);
+}
+
+void ProjectWatcher::Run() {
+#ifdef __linux__
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        m_running = false;
+        return;
+    }
+
+    // Subscribe everything the scan walked; projects are watched too so losing
+    // or gaining a marker reclassifies them
+    m_index->ForEachDirectory([this](const std::string& path, const ScanIndex::Record& record) {
+        if (m_stop.load(std::memory_order_relaxed)) {
+            return;
+        }
+        AddWatch(path);
+        if (ScanIndex::Type(record) != ProjectType::None) {
+            m_projectPaths.insert(path);
+        }
+    });
+    m_index.reset();
+    m_lastLimitRescan = std::chrono::steady_clock::now();
+
+    std::vector<Event> pending;
+    auto lastEvent = std::chrono::steady_clock::now();
+    auto firstEvent = lastEvent; // of the pending batch
+    while (!m_stop.load()) {
+        pollfd pfd = { m_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) > 0 && (pfd.revents & POLLIN)) {
+            bool wasEmpty = pending.empty();
+            if (!ReadEvents(pending)) {
+                // Queue overflowed: events were dropped, so only a rescan can catch up
+                pending.clear();
+                RequestRescan();
+            }
+            lastEvent = std::chrono::steady_clock::now();
+            if (wasEmpty) {
+                firstEvent = lastEvent;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (!pending.empty() && (now - lastEvent >= kDebounce || now - firstEvent >= kMaxBatchDelay)) {
+            ProcessBatch(pending);
+            pending.clear();
+        }
+        if (m_limitHit.load() && now - m_lastLimitRescan >= kUnwatchedRescanInterval) {
+            m_lastLimitRescan = now;
+            RequestRescan();
+        }
+    }
+
+    close(m_fd);
+    m_fd = -1;
+    m_pathByWatch.clear();
+    m_watchByPath.clear();
+    m_projectPaths.clear();
+#endif
+    m_running = false;
+}
+
+void ProjectWatcher::AddWatch(const std::string& path) {
+#ifdef __linux__
+    if (m_limitHit.load() || m_watchByPath.count(path)) {
+        return;
+    }
+    uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+    // Content probes make an edit in place matter too; ReadEvents keeps only those of probed files
+    if (m_options.projectTypes->HasProbes()) {
+        mask |= IN_CLOSE_WRITE;
+    }
+    int wd = inotify_add_watch(m_fd, path.c_str(), mask);
+    if (wd < 0) {
+        if (errno == ENOSPC) {
+            m_limitHit = true;
+        }
+        return;
+    }
+    // The same directory reached by a new path (e.g. after a move) keeps its descriptor
+    auto existing = m_pathByWatch.find(wd);
+    if (existing != m_pathByWatch.end()) {
+        m_watchByPath.erase(existing->second);
+    }
+    m_pathByWatch[wd] = path;
+    m_watchByPath[path] = wd;
+    m_watchCount = m_watchByPath.size();
+#else
+    (void)path;
+#endif
+}
+
+void ProjectWatcher::RemoveWatches(const std::string& path) {
+#ifdef __linux__
+    ForEachUnder(m_watchByPath, path, [this](std::map<std::string, int>::iterator it) {
+        inotify_rm_watch(m_fd, it->second);
+        m_pathByWatch.erase(it->second);
+        return m_watchByPath.erase(it);
+    });
+    m_watchCount = m_watchByPath.size();
+#else
+    (void)path;
+#endif
+}
+
+bool ProjectWatcher::ReadEvents(std::vector<Event>& events) {
+#ifdef __linux__
+    alignas(inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        ssize_t length = read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return true;
+        }
+        for (char* cursor = buffer; cursor < buffer + length;) {
+            const inotify_event* event = (const inotify_event*)cursor;
+            cursor += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                return false;
+            }
+            if (event->mask & IN_IGNORED) {
+                // Watched directory is gone; the parent's delete event does the rest
+                auto it = m_pathByWatch.find(event->wd);
+                if (it != m_pathByWatch.end()) {
+                    m_watchByPath.erase(it->second);
+                    m_pathByWatch.erase(it);
+                }
+                continue;
+            }
+            auto it = m_pathByWatch.find(event->wd);
+            if (it == m_pathByWatch.end() || event->len == 0) {
+                continue;
+            }
+            if ((event->mask & IN_CLOSE_WRITE) && !m_options.projectTypes->ProbesFile(event->name)) {
+                continue;
+            }
+            Event parsed;
+            parsed.directory = it->second;
+            parsed.name = event->name;
+            parsed.isDirectory = (event->mask & IN_ISDIR) != 0;
+            parsed.removed = (event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0;
+            events.push_back(std::move(parsed));
+        }
+    }
+#else
+    (void)events;
+    return true;
+#endif
+}
+
+int ProjectWatcher::DepthOf(const std::string& path) const {
+    int depth = 0;
+    for (const auto& part : fs::path(path).lexically_relative(m_root)) {
+        if (part != ".") {
+            ++depth;
+        }
+    }
+    return depth;
+}
+
+void ProjectWatcher::WalkSubtree(const std::string& path, bool classifyRoot, ProjectChanges& changes) {
+    ScanOptions options = m_options;
+    options.rootDepth = DepthOf(path);
+    options.classifyRoot = classifyRoot;
+    options.directoryVisited = [this](const std::string& directory) { AddWatch(directory); };
+
+    ScanCounters counters;
+    std::atomic<bool> cancel{false};
+    try {
+        WalkForProjects(path, options, counters, cancel, [&](ProjectInfo&& project, const ScanOrderKey&) {
+            if (m_projectPaths.insert(project.path).second) {
+                changes.added.push_back(std::move(project));
+            }
+        });
+    } catch (const std::exception&) {
+        // Gone again before we got to it; a later event or rescan settles it
+    }
+}
+
+void ProjectWatcher::ProcessBatch(const std::vector<Event>& events) {
+    // Group by directory, keeping event order within each
+    std::map<std::string, std::vector<const Event*>> byDirectory;
+    for (const auto& event : events) {
+        byDirectory[event.directory].push_back(&event);
+    }
+
+    ProjectChanges changes;
+    std::vector<std::string> rewalked;
+    ScanCounters counters;
+    std::vector<DirEntry> entries;
+    auto forgetProjectsUnder = [this](const std::string& path) {
+        ForEachUnder(m_projectPaths, path, [this](std::set<std::string>::iterator it) {
+            return m_projectPaths.erase(it);
+        });
+    };
+
+    for (const auto& [directory, directoryEvents] : byDirectory) {
+        bool covered = std::any_of(rewalked.begin(), rewalked.end(),
+            [&](const std::string& walked) { return IsSameOrUnder(directory, walked); });
+        if (covered) {
+            continue;
+        }
+
+        int64_t mtime = 0;
+        std::error_code ec;
+        if (!ListDirectory(directory, entries, mtime, counters, ec)) {
+            continue; // removed; handled through its parent
+        }
+
+        // Reclassify: gaining or losing a marker turns the directory into a project or back
+        ProjectType type = directory == m_root ? ProjectType::None : m_options.projectTypes->Classify(directory, entries);
+        bool wasProject = m_projectPaths.count(directory) != 0;
+        if (type != ProjectType::None && !wasProject) {
+            bool stops = StopsAtProject(type, m_options);
+            if (stops) {
+                // Whatever was found below it is part of the project now
+                changes.removed.push_back(directory);
+                forgetProjectsUnder(directory);
+            }
+            m_projectPaths.insert(directory);
+            changes.added.push_back({ fs::path(directory).filename().string(), directory, type });
+            if (stops) {
+                rewalked.push_back(directory);
+                continue;
+            }
+        } else if (type == ProjectType::None && wasProject) {
+            changes.removed.push_back(directory);
+            forgetProjectsUnder(directory);
+            // Its contents may have been pruned before; walk them now
+            WalkSubtree(directory, false, changes);
+            rewalked.push_back(directory);
+            continue;
+        } else if (StopsAtProject(type, m_options)) {
+            continue; // project contents aren't tracked
+        }
+
+        bool childrenDescend = m_options.maxDepth <= 0 || DepthOf(directory) < m_options.maxDepth;
+        for (const Event* event : directoryEvents) {
+            std::string child = (fs::path(directory) / event->name).string();
+            if (event->removed) {
+                changes.removed.push_back(child);
+                forgetProjectsUnder(child);
+                RemoveWatches(child);
+            } else if (event->isDirectory && childrenDescend && !IsSkippedDirectory(event->name, m_options)) {
+                WalkSubtree(child, true, changes);
+            }
+        }
+    }
+
+    if (changes.Empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_changes.removed.insert(m_changes.removed.end(), changes.removed.begin(), changes.removed.end());
+        for (auto& project : changes.added) {
+            m_changes.added.push_back(std::move(project));
+        }
+    }
+    if (m_changesCallback) {
+        m_changesCallback();
+    }
+}
+
+void ProjectWatcher::RequestRescan() {
+    m_rescanRequested = true;
+    if (m_changesCallback) {
+        m_changesCallback();
+    }
+}
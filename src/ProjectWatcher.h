@@ -0,0 +1,106 @@
+#pragma once
+
+#include "ProjectInfo.h"
+#include "ProjectStore.h"
+#include "ScanIndex.h"
+#include "Scanner.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Incremental edits to a project list, produced by ProjectWatcher.
+struct ProjectChanges {
+    std::vector<std::string> removed; // drop projects at or below each of these paths
+    std::vector<ProjectInfo> added;   // applied after the removals
+
+    bool Empty() const { return removed.empty() && added.empty(); }
+};
+
+// Applies removals then additions to projects.
+void ApplyProjectChanges(ProjectStore& projects, const ProjectChanges& changes);
+
+// Keeps a scanned tree's project list current without rescanning it. After a
+// scan completes, every directory it walked is subscribed for changes (inotify
+// on Linux). Events are debounced, then only the directories they touch are
+// re-listed: new subdirectories are walked, removed ones are dropped, and a
+// directory gaining or losing its project markers is reclassified.
+//
+// If the kernel's watch limit is hit or its event queue overflows, changes
+// may have been missed; the watcher then asks for a rescan (RescanRequested),
+// which the scan index keeps cheap since only changed directories are re-listed.
+// On platforms without a watcher backend Start() returns false and nothing happens.
+class ProjectWatcher {
+public:
+    ProjectWatcher() = default;
+    ~ProjectWatcher();
+
+    ProjectWatcher(const ProjectWatcher&) = delete;
+    ProjectWatcher& operator=(const ProjectWatcher&) = delete;
+
+    static bool IsSupported();
+
+    // Called from the watcher thread when there are changes to Drain() or a
+    // rescan is requested, so an idle UI can sleep until then. Set it before Start().
+    void SetChangesCallback(std::function<void()> callback) { m_changesCallback = std::move(callback); }
+
+    // Starts watching the tree described by index, which must come from a completed
+    // scan of root with options. Replaces any previous watch.
+    bool Start(const std::string& root, const ScanOptions& options, std::shared_ptr<const ScanIndex> index);
+    void Stop();
+
+    bool IsRunning() const { return m_running.load(); }
+    size_t WatchCount() const { return m_watchCount.load(); }
+    bool WatchLimitHit() const { return m_limitHit.load(); }
+
+    // Moves changes found since the last call into changes. Returns true if there were any.
+    bool Drain(ProjectChanges& changes);
+    // Returns true once each time the watcher decides changes may have been missed.
+    bool RescanRequested();
+
+private:
+    struct Event {
+        std::string directory;
+        std::string name;
+        bool isDirectory = false;
+        bool removed = false; // deleted or moved away; otherwise created, moved in or (a probed file) rewritten
+    };
+
+    void Run();
+    void AddWatch(const std::string& path);
+    void RemoveWatches(const std::string& path);
+    bool ReadEvents(std::vector<Event>& events);
+    void ProcessBatch(const std::vector<Event>& events);
+    void WalkSubtree(const std::string& path, bool classifyRoot, ProjectChanges& changes);
+    int DepthOf(const std::string& path) const;
+    void RequestRescan();
+
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_running{false};
+    std::atomic<size_t> m_watchCount{0};
+    std::atomic<bool> m_limitHit{false};
+    std::atomic<bool> m_rescanRequested{false};
+    std::function<void()> m_changesCallback;
+
+    // Owned by the watcher thread while it runs
+    std::string m_root;
+    ScanOptions m_options;
+    std::shared_ptr<const ScanIndex> m_index;
+    int m_fd = -1;
+    std::unordered_map<int, std::string> m_pathByWatch;
+    std::map<std::string, int> m_watchByPath; // ordered so a subtree is one range
+    std::set<std::string> m_projectPaths;
+    std::chrono::steady_clock::time_point m_lastLimitRescan;
+
+    std::mutex m_mutex; // guards m_changes
+    ProjectChanges m_changes;
+};
@@ -0,0 +1,88 @@
+#include "ScanArguments.h"
+#include "ProjectTypes.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+bool OptionValue(const char* arg, const char* prefix, const char** value) {
+    size_t length = strlen(prefix);
+    if (strncmp(arg, prefix, length) != 0) {
+        return false;
+    }
+    *value = arg + length;
+    return true;
+}
+
+bool ParseCount(const char* text, int& value) {
+    char* end = nullptr;
+    long parsed = strtol(text, &end, 10);
+    if (!*text || *end || parsed < 0 || parsed > 1 << 20) {
+        return false;
+    }
+    value = (int)parsed;
+    return true;
+}
+
+ScanArgument ParseScanArgument(const char* arg, ScanArguments& arguments, std::string& error) {
+    const char* value = nullptr;
+    int number = 0;
+    if (OptionValue(arg, "--depth=", &value)) {
+        if (!ParseCount(value, number)) {
+            error = std::string("Invalid depth: ") + value;
+            return ScanArgument::Invalid;
+        }
+        arguments.scan.maxDepth = number;
+    } else if (OptionValue(arg, "--threads=", &value)) {
+        if (!ParseCount(value, number)) {
+            error = std::string("Invalid thread count: ") + value;
+            return ScanArgument::Invalid;
+        }
+        arguments.scan.threadCount = (unsigned)number;
+    } else if (OptionValue(arg, "--root-threads=", &value)) {
+        if (!ParseCount(value, number)) {
+            error = std::string("Invalid thread count: ") + value;
+            return ScanArgument::Invalid;
+        }
+        arguments.rootThreads = (unsigned)number;
+    } else if (OptionValue(arg, "--backend=", &value)) {
+        if (!ParseScanBackend(value, arguments.scan.backend)) {
+            error = std::string("Unknown backend: ") + value;
+            return ScanArgument::Invalid;
+        }
+    } else if (OptionValue(arg, "--type=", &value)) {
+        arguments.customTypes.push_back(value);
+    } else if (OptionValue(arg, "--skip=", &value)) {
+        arguments.scan.skipDirectories = ParseNameList(value);
+    } else if (arg[0] == '-' && arg[1] == '-') {
+        return ScanArgument::Unknown;
+    } else {
+        arguments.roots.push_back({ arg, arguments.rootThreads });
+    }
+    return ScanArgument::Parsed;
+}
+
+void PrintScanArgumentsUsage(std::ostream& out) {
+    out <<
+        "  --depth=N            deepest directory level to scan, 0 = unlimited (default: 5)\n"
+        "  --threads=N          scan threads per root, 0 = one per hardware thread (default: 0)\n"
+        "  --root-threads=N     scan threads for the roots that follow, e.g. a slow network share\n"
+        "  --backend=NAME       portable, or io_uring to batch opens and stats on Linux (default: portable);\n"
+        "                       io_uring falls back to portable where the kernel doesn't offer it\n"
+        "  --type=SPEC          also look for a project type, e.g. \"Forge: file=forge.project, dir=Content\";\n"
+        "                       rules are dir=, file=, ext= and contains= (probes the rule before it)\n"
+        "  --skip=A,B,...       folder names never descended into\n"
+        "                       (default: " << kDefaultSkipDirectories << ")\n";
+}
+
+bool ApplyCustomTypes(const ScanArguments& arguments, std::string& error) {
+    ProjectTypeRegistry types = ProjectTypeRegistry::BuiltIn();
+    for (const std::string& spec : arguments.customTypes) {
+        if (!types.AddCustom(spec, error)) {
+            error = "Invalid --type: " + error;
+            return false;
+        }
+    }
+    SetProjectTypes(std::move(types));
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Scanner.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The command-line options every scanning tool takes (ProjectNavigatorCli and
+// ProjectNavigatorDaemon): where to scan and how. Tools derive their own
+// options from this and hand each argument they don't know to ParseScanArgument.
+struct ScanArguments {
+    ScanArguments() { scan.maxDepth = 5; }
+
+    std::vector<ScanRoot> roots;
+    std::vector<std::string> customTypes; // --type specs
+    ScanOptions scan;
+    unsigned rootThreads = 0; // --root-threads, for the roots that follow
+};
+
+enum class ScanArgument {
+    Parsed,
+    Invalid, // a shared option with a bad value; error says why
+    Unknown, // an option that isn't one of the shared ones
+};
+
+// If arg is a shared option (--depth, --threads, --root-threads, --backend,
+// --type, --skip) or a root, adds it to arguments.
+ScanArgument ParseScanArgument(const char* arg, ScanArguments& arguments, std::string& error);
+
+// Writes the usage lines of the shared options, in PrintUsage's layout.
+void PrintScanArgumentsUsage(std::ostream& out);
+
+// Makes the built-in types plus arguments.customTypes the ones scans look for
+// (SetProjectTypes). Returns false with error set if a spec doesn't parse.
+bool ApplyCustomTypes(const ScanArguments& arguments, std::string& error);
+
+// For the tools' own options: true if arg starts with prefix, with *value
+// pointing after it.
+bool OptionValue(const char* arg, const char* prefix, const char** value);
+// A count from 0 to about a million, as options take them.
+bool ParseCount(const char* text, int& value);
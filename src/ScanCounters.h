@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Live counters updated by the walker while it runs. Safe to read from any thread.
+struct ScanCounters {
+    std::atomic<uint64_t> directoriesVisited{0};
+    std::atomic<uint64_t> projectsFound{0};
+    std::atomic<uint64_t> directoriesSkipped{0}; // matched the skip list
+    // Filesystem work, so the cost per directory can be checked
+    std::atomic<uint64_t> directoriesListed{0}; // one open + read of a directory each
+    std::atomic<uint64_t> entriesSeen{0};
+    std::atomic<uint64_t> statCalls{0};         // type and mtime lookups
+    // System calls made for the above: opens, getdents, stats and closes on the
+    // portable backend, io_uring_enter and getdents on io_uring, where opens,
+    // stats and closes go through the ring
+    std::atomic<uint64_t> syscalls{0};
+    std::atomic<uint64_t> directoriesReused{0}; // unchanged since the previous index, not listed
+    std::atomic<uint64_t> directoriesFailed{0}; // couldn't be read, even after retrying
+
+    void Reset() {
+        directoriesVisited = 0;
+        projectsFound = 0;
+        directoriesSkipped = 0;
+        directoriesListed = 0;
+        entriesSeen = 0;
+        statCalls = 0;
+        syscalls = 0;
+        directoriesReused = 0;
+        directoriesFailed = 0;
+    }
+};
@@ -0,0 +1,204 @@
+#include "ScanEngine.h"
+#include "Trace.h"
+
+#include <cstdio>
+#include <exception>
+#include <utility>
+
+namespace {
+
+uint64_t HashString(uint64_t hash, const std::string& text) {
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// An index only describes its root's tree as seen alongside the same other roots:
+// a subtree claimed by a nested root is missing from the outer one. So indexes
+// are reused only within the same workspace.
+uint64_t HashWorkspace(const std::vector<ScanRoot>& roots, const ScanOptions& options) {
+    uint64_t hash = HashScanOptions(options);
+    for (const ScanRoot& root : roots) {
+        hash = HashString(hash, root.path) * 31 + 1;
+    }
+    return hash;
+}
+
+}
+
+ScanEngine::~ScanEngine() {
+    Stop();
+}
+
+std::string ScanEngine::IndexPath(const std::string& root) const {
+    // One file per root, named by a hash of its path
+    uint64_t hash = HashString(14695981039346656037ull, root);
+    char suffix[20];
+    snprintf(suffix, sizeof(suffix), ".%016llx", (unsigned long long)hash);
+    return m_indexBase + suffix;
+}
+
+size_t ScanEngine::LoadIndexes(const std::string& basePath, const std::vector<std::string>& roots) {
+    m_indexBase = basePath;
+    size_t loaded = 0;
+    for (const std::string& root : roots) {
+        auto index = std::make_shared<ScanIndex>();
+        if (!index->Load(IndexPath(root)) || index->Root() != root) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_indexes[root] = index;
+        ++loaded;
+    }
+    return loaded;
+}
+
+std::shared_ptr<const ScanIndex> ScanEngine::Index(const std::string& root) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_indexes.find(root);
+    return it != m_indexes.end() ? it->second : nullptr;
+}
+
+void ScanEngine::Start(const std::vector<ScanRoot>& roots, const ScanOptions& options) {
+    Stop();
+
+    m_roots = roots;
+    m_counters.Reset();
+    m_errors.Clear();
+    m_cancel = false;
+    m_running = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.clear();
+        m_keys.clear();
+        m_finished = false;
+        m_result = Finished();
+    }
+    uint64_t workspaceHash = HashWorkspace(roots, options);
+    std::vector<ScanOptions> rootOptions(roots.size(), options);
+    for (size_t i = 0; i < roots.size(); ++i) {
+        rootOptions[i].errors = &m_errors;
+        std::shared_ptr<const ScanIndex> previous = Index(roots[i].path);
+        if (previous && previous->OptionsHash() == workspaceHash) {
+            rootOptions[i].previous = previous;
+        }
+    }
+    m_worker = std::thread(&ScanEngine::Run, this, roots, std::move(rootOptions), workspaceHash);
+}
+
+void ScanEngine::Cancel() {
+    m_cancel = true;
+}
+
+void ScanEngine::Stop() {
+    m_cancel = true;
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+ScanEngine::Progress ScanEngine::GetProgress() const {
+    Progress progress;
+    progress.directoriesVisited = m_counters.directoriesVisited.load(std::memory_order_relaxed);
+    progress.projectsFound = m_counters.projectsFound.load(std::memory_order_relaxed);
+    progress.directoriesListed = m_counters.directoriesListed.load(std::memory_order_relaxed);
+    progress.entriesSeen = m_counters.entriesSeen.load(std::memory_order_relaxed);
+    progress.statCalls = m_counters.statCalls.load(std::memory_order_relaxed);
+    progress.directoriesReused = m_counters.directoriesReused.load(std::memory_order_relaxed);
+    progress.directoriesFailed = m_counters.directoriesFailed.load(std::memory_order_relaxed);
+    progress.running = m_running.load();
+    return progress;
+}
+
+bool ScanEngine::Drain(ProjectStore& out) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending.empty()) {
+        return false;
+    }
+    for (const auto& project : m_pending) {
+        out.Add(project);
+    }
+    m_pending.clear();
+    return true;
+}
+
+bool ScanEngine::PollFinished(Finished& finished) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_finished || !m_pending.empty()) {
+        return false;
+    }
+    m_finished = false;
+    finished = std::move(m_result);
+    m_result = Finished();
+    return true;
+}
+
+void ScanEngine::Run(std::vector<ScanRoot> roots, std::vector<ScanOptions> options, uint64_t workspaceHash) {
+    TRACE_SCOPE("Scan");
+    std::vector<std::unique_ptr<ScanIndexBuilder>> builders;
+    for (ScanOptions& rootOptions : options) {
+        builders.push_back(std::make_unique<ScanIndexBuilder>());
+        rootOptions.record = builders.back().get();
+    }
+
+    Finished result;
+    result.roots = WalkRoots(roots, options, m_counters, m_cancel,
+        [this](size_t root, ProjectInfo&& project, const ScanOrderKey& key) {
+            ScanOrderKey rootKey;
+            rootKey.reserve(key.size() + 1);
+            rootKey.push_back((uint32_t)root);
+            rootKey.insert(rootKey.end(), key.begin(), key.end());
+            bool first;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                first = m_pending.empty();
+                m_pending.push_back(std::move(project));
+                m_keys.push_back(std::move(rootKey));
+            }
+            // Once per batch: the rest land in the same Drain()
+            if (first && m_resultsCallback) {
+                m_resultsCallback();
+            }
+        });
+
+    result.failures = m_errors.Failures();
+    result.failureCount = m_errors.Count();
+
+    // Only a complete walk describes a tree well enough to skip work next time
+    std::vector<std::shared_ptr<ScanIndex>> indexes(roots.size());
+    for (size_t i = 0; i < roots.size(); ++i) {
+        const RootScanResult& rootResult = result.roots[i];
+        result.cancelled = result.cancelled || rootResult.cancelled;
+        if (!rootResult.error.empty()) {
+            result.error += (result.error.empty() ? "" : "; ") + roots[i].path + ": " + rootResult.error;
+            continue;
+        }
+        if (rootResult.cancelled) {
+            continue;
+        }
+        TRACE_SCOPE("BuildIndex");
+        indexes[i] = builders[i]->Build(roots[i].path, workspaceHash);
+        if (!m_indexBase.empty()) {
+            indexes[i]->Save(IndexPath(roots[i].path));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < roots.size(); ++i) {
+            if (indexes[i]) {
+                m_indexes[roots[i].path] = indexes[i];
+            }
+        }
+        result.order = SortByScanOrder(m_keys);
+        m_keys.clear();
+        m_result = std::move(result);
+        m_finished = true;
+        m_running = false;
+    }
+    if (m_resultsCallback) {
+        m_resultsCallback();
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ProjectInfo.h"
+#include "ProjectStore.h"
+#include "ScanIndex.h"
+#include "Scanner.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs project scans of a workspace (one or more roots) off the UI thread. The
+// roots are walked concurrently by WalkRoots, each with its own thread limit,
+// and overlapping roots are de-duplicated. Found projects are queued as they
+// are discovered and handed to the UI through Drain(), which the main loop
+// calls once per frame. Starting a new scan cancels and replaces the current
+// one. Each root that completes is saved as its own ScanIndex, and the next
+// scan of that root only re-lists directories that changed since. Folders that
+// can't be read don't end a scan: they are skipped and listed in Finished.
+class ScanEngine {
+public:
+    struct Progress {
+        uint64_t directoriesVisited = 0;
+        uint64_t projectsFound = 0;
+        uint64_t directoriesListed = 0;
+        uint64_t entriesSeen = 0;
+        uint64_t statCalls = 0;
+        uint64_t directoriesReused = 0;
+        uint64_t directoriesFailed = 0;
+        bool running = false;
+    };
+
+    struct Finished {
+        std::string error;          // empty if every root succeeded; otherwise "root: message" per failed root
+        bool cancelled = false;
+        std::vector<size_t> order;  // permutation for ProjectStore::Reorder over everything drained
+        std::vector<RootScanResult> roots; // one per root, in Roots() order
+        std::vector<ScanFailure> failures; // folders skipped because they couldn't be read, up to ScanErrorLog::kMaxKept
+        size_t failureCount = 0;           // all of them, including any beyond that
+    };
+
+    ScanEngine() = default;
+    ~ScanEngine();
+
+    ScanEngine(const ScanEngine&) = delete;
+    ScanEngine& operator=(const ScanEngine&) = delete;
+
+    // Loads the indexes saved by an earlier run for roots; each root's index lives
+    // in its own file named after basePath, and completed scans are saved back
+    // there. Returns how many roots had a usable index.
+    size_t LoadIndexes(const std::string& basePath, const std::vector<std::string>& roots);
+    // Index of the last completed scan of root, or null.
+    std::shared_ptr<const ScanIndex> Index(const std::string& root);
+
+    // Called from the scan thread when there is something new for Drain() or
+    // PollFinished(), so an idle UI can sleep until then. Set it before Start().
+    void SetResultsCallback(std::function<void()> callback) { m_resultsCallback = std::move(callback); }
+
+    // Cancels any scan in flight and starts walking roots on worker threads.
+    // Projects come out ordered by root, then in walk order.
+    void Start(const std::vector<ScanRoot>& roots, const ScanOptions& options = ScanOptions());
+    // Asks the current scan to stop. Does not wait; the worker exits at its next check.
+    void Cancel();
+    // Cancels the current scan and waits for the worker to exit.
+    void Stop();
+
+    bool IsRunning() const { return m_running.load(); }
+    const std::vector<ScanRoot>& Roots() const { return m_roots; }
+    Progress GetProgress() const;
+
+    // Appends projects found since the last call to out. Returns true if any were added.
+    bool Drain(ProjectStore& out);
+    // Returns true exactly once after each scan ends (finished, failed or cancelled),
+    // and only once everything it found has been drained.
+    bool PollFinished(Finished& finished);
+
+private:
+    void Run(std::vector<ScanRoot> roots, std::vector<ScanOptions> options, uint64_t workspaceHash);
+    std::string IndexPath(const std::string& root) const;
+
+    std::thread m_worker;
+    std::vector<ScanRoot> m_roots;
+    std::string m_indexBase;
+    std::atomic<bool> m_cancel{false};
+    std::atomic<bool> m_running{false};
+    ScanCounters m_counters;
+    ScanErrorLog m_errors;
+    std::function<void()> m_resultsCallback;
+
+    std::mutex m_mutex; // guards everything below
+    std::vector<ProjectInfo> m_pending;
+    std::vector<ScanOrderKey> m_keys; // one per project found, in the order they were queued; root index first
+    bool m_finished = false;
+    Finished m_result;
+    std::map<std::string, std::shared_ptr<const ScanIndex>> m_indexes; // by root
+};
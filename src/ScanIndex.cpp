@@ -0,0 +1,223 @@
+#include "ScanIndex.h"
+#include "ConfigStore.h"
+#include "ProjectTypes.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+namespace {
+
+constexpr uint32_t kIndexMagic = 0x58494E50; // "PNIX"
+// 2 added kFlagProbed; older indexes can't tell which classifications read files
+constexpr uint32_t kIndexVersion = 2;
+
+struct IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t optionsHash;
+    uint32_t rootLength;
+    uint32_t recordCount;
+    uint32_t namesSize;
+    uint32_t reserved;
+};
+
+uint64_t Fnv1a(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+}
+
+std::string_view ScanIndex::Name(const Record& record) const {
+    return std::string_view(m_names.data() + record.nameOffset, record.nameLength);
+}
+
+bool ScanIndex::Load(const std::string& path) {
+    TRACE_SCOPE("LoadIndex");
+    *this = ScanIndex();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    TRACE_COUNT(BytesRead, data.size());
+
+    IndexHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != kIndexMagic || header.version != kIndexVersion) {
+        return false;
+    }
+    size_t recordBytes = (size_t)header.recordCount * sizeof(Record);
+    if (data.size() != sizeof(header) + header.rootLength + recordBytes + header.namesSize) {
+        return false;
+    }
+
+    const char* cursor = data.data() + sizeof(header);
+    m_root.assign(cursor, header.rootLength);
+    cursor += header.rootLength;
+    m_records.resize(header.recordCount);
+    memcpy(m_records.data(), cursor, recordBytes);
+    cursor += recordBytes;
+    m_names.assign(cursor, header.namesSize);
+    m_optionsHash = header.optionsHash;
+
+    // Reject anything pointing outside the file rather than trusting it later.
+    // Records are stored level by level, so children always come after their
+    // parent; one pointing back at itself or an ancestor would make
+    // ForEachDirectory loop forever.
+    for (size_t index = 0; index < m_records.size(); ++index) {
+        const Record& record = m_records[index];
+        if ((uint64_t)record.nameOffset + record.nameLength > m_names.size() ||
+            (record.childCount && (record.firstChild <= index ||
+                (uint64_t)record.firstChild + record.childCount > m_records.size()))) {
+            *this = ScanIndex();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ScanIndex::Save(const std::string& path) const {
+    TRACE_SCOPE("SaveIndex");
+    IndexHeader header = {};
+    header.magic = kIndexMagic;
+    header.version = kIndexVersion;
+    header.optionsHash = m_optionsHash;
+    header.rootLength = (uint32_t)m_root.size();
+    header.recordCount = (uint32_t)m_records.size();
+    header.namesSize = (uint32_t)m_names.size();
+
+    std::string data;
+    data.reserve(sizeof(header) + m_root.size() + m_records.size() * sizeof(Record) + m_names.size());
+    data.append((const char*)&header, sizeof(header));
+    data.append(m_root);
+    data.append((const char*)m_records.data(), m_records.size() * sizeof(Record));
+    data.append(m_names);
+    return WriteFileAtomically(path, data);
+}
+
+void ScanIndex::ForEachDirectory(const std::function<void(const std::string& path, const Record& record)>& visit) const {
+    if (m_records.empty()) {
+        return;
+    }
+
+    // Depth-first from the root, children pushed in reverse so they come off in walk order
+    std::vector<std::pair<uint32_t, std::filesystem::path>> stack;
+    stack.push_back({ 0, std::filesystem::path(m_root) });
+    while (!stack.empty()) {
+        uint32_t index = stack.back().first;
+        std::filesystem::path path = std::move(stack.back().second);
+        stack.pop_back();
+
+        const Record& record = m_records[index];
+        visit(path.string(), record);
+        for (uint32_t i = record.childCount; i > 0; --i) {
+            const Record& child = m_records[record.firstChild + i - 1];
+            stack.push_back({ record.firstChild + i - 1, path / std::string(Name(child)) });
+        }
+    }
+}
+
+ProjectStore ScanIndex::Projects() const {
+    ProjectStore projects;
+    ForEachDirectory([&](const std::string& path, const Record& record) {
+        if (Type(record) != ProjectType::None) {
+            projects.Add(path, Type(record));
+        }
+    });
+    return projects;
+}
+
+void ScanIndexBuilder::Add(const ScanOrderKey& key, std::string_view name, int64_t mtime, ProjectType type, uint8_t flags) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.push_back({ key, std::string(name), mtime, (uint8_t)type, flags });
+}
+
+std::shared_ptr<ScanIndex> ScanIndexBuilder::Build(const std::string& root, uint64_t optionsHash) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto index = std::make_shared<ScanIndex>();
+    index->m_root = root;
+    index->m_optionsHash = optionsHash;
+
+    // Level by level, walk order within a level: siblings end up next to each other
+    std::sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b) {
+        if (a.key.size() != b.key.size()) {
+            return a.key.size() < b.key.size();
+        }
+        return a.key < b.key;
+    });
+
+    index->m_records.resize(m_entries.size());
+    size_t levelStart = 0;     // first entry of the current level
+    size_t parentLevel = 0;    // first entry of the level above
+    size_t parent = 0;
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        const Entry& entry = m_entries[i];
+        if (i > 0 && entry.key.size() != m_entries[i - 1].key.size()) {
+            parentLevel = levelStart;
+            levelStart = i;
+            parent = parentLevel;
+        }
+
+        ScanIndex::Record& record = index->m_records[i];
+        record = ScanIndex::Record();
+        record.mtime = entry.mtime;
+        record.parent = ScanIndex::kNone;
+        record.nameOffset = (uint32_t)index->m_names.size();
+        record.nameLength = (uint32_t)entry.name.size();
+        record.type = entry.type;
+        record.flags = entry.flags;
+        index->m_names += entry.name;
+
+        if (entry.key.empty()) {
+            continue;
+        }
+        // Parents are in the same order as their children, so one forward pass finds them all
+        auto isParent = [&](size_t candidate) {
+            const ScanOrderKey& parentKey = m_entries[candidate].key;
+            return std::equal(parentKey.begin(), parentKey.end(), entry.key.begin());
+        };
+        auto isBeforeParent = [&](size_t candidate) {
+            const ScanOrderKey& parentKey = m_entries[candidate].key;
+            return std::lexicographical_compare(parentKey.begin(), parentKey.end(), entry.key.begin(), entry.key.end() - 1);
+        };
+        while (parent < levelStart && isBeforeParent(parent)) {
+            ++parent;
+        }
+        if (parent < levelStart && m_entries[parent].key.size() + 1 == entry.key.size() && isParent(parent)) {
+            ScanIndex::Record& parentRecord = index->m_records[parent];
+            if (parentRecord.childCount == 0) {
+                parentRecord.firstChild = (uint32_t)i;
+            }
+            ++parentRecord.childCount;
+            record.parent = (uint32_t)parent;
+        }
+    }
+    m_entries.clear();
+    return index;
+}
+
+uint64_t HashScanOptions(const ScanOptions& options) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = Fnv1a(hash, &options.maxDepth, sizeof(options.maxDepth));
+    hash = Fnv1a(hash, &options.pruneProjects, sizeof(options.pruneProjects));
+    uint64_t types = (options.projectTypes ? options.projectTypes : CurrentProjectTypes())->Fingerprint();
+    hash = Fnv1a(hash, &types, sizeof(types));
+    for (const auto& name : options.skipDirectories) {
+        hash = Fnv1a(hash, name.data(), name.size() + 1);
+    }
+    return hash;
+}
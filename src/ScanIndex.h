@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ProjectInfo.h"
+#include "ProjectStore.h"
+#include "Scanner.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Persistent record of the last completed scan: every directory visited, its
+// mtime and classification, and the projects found. Lets startup show the
+// previous results straight away and lets a rescan skip re-listing any
+// directory whose mtime hasn't changed.
+//
+// On disk it is a small header, one fixed-size record per directory and a
+// string pool of names, so loading is a single read with no per-entry parsing.
+// Records are stored level by level in walk order, which keeps the children of
+// any directory contiguous.
+class ScanIndex {
+public:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+    enum : uint8_t {
+        kFlagDescended = 1 << 0, // children were walked and are recorded
+        kFlagSymlink = 1 << 1,
+        kFlagProbed = 1 << 2, // classified by file contents, which an unchanged mtime doesn't vouch for
+    };
+
+    struct Record {
+        int64_t mtime;
+        uint32_t parent;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t firstChild;
+        uint32_t childCount;
+        uint8_t type; // a ProjectType
+        uint8_t flags;
+        uint16_t reserved;
+    };
+
+    // Returns false (leaving the index empty) if the file is missing, truncated or from another version.
+    bool Load(const std::string& path);
+    // Written with WriteFileAtomically, so a crash never leaves a half-written index.
+    bool Save(const std::string& path) const;
+
+    bool Empty() const { return m_records.empty(); }
+    size_t Size() const { return m_records.size(); }
+    const std::string& Root() const { return m_root; }
+    uint64_t OptionsHash() const { return m_optionsHash; }
+
+    uint32_t RootRecord() const { return m_records.empty() ? kNone : 0; }
+    const Record& Get(uint32_t index) const { return m_records[index]; }
+    std::string_view Name(const Record& record) const;
+
+    // Visits every directory in serial walk order with its full path rebuilt from the root.
+    void ForEachDirectory(const std::function<void(const std::string& path, const Record& record)>& visit) const;
+    // Projects in serial walk order.
+    ProjectStore Projects() const;
+    static ProjectType Type(const Record& record) { return (ProjectType)record.type; }
+
+private:
+    friend class ScanIndexBuilder;
+
+    std::string m_root;
+    uint64_t m_optionsHash = 0;
+    std::vector<Record> m_records;
+    std::string m_names;
+};
+
+// Collects directories from a running walk (from any thread) and turns them into a ScanIndex.
+class ScanIndexBuilder {
+public:
+    void Add(const ScanOrderKey& key, std::string_view name, int64_t mtime, ProjectType type, uint8_t flags);
+    std::shared_ptr<ScanIndex> Build(const std::string& root, uint64_t optionsHash);
+
+private:
+    struct Entry {
+        ScanOrderKey key;
+        std::string name;
+        int64_t mtime;
+        uint8_t type;
+        uint8_t flags;
+    };
+
+    std::mutex m_mutex;
+    std::vector<Entry> m_entries;
+};
+
+// Identifies the options that change which directories a walk visits. An index
+// built with different options can't be reused for an incremental rescan.
+uint64_t HashScanOptions(const ScanOptions& options);
@@ -0,0 +1,933 @@
+#include "ScanService.h"
+#include "ProjectTypes.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+
+// Frames larger than this are taken as a corrupt stream
+constexpr uint32_t kMaxFrame = 1u << 30;
+// A client this far behind on reading is dropped rather than buffered for
+constexpr size_t kMaxBacklog = 256u << 20;
+// How often a running scan's progress goes out
+constexpr int kProgressMs = 500;
+
+// Builds one frame: a length slot, the message type, then the payload.
+class FrameWriter {
+public:
+    explicit FrameWriter(ServiceMessage type) {
+        m_data.resize(sizeof(uint32_t));
+        m_data.push_back((char)type);
+    }
+
+    void Byte(uint8_t value) { m_data.push_back((char)value); }
+    void U32(uint32_t value) { m_data.append((const char*)&value, sizeof(value)); }
+    void Varint(uint64_t value) {
+        while (value >= 0x80) {
+            m_data.push_back((char)(value | 0x80));
+            value >>= 7;
+        }
+        m_data.push_back((char)value);
+    }
+    void String(std::string_view text) {
+        Varint(text.size());
+        m_data.append(text.data(), text.size());
+    }
+
+    std::string Finish() {
+        uint32_t length = (uint32_t)(m_data.size() - sizeof(uint32_t));
+        memcpy(&m_data[0], &length, sizeof(length));
+        return std::move(m_data);
+    }
+
+private:
+    std::string m_data;
+};
+
+// Cursor over one payload. Every read fails once the data runs out.
+struct PayloadReader {
+    std::string_view data;
+
+    bool Byte(uint8_t& value) {
+        if (data.empty()) {
+            return false;
+        }
+        value = (uint8_t)data[0];
+        data.remove_prefix(1);
+        return true;
+    }
+    bool U32(uint32_t& value) {
+        if (data.size() < sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, data.data(), sizeof(value));
+        data.remove_prefix(sizeof(value));
+        return true;
+    }
+    bool Varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = 0;
+            if (!Byte(byte)) {
+                return false;
+            }
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    bool String(std::string& text) {
+        uint64_t size = 0;
+        if (!Varint(size) || size > data.size()) {
+            return false;
+        }
+        text.assign(data.data(), (size_t)size);
+        data.remove_prefix((size_t)size);
+        return true;
+    }
+};
+
+ProjectInfo MakeProject(std::string path, ProjectType type) {
+    ProjectInfo project;
+    project.name = std::filesystem::path(path).filename().string();
+    project.path = std::move(path);
+    project.type = type;
+    return project;
+}
+
+std::string ChangesFrame(const ProjectChanges& changes) {
+    FrameWriter frame(ServiceMessage::Changes);
+    frame.Varint(changes.removed.size());
+    for (const std::string& path : changes.removed) {
+        frame.String(path);
+    }
+    frame.Varint(changes.added.size());
+    for (const ProjectInfo& project : changes.added) {
+        frame.Byte((uint8_t)project.type);
+        frame.String(project.path);
+    }
+    return frame.Finish();
+}
+
+#ifndef _WIN32
+
+bool ToSocketAddress(const std::string& path, sockaddr_un& address, std::string& error) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        error = "Socket path must be 1 to " + std::to_string(sizeof(address.sun_path) - 1) + " characters: " + path;
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool ReadFully(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t got = read(fd, data, size);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        data += got;
+        size -= (size_t)got;
+    }
+    return true;
+}
+
+bool WriteFully(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+// The user the process at the other end of a Unix socket runs as.
+bool PeerUid(int fd, uid_t& uid) {
+#ifdef __linux__
+    ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return false;
+    }
+    uid = credentials.uid;
+    return true;
+#else
+    gid_t gid;
+    return getpeereid(fd, &uid, &gid) == 0;
+#endif
+}
+
+#endif
+
+}
+
+std::string DefaultScanServicePath() {
+    const char* path = getenv("PROJECTNAVIGATOR_SOCKET");
+    if (path && *path) {
+        return path;
+    }
+    // Only this user can create files in the runtime directory; anyone can in /tmp
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) {
+        return std::string(runtime) + "/projectnavigator.sock";
+    }
+    return "/tmp/projectnavigator.sock";
+}
+
+ScanService::~ScanService() {
+    Stop();
+}
+
+ScanServiceClient::~ScanServiceClient() {
+    Disconnect();
+}
+
+#ifndef _WIN32
+
+bool ScanService::Start(const std::string& socketPath, const std::vector<ScanRoot>& roots, const ScanOptions& options,
+    const std::string& indexBase, bool shared, std::string& error) {
+    Stop();
+    sockaddr_un address;
+    if (!ToSocketAddress(socketPath, address, error)) {
+        return false;
+    }
+    // A socket file left by a service that died is replaced; a live one is not
+    struct stat info;
+    if (lstat(socketPath.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            error = socketPath + " exists and isn't a socket";
+            return false;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool answering = probe >= 0 && connect(probe, (const sockaddr*)&address, sizeof(address)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (answering) {
+            error = "Another scan service is already running on " + socketPath;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_listenFd < 0 || bind(m_listenFd, (const sockaddr*)&address, sizeof(address)) != 0 ||
+            chmod(socketPath.c_str(), shared ? 0666 : 0600) != 0 || listen(m_listenFd, 64) != 0 ||
+            pipe2(m_wakeFds, O_NONBLOCK | O_CLOEXEC) != 0) {
+        error = "Can't listen on " + socketPath + ": " + strerror(errno);
+        Stop();
+        return false;
+    }
+    m_socketPath = socketPath;
+    m_roots = roots;
+    m_options = options;
+    if (!m_options.projectTypes) {
+        m_options.projectTypes = CurrentProjectTypes();
+    }
+
+    // Until the first scan completes, clients get the list the last run left behind
+    m_engine.SetResultsCallback([this] { Wake(); });
+    if (!indexBase.empty()) {
+        std::vector<std::string> rootPaths;
+        for (const ScanRoot& root : roots) {
+            rootPaths.push_back(root.path);
+        }
+        m_engine.LoadIndexes(indexBase, rootPaths);
+        for (const std::string& root : rootPaths) {
+            if (std::shared_ptr<const ScanIndex> index = m_engine.Index(root)) {
+                ProjectStore indexed = index->Projects();
+                for (size_t i = 0; i < indexed.Size(); ++i) {
+                    m_projects.Add(indexed.Path(i), indexed.Type(i));
+                }
+            }
+        }
+    }
+    StartScan();
+    m_stop = false;
+    m_thread = std::thread(&ScanService::Run, this);
+    return true;
+}
+
+void ScanService::Stop() {
+    m_stop = true;
+    if (m_thread.joinable()) {
+        Wake();
+        m_thread.join();
+    }
+    for (Client& client : m_clients) {
+        close(client.fd);
+    }
+    m_clients.clear();
+    m_clientCount = 0;
+    m_watchers.clear();
+    m_engine.Stop();
+    if (m_listenFd >= 0) {
+        close(m_listenFd);
+        m_listenFd = -1;
+        if (!m_socketPath.empty()) {
+            unlink(m_socketPath.c_str());
+        }
+    }
+    for (int& fd : m_wakeFds) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    m_socketPath.clear();
+    m_projects.Clear();
+    m_scanning.Clear();
+    m_search.Clear();
+    m_snapshot.clear();
+    m_status = ScanServiceStatus();
+}
+
+void ScanService::Wake() {
+    char byte = 1;
+    // A full pipe already has a wake-up pending
+    (void)!write(m_wakeFds[1], &byte, 1);
+}
+
+void ScanService::Run() {
+    std::vector<pollfd> fds;
+    while (!m_stop) {
+        fds.clear();
+        fds.push_back({ m_wakeFds[0], POLLIN, 0 });
+        fds.push_back({ m_listenFd, POLLIN, 0 });
+        for (const Client& client : m_clients) {
+            short events = POLLIN;
+            if (client.out.size() > client.outOffset) {
+                events |= POLLOUT;
+            }
+            fds.push_back({ client.fd, events, 0 });
+        }
+        int timeout = m_engine.IsRunning() ? kProgressMs : -1;
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            char drained[64];
+            while (read(m_wakeFds[0], drained, sizeof(drained)) > 0) {
+            }
+        }
+        if (m_stop) {
+            break;
+        }
+        Update();
+
+        // Only the clients that were polled; Accept() appends after them
+        size_t polled = fds.size() - 2;
+        for (size_t i = 0; i < polled; ++i) {
+            Client& client = m_clients[i];
+            short events = fds[i + 2].revents;
+            if (!client.closed && (events & (POLLIN | POLLHUP | POLLERR)) && !ReadFrom(client)) {
+                client.closed = true;
+            }
+            if (!client.closed && (events & POLLOUT) && !WriteTo(client)) {
+                client.closed = true;
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            Accept();
+        }
+        for (const Client& client : m_clients) {
+            if (client.closed) {
+                close(client.fd);
+            }
+        }
+        m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(), [](const Client& c) { return c.closed; }),
+            m_clients.end());
+        m_clientCount = m_clients.size();
+    }
+}
+
+void ScanService::StartScan() {
+    m_watchers.clear();
+    m_scanning.Clear();
+    m_engine.Start(m_roots, m_options);
+    m_status.scanning = true;
+    m_status.directoriesVisited = 0;
+    m_status.projectsFound = 0;
+    m_lastProgress = std::chrono::steady_clock::now();
+    Broadcast(StatusFrame());
+}
+
+void ScanService::StartWatchers(const std::vector<RootScanResult>& results) {
+    const std::vector<ScanRoot>& roots = m_engine.Roots();
+    for (size_t i = 0; i < roots.size() && i < results.size(); ++i) {
+        std::shared_ptr<const ScanIndex> index = m_engine.Index(roots[i].path);
+        if (!results[i].error.empty() || results[i].cancelled || !index) {
+            continue;
+        }
+        auto watcher = std::make_unique<ProjectWatcher>();
+        watcher->SetChangesCallback([this] { Wake(); });
+        watcher->Start(roots[i].path, m_options, index);
+        m_watchers.push_back(std::move(watcher));
+    }
+}
+
+void ScanService::Update() {
+    TRACE_SCOPE("ScanService::Update");
+    m_engine.Drain(m_scanning);
+    ScanEngine::Finished finished;
+    if (m_engine.PollFinished(finished)) {
+        m_status.scanning = false;
+        m_status.error = finished.error;
+        m_status.foldersSkipped = finished.failureCount;
+        if (!finished.cancelled) {
+            m_scanning.Reorder(finished.order);
+            m_projects.Swap(m_scanning);
+            m_search.Clear();
+            m_snapshot.clear();
+            Broadcast(SnapshotFrame());
+            StartWatchers(finished.roots);
+        }
+        m_scanning.Clear();
+        m_status.projectsFound = m_projects.Size();
+        Broadcast(StatusFrame());
+    } else if (m_engine.IsRunning() &&
+            std::chrono::steady_clock::now() - m_lastProgress >= std::chrono::milliseconds(kProgressMs)) {
+        ScanEngine::Progress progress = m_engine.GetProgress();
+        m_status.directoriesVisited = progress.directoriesVisited;
+        m_status.projectsFound = progress.projectsFound;
+        m_lastProgress = std::chrono::steady_clock::now();
+        Broadcast(StatusFrame());
+    }
+
+    bool rescan = false;
+    for (auto& watcher : m_watchers) {
+        ProjectChanges changes;
+        if (watcher->Drain(changes)) {
+            ApplyProjectChanges(m_projects, changes);
+            m_search.Clear();
+            m_snapshot.clear();
+            Broadcast(ChangesFrame(changes));
+        }
+        rescan = watcher->RescanRequested() || rescan;
+    }
+    if (rescan && !m_engine.IsRunning()) {
+        StartScan();
+    }
+}
+
+void ScanService::Accept() {
+    while (true) {
+        int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return; // EAGAIN: none left; anything else: the client gave up already
+        }
+        m_clients.emplace_back();
+        Client& client = m_clients.back();
+        client.fd = fd;
+        FrameWriter hello(ServiceMessage::Hello);
+        hello.Varint(kScanServiceProtocol);
+        Send(client, hello.Finish());
+        Send(client, SnapshotFrame());
+        Send(client, StatusFrame());
+    }
+}
+
+bool ScanService::ReadFrom(Client& client) {
+    char buffer[4096];
+    ssize_t got = read(client.fd, buffer, sizeof(buffer));
+    if (got < 0) {
+        return errno == EAGAIN || errno == EINTR;
+    }
+    if (got == 0) {
+        return false;
+    }
+    client.in.append(buffer, (size_t)got);
+    size_t offset = 0;
+    while (client.in.size() - offset >= sizeof(uint32_t) + 1) {
+        uint32_t length = 0;
+        memcpy(&length, client.in.data() + offset, sizeof(length));
+        if (length == 0 || length > kMaxFrame) {
+            return false;
+        }
+        if (client.in.size() - offset - sizeof(length) < length) {
+            break;
+        }
+        std::string_view frame(client.in.data() + offset + sizeof(length), length);
+        Handle(client, (ServiceMessage)frame[0], frame.substr(1));
+        offset += sizeof(length) + length;
+    }
+    client.in.erase(0, offset);
+    return true;
+}
+
+bool ScanService::WriteTo(Client& client) {
+    while (client.out.size() > client.outOffset) {
+        ssize_t written = send(client.fd, client.out.data() + client.outOffset, client.out.size() - client.outOffset,
+            MSG_NOSIGNAL);
+        if (written < 0) {
+            return errno == EAGAIN || errno == EINTR;
+        }
+        client.outOffset += (size_t)written;
+    }
+    client.out.clear();
+    client.outOffset = 0;
+    return true;
+}
+
+void ScanService::Send(Client& client, const std::string& frame) {
+    if (client.closed) {
+        return;
+    }
+    if (client.out.size() - client.outOffset + frame.size() > kMaxBacklog) {
+        client.closed = true;
+        return;
+    }
+    client.out += frame;
+    if (!WriteTo(client)) {
+        client.closed = true;
+    }
+}
+
+void ScanService::Broadcast(const std::string& frame) {
+    for (Client& client : m_clients) {
+        Send(client, frame);
+    }
+}
+
+void ScanService::Handle(Client& client, ServiceMessage type, std::string_view payload) {
+    PayloadReader reader{ payload };
+    if (type == ServiceMessage::Rescan) {
+        // One already running will do
+        if (!m_engine.IsRunning()) {
+            StartScan();
+        }
+    } else if (type == ServiceMessage::Query) {
+        uint64_t request = 0;
+        uint64_t limit = 0;
+        std::string text;
+        if (!reader.Varint(request) || !reader.Varint(limit) || !reader.String(text)) {
+            client.closed = true;
+            return;
+        }
+        std::vector<ProjectSearch::Match> matches;
+        m_search.Update(m_projects);
+        m_search.Find(m_projects, text, matches);
+        size_t count = std::min<size_t>(matches.size(), limit ? limit : matches.size());
+        FrameWriter results(ServiceMessage::Results);
+        results.Varint(request);
+        results.Varint(count);
+        std::string path;
+        for (size_t i = 0; i < count; ++i) {
+            path.clear();
+            m_projects.AppendPath(matches[i].project, path);
+            results.Byte((uint8_t)m_projects.Type(matches[i].project));
+            results.String(path);
+        }
+        Send(client, results.Finish());
+    } else {
+        client.closed = true; // not something a client sends
+    }
+}
+
+const std::string& ScanService::SnapshotFrame() {
+    if (!m_snapshot.empty()) {
+        return m_snapshot;
+    }
+    TRACE_SCOPE("ScanService::SnapshotFrame");
+    FrameWriter frame(ServiceMessage::Snapshot);
+    const std::vector<ProjectTypeDefinition>& types = m_options.projectTypes->Registry().Types();
+    frame.Varint(types.size());
+    for (const ProjectTypeDefinition& type : types) {
+        frame.Byte((uint8_t)type.type);
+        frame.Byte(type.prune ? 1 : 0);
+        frame.U32(type.color);
+        frame.String(FormatProjectTypeSpec(type));
+    }
+    frame.Varint(m_roots.size());
+    for (const ScanRoot& root : m_roots) {
+        frame.String(root.path);
+    }
+    frame.Varint(m_projects.DirectoryCount());
+    for (uint32_t id = 0; id < m_projects.DirectoryCount(); ++id) {
+        frame.String(m_projects.DirectoryById(id));
+    }
+    frame.Varint(m_projects.Size());
+    for (size_t i = 0; i < m_projects.Size(); ++i) {
+        frame.Byte((uint8_t)m_projects.Type(i));
+        frame.Varint(m_projects.DirectoryId(i));
+        frame.String(m_projects.Name(i));
+    }
+    m_snapshot = frame.Finish();
+    return m_snapshot;
+}
+
+std::string ScanService::StatusFrame() const {
+    FrameWriter frame(ServiceMessage::Status);
+    frame.Byte(m_status.scanning ? 1 : 0);
+    frame.Varint(m_status.directoriesVisited);
+    frame.Varint(m_status.projectsFound);
+    frame.Varint(m_status.foldersSkipped);
+    frame.String(m_status.error);
+    return frame.Finish();
+}
+
+bool ScanServiceClient::Connect(const std::string& socketPath, std::string& error) {
+    Disconnect();
+    sockaddr_un address;
+    if (!ToSocketAddress(socketPath, address, error)) {
+        return false;
+    }
+    m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_fd < 0 || connect(m_fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+        error = "Can't reach the scan service at " + socketPath + ": " + strerror(errno);
+        Disconnect();
+        return false;
+    }
+    // Whoever answers decides the list and the project types shown, so only a
+    // service run by this user or root is trusted
+    uid_t peer = 0;
+    if (!PeerUid(m_fd, peer) || (peer != getuid() && peer != 0)) {
+        error = "The scan service at " + socketPath + " is run by another user";
+        Disconnect();
+        return false;
+    }
+    // Hello, then the list; a service that doesn't send them soon isn't one
+    timeval timeout = { 10, 0 };
+    setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ServiceMessage type;
+    std::string payload;
+    uint64_t version = 0;
+    if (!Receive(type, payload) || type != ServiceMessage::Hello || !PayloadReader{ payload }.Varint(version)) {
+        error = "No answer from a scan service at " + socketPath;
+        Disconnect();
+        return false;
+    }
+    if (version != kScanServiceProtocol) {
+        error = "The scan service at " + socketPath + " speaks protocol " + std::to_string(version) +
+            "; this build speaks " + std::to_string(kScanServiceProtocol);
+        Disconnect();
+        return false;
+    }
+    bool listed = false;
+    while (!listed) {
+        if (!Receive(type, payload) || !Handle(type, payload)) {
+            error = "The scan service at " + socketPath + " closed the connection";
+            Disconnect();
+            return false;
+        }
+        listed = type == ServiceMessage::Snapshot;
+    }
+    timeout = { 0, 0 };
+    setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    m_connected = true;
+    m_reader = std::thread(&ScanServiceClient::Run, this);
+    return true;
+}
+
+void ScanServiceClient::Disconnect() {
+    if (m_fd >= 0) {
+        shutdown(m_fd, SHUT_RDWR);
+    }
+    if (m_reader.joinable()) {
+        m_reader.join();
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_connected = false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hasSnapshot = false;
+    m_snapshot.Clear();
+    m_changes.clear();
+    m_status = ScanServiceStatus();
+    m_roots.clear();
+    m_results.clear();
+}
+
+bool ScanServiceClient::Send(const std::string& frame) {
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    return m_fd >= 0 && WriteFully(m_fd, frame.data(), frame.size());
+}
+
+bool ScanServiceClient::Receive(ServiceMessage& type, std::string& payload) {
+    uint32_t length = 0;
+    if (!ReadFully(m_fd, (char*)&length, sizeof(length)) || length == 0 || length > kMaxFrame) {
+        return false;
+    }
+    uint8_t typeByte = 0;
+    if (!ReadFully(m_fd, (char*)&typeByte, 1)) {
+        return false;
+    }
+    type = (ServiceMessage)typeByte;
+    payload.resize(length - 1);
+    return ReadFully(m_fd, &payload[0], payload.size());
+}
+
+// Decodes one message into the pending state. Returns false if it is malformed.
+bool ScanServiceClient::Handle(ServiceMessage type, const std::string& payload) {
+    PayloadReader reader{ payload };
+    if (type == ServiceMessage::Snapshot) {
+        ProjectTypeRegistry types;
+        uint64_t typeCount = 0;
+        if (!reader.Varint(typeCount)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < typeCount; ++i) {
+            uint8_t value = 0;
+            uint8_t prune = 0;
+            uint32_t color = 0;
+            std::string spec;
+            std::string error;
+            ProjectTypeDefinition definition;
+            if (!reader.Byte(value) || !reader.Byte(prune) || !reader.U32(color) || !reader.String(spec) ||
+                    !ParseProjectTypeSpec(spec, definition, error)) {
+                return false;
+            }
+            definition.type = (ProjectType)value;
+            definition.prune = prune != 0;
+            definition.color = color;
+            types.Add(std::move(definition), error);
+        }
+        std::vector<std::string> roots;
+        uint64_t count = 0;
+        if (!reader.Varint(count)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string root;
+            if (!reader.String(root)) {
+                return false;
+            }
+            roots.push_back(std::move(root));
+        }
+        std::vector<std::string> directories;
+        if (!reader.Varint(count) || count > reader.data.size()) {
+            return false;
+        }
+        directories.resize((size_t)count);
+        for (std::string& directory : directories) {
+            if (!reader.String(directory)) {
+                return false;
+            }
+        }
+        ProjectStore projects;
+        if (!reader.Varint(count) || count > reader.data.size()) {
+            return false;
+        }
+        projects.Reserve((size_t)count);
+        std::string path;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint8_t projectType = 0;
+            uint64_t directory = 0;
+            std::string name;
+            if (!reader.Byte(projectType) || !reader.Varint(directory) || directory >= directories.size() ||
+                    !reader.String(name)) {
+                return false;
+            }
+            path = directories[(size_t)directory];
+            path += name;
+            projects.Add(path, (ProjectType)projectType);
+        }
+        // Named before anyone sees a project of a custom type
+        SetProjectTypes(std::move(types));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_snapshot.Swap(projects);
+        m_hasSnapshot = true;
+        m_changes.clear();
+        m_roots = std::move(roots);
+    } else if (type == ServiceMessage::Changes) {
+        ProjectChanges changes;
+        uint64_t count = 0;
+        if (!reader.Varint(count)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string path;
+            if (!reader.String(path)) {
+                return false;
+            }
+            changes.removed.push_back(std::move(path));
+        }
+        if (!reader.Varint(count)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            uint8_t projectType = 0;
+            std::string path;
+            if (!reader.Byte(projectType) || !reader.String(path)) {
+                return false;
+            }
+            changes.added.push_back(MakeProject(std::move(path), (ProjectType)projectType));
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_changes.push_back(std::move(changes));
+    } else if (type == ServiceMessage::Status) {
+        ScanServiceStatus status;
+        uint8_t scanning = 0;
+        if (!reader.Byte(scanning) || !reader.Varint(status.directoriesVisited) || !reader.Varint(status.projectsFound) ||
+                !reader.Varint(status.foldersSkipped) || !reader.String(status.error)) {
+            return false;
+        }
+        status.scanning = scanning != 0;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_status = std::move(status);
+    } else if (type == ServiceMessage::Results) {
+        uint64_t request = 0;
+        uint64_t count = 0;
+        if (!reader.Varint(request) || !reader.Varint(count) || count > reader.data.size()) {
+            return false;
+        }
+        std::vector<ProjectInfo> results;
+        results.reserve((size_t)count);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint8_t projectType = 0;
+            std::string path;
+            if (!reader.Byte(projectType) || !reader.String(path)) {
+                return false;
+            }
+            results.push_back(MakeProject(std::move(path), (ProjectType)projectType));
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results[request] = std::move(results);
+        m_answered.notify_all();
+    }
+    // Anything else is from a newer service and safe to ignore
+    return true;
+}
+
+void ScanServiceClient::Run() {
+    ServiceMessage type;
+    std::string payload;
+    while (Receive(type, payload) && Handle(type, payload)) {
+        if (m_changesCallback && type != ServiceMessage::Results) {
+            m_changesCallback();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connected = false;
+        m_answered.notify_all();
+    }
+    if (m_changesCallback) {
+        m_changesCallback();
+    }
+}
+
+void ScanServiceClient::RequestRescan() {
+    Send(FrameWriter(ServiceMessage::Rescan).Finish());
+}
+
+bool ScanServiceClient::Query(const std::string& text, size_t limit, std::vector<ProjectInfo>& results,
+    std::string& error, int timeoutMs) {
+    uint64_t request = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        request = m_nextRequest++;
+    }
+    FrameWriter frame(ServiceMessage::Query);
+    frame.Varint(request);
+    frame.Varint(limit);
+    frame.String(text);
+    if (!m_connected || !Send(frame.Finish())) {
+        error = "Not connected to the scan service";
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    bool answered = m_answered.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+        [&] { return m_results.count(request) || !m_connected; });
+    auto it = m_results.find(request);
+    if (!answered || it == m_results.end()) {
+        error = answered ? "Lost the connection to the scan service" : "The scan service didn't answer in time";
+        return false;
+    }
+    results = std::move(it->second);
+    m_results.erase(it);
+    return true;
+}
+
+#else
+
+bool ScanService::Start(const std::string&, const std::vector<ScanRoot>&, const ScanOptions&, const std::string&, bool,
+    std::string& error) {
+    error = "The scan service needs Unix domain sockets, which this build doesn't support";
+    return false;
+}
+
+void ScanService::Stop() {}
+
+bool ScanServiceClient::Connect(const std::string&, std::string& error) {
+    error = "The scan service needs Unix domain sockets, which this build doesn't support";
+    return false;
+}
+
+void ScanServiceClient::Disconnect() {}
+
+void ScanServiceClient::RequestRescan() {}
+
+bool ScanServiceClient::Query(const std::string&, size_t, std::vector<ProjectInfo>&, std::string& error, int) {
+    error = "Not connected to the scan service";
+    return false;
+}
+
+#endif
+
+bool ScanServiceClient::Drain(ProjectStore& projects, bool& replaced) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    replaced = m_hasSnapshot;
+    if (!m_hasSnapshot && m_changes.empty()) {
+        return false;
+    }
+    if (m_hasSnapshot) {
+        projects.Swap(m_snapshot);
+        m_snapshot.Clear();
+        m_hasSnapshot = false;
+    }
+    for (const ProjectChanges& changes : m_changes) {
+        ApplyProjectChanges(projects, changes);
+    }
+    m_changes.clear();
+    return true;
+}
+
+ScanServiceStatus ScanServiceClient::Status() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_status;
+}
+
+void ScanServiceClient::Status(ScanServiceStatus& status) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    status.scanning = m_status.scanning;
+    status.directoriesVisited = m_status.directoriesVisited;
+    status.projectsFound = m_status.projectsFound;
+    status.foldersSkipped = m_status.foldersSkipped;
+    status.error.assign(m_status.error);
+}
+
+std::vector<std::string> ScanServiceClient::Roots() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_roots;
+}
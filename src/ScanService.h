@@ -0,0 +1,203 @@
+#pragma once
+
+#include "ProjectInfo.h"
+#include "ProjectSearch.h"
+#include "ProjectStore.h"
+#include "ProjectWatcher.h"
+#include "ScanEngine.h"
+#include "Scanner.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// A shared scan service: one process owns a workspace's scan, its index and its
+// watchers, and any number of GUI and CLI instances on the machine read the
+// project list from it over a Unix domain socket instead of each walking the
+// same roots and holding their own inotify watches.
+//
+// Wire format. Every message is a frame
+//
+//   u32 length (of what follows), u8 message type, payload
+//
+// in the host's byte order (both ends are on the same machine). Payloads are
+// built from u8, u32, LEB128 varints and strings (varint length, then bytes).
+// Project lists are sent the way ProjectStore keeps them: the parent
+// directories once each, then per project its type byte, directory number and
+// name, so a list costs little more than its names.
+//
+//   service -> client
+//     Hello     varint protocol version                  first, on connect
+//     Snapshot  types, roots, directories, projects      on connect and after every scan
+//     Changes   removed paths, added (type, path)        as watchers see them
+//     Status    u8 scanning, varint visited, varint found, varint skipped, string error
+//     Results   varint request, projects as (type, path)  answer to Query
+//   client -> service
+//     Rescan    (empty)
+//     Query     varint request, varint limit, string text
+
+enum class ServiceMessage : uint8_t {
+    Hello = 1,
+    Snapshot = 2,
+    Changes = 3,
+    Status = 4,
+    Results = 5,
+    Rescan = 16,
+    Query = 17,
+};
+
+constexpr uint32_t kScanServiceProtocol = 1;
+
+// $PROJECTNAVIGATOR_SOCKET if set, otherwise projectnavigator.sock in
+// $XDG_RUNTIME_DIR, or in /tmp where that isn't set.
+std::string DefaultScanServicePath();
+
+// What the service is doing, as last reported.
+struct ScanServiceStatus {
+    bool scanning = false;
+    uint64_t directoriesVisited = 0;
+    uint64_t projectsFound = 0;
+    uint64_t foldersSkipped = 0; // unreadable folders in the last scan
+    std::string error;           // of the last scan; empty if it succeeded
+};
+
+// The service end. Scans the workspace at Start, keeps it current with a
+// ProjectWatcher per root and answers clients from one thread, which polls the
+// listening socket, every client and a wake-up pipe the scan and watcher
+// threads write to. Clients are never waited on: what they haven't read yet is
+// buffered, and one that falls too far behind is dropped.
+//
+// A client gets the last complete list as soon as it connects, so while a
+// rescan runs they keep seeing the previous one (loaded from the index at
+// startup, if there is one) and then get the new list in one piece.
+class ScanService {
+public:
+    ScanService() = default;
+    ~ScanService();
+
+    ScanService(const ScanService&) = delete;
+    ScanService& operator=(const ScanService&) = delete;
+
+    // Listens on socketPath and starts scanning roots. Indexes are loaded from and
+    // saved next to indexBase if it isn't empty. A leftover socket file is
+    // replaced, but not one another service is still answering on. Unless
+    // shared, only this user can connect.
+    bool Start(const std::string& socketPath, const std::vector<ScanRoot>& roots, const ScanOptions& options,
+        const std::string& indexBase, bool shared, std::string& error);
+    // Disconnects every client, stops scanning and watching, and removes the socket.
+    void Stop();
+
+    size_t ClientCount() const { return m_clientCount.load(); }
+
+private:
+    struct Client {
+        int fd = -1;
+        std::string in;  // partial frames
+        std::string out; // not yet written
+        size_t outOffset = 0;
+        bool closed = false; // dropped; removed after this poll round
+    };
+
+    void Run();
+    void Wake();
+    void StartScan();
+    void Update();
+    void Accept();
+    bool ReadFrom(Client& client);
+    bool WriteTo(Client& client);
+    void Handle(Client& client, ServiceMessage type, std::string_view payload);
+    void StartWatchers(const std::vector<RootScanResult>& results);
+    void Send(Client& client, const std::string& frame);
+    void Broadcast(const std::string& frame);
+    const std::string& SnapshotFrame();
+    std::string StatusFrame() const;
+
+    std::string m_socketPath;
+    std::vector<ScanRoot> m_roots;
+    ScanOptions m_options;
+    int m_listenFd = -1;
+    int m_wakeFds[2] = { -1, -1 };
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+    std::atomic<size_t> m_clientCount{0};
+
+    // Service thread only
+    ScanEngine m_engine;
+    std::vector<std::unique_ptr<ProjectWatcher>> m_watchers;
+    ProjectStore m_projects; // the last complete list
+    ProjectStore m_scanning; // what the scan in flight has found so far
+    ProjectSearch m_search;
+    ScanServiceStatus m_status;
+    std::chrono::steady_clock::time_point m_lastProgress;
+    std::string m_snapshot; // encoded m_projects; empty once it changes
+    std::vector<Client> m_clients;
+};
+
+// The client end. Connect() returns once the service's current list has
+// arrived, so a client never shows a half-filled list; after that a reader
+// thread collects snapshots and changes until Drain() applies them.
+class ScanServiceClient {
+public:
+    ScanServiceClient() = default;
+    ~ScanServiceClient();
+
+    ScanServiceClient(const ScanServiceClient&) = delete;
+    ScanServiceClient& operator=(const ScanServiceClient&) = delete;
+
+    // Called from the reader thread when there is something to Drain(), or the
+    // connection dropped. Set it before Connect().
+    void SetChangesCallback(std::function<void()> callback) { m_changesCallback = std::move(callback); }
+
+    // Also takes the service's project types (SetProjectTypes), so custom
+    // types are named as the service names them.
+    bool Connect(const std::string& socketPath, std::string& error);
+    void Disconnect();
+    // False once the service has gone away.
+    bool IsConnected() const { return m_connected.load(); }
+
+    // Brings projects up to date with what was received since the last call: a
+    // new snapshot replaces it (replaced is set), changes are applied to it.
+    // Returns true if projects changed.
+    bool Drain(ProjectStore& projects, bool& replaced);
+    ScanServiceStatus Status() const;
+    // Same, into status, reusing its storage so polling it every frame doesn't allocate.
+    void Status(ScanServiceStatus& status) const;
+    std::vector<std::string> Roots() const;
+
+    void RequestRescan();
+    // Asks the service to search its list (see ProjectSearch), best match first.
+    // Waits up to timeoutMs for the answer.
+    bool Query(const std::string& text, size_t limit, std::vector<ProjectInfo>& results, std::string& error,
+        int timeoutMs = 5000);
+
+private:
+    bool Send(const std::string& frame);
+    bool Receive(ServiceMessage& type, std::string& payload);
+    bool Handle(ServiceMessage type, const std::string& payload);
+    void Run();
+
+    int m_fd = -1;
+    std::thread m_reader;
+    std::atomic<bool> m_connected{false};
+    std::function<void()> m_changesCallback;
+    std::mutex m_sendMutex;
+
+    mutable std::mutex m_mutex; // guards everything below
+    std::condition_variable m_answered;
+    bool m_hasSnapshot = false;
+    ProjectStore m_snapshot;
+    std::vector<ProjectChanges> m_changes; // received after m_snapshot, if any
+    ScanServiceStatus m_status;
+    std::vector<std::string> m_roots;
+    uint64_t m_nextRequest = 1;
+    std::map<uint64_t, std::vector<ProjectInfo>> m_results; // by request
+};
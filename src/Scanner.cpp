@@ -0,0 +1,1052 @@
+#include "Scanner.h"
+#include "DirectoryLister.h"
+#include "IoUring.h"
+#include "ProjectTypes.h"
+#include "ScanIndex.h"
+#include "Trace.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _WIN32
+#include <string.h>
+#else
+#include <cerrno>
+#endif
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct PendingDirectory {
+    fs::path path;
+    ScanOrderKey key;
+    bool descend = true; // false: classify only (symlinked, or at the depth limit)
+    bool symlink = false;
+    uint32_t cached = ScanIndex::kNone; // this directory's record in options.previous, if any
+};
+
+void RecordDirectory(const PendingDirectory& dir, const ScanOptions& options, int64_t mtime, ProjectType type,
+    bool descended, bool probed = false) {
+    if (!options.record) {
+        return;
+    }
+    uint8_t flags = 0;
+    if (descended) {
+        flags |= ScanIndex::kFlagDescended;
+    }
+    if (probed) {
+        flags |= ScanIndex::kFlagProbed;
+    }
+    if (dir.symlink) {
+        flags |= ScanIndex::kFlagSymlink;
+    }
+    std::string name = dir.key.empty() ? dir.path.string() : dir.path.filename().string();
+    options.record->Add(dir.key, name, mtime, type, flags);
+}
+
+// Finds a subdirectory's record among its parent's children in the previous index.
+class CachedChildren {
+public:
+    CachedChildren(const ScanIndex* index, uint32_t parent) : m_index(index) {
+        if (!index || parent == ScanIndex::kNone) {
+            return;
+        }
+        const ScanIndex::Record& record = index->Get(parent);
+        m_first = record.firstChild;
+        m_count = record.childCount;
+        // Big directories get a hash lookup so matching stays linear
+        if (m_count > 16) {
+            for (uint32_t i = 0; i < m_count; ++i) {
+                m_byName.emplace(index->Name(index->Get(m_first + i)), m_first + i);
+            }
+        }
+    }
+
+    uint32_t Find(std::string_view name) const {
+        if (!m_byName.empty()) {
+            auto it = m_byName.find(name);
+            return it != m_byName.end() ? it->second : ScanIndex::kNone;
+        }
+        for (uint32_t i = 0; i < m_count; ++i) {
+            if (m_index->Name(m_index->Get(m_first + i)) == name) {
+                return m_first + i;
+            }
+        }
+        return ScanIndex::kNone;
+    }
+
+private:
+    const ScanIndex* m_index;
+    uint32_t m_first = 0;
+    uint32_t m_count = 0;
+    std::unordered_map<std::string_view, uint32_t> m_byName;
+};
+
+bool ShouldClassify(const PendingDirectory& dir, const ScanOptions& options) {
+    return !dir.key.empty() || options.classifyRoot;
+}
+
+// Whether the children of dir may be descended into, or only listed for classification.
+bool ChildrenDescend(const PendingDirectory& dir, const ScanOptions& options) {
+    return options.maxDepth <= 0 || options.rootDepth + (int)dir.key.size() + 1 < options.maxDepth;
+}
+
+void NotifyDirectory(const PendingDirectory& dir, const ScanOptions& options) {
+    if (options.directoryVisited) {
+        options.directoryVisited(dir.path.string());
+    }
+}
+
+// Errors that say the filesystem was unreachable for a moment rather than that
+// the directory is unreadable: the kind a network share throws up under load.
+bool IsTransientError(const std::error_code& ec) {
+    std::error_condition condition = ec.default_error_condition();
+    if (condition == std::errc::resource_unavailable_try_again || condition == std::errc::interrupted ||
+        condition == std::errc::timed_out || condition == std::errc::connection_reset ||
+        condition == std::errc::connection_aborted || condition == std::errc::network_down ||
+        condition == std::errc::network_unreachable || condition == std::errc::host_unreachable ||
+        condition == std::errc::device_or_resource_busy || condition == std::errc::io_error) {
+        return true;
+    }
+#ifdef _WIN32
+    // ERROR_BAD_NETPATH, ERROR_UNEXP_NET_ERR, ERROR_NETNAME_DELETED, ERROR_SEM_TIMEOUT
+    if (ec.category() == std::system_category()) {
+        int code = ec.value();
+        return code == 53 || code == 59 || code == 64 || code == 121;
+    }
+#else
+    if (ec.category() == std::generic_category() && ec.value() == ESTALE) {
+        return true;
+    }
+#endif
+    return false;
+}
+
+// Lists dir, retrying transient errors with exponential backoff. Returns the
+// number of attempts made; ec is set if the last one failed too.
+int ListWithRetry(const PendingDirectory& dir, const ScanOptions& options, ScanCounters& counters,
+    const std::atomic<bool>& cancel, std::vector<DirEntry>& entries, int64_t& mtime, FileIdentity& identity,
+    std::error_code& ec) {
+    int attempts = 0;
+    int delayMs = options.retryDelayMs;
+    while (true) {
+        ++attempts;
+        if (ListDirectory(dir.path, entries, mtime, counters, ec, &identity)) {
+            return attempts;
+        }
+        if (attempts > options.transientRetries || !IsTransientError(ec)) {
+            return attempts;
+        }
+        // Slept in slices so a cancel doesn't wait out the whole backoff
+        for (int waited = 0; waited < delayMs && !cancel.load(std::memory_order_relaxed); waited += 10) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min(10, delayMs - waited)));
+        }
+        if (cancel.load(std::memory_order_relaxed)) {
+            return attempts;
+        }
+        delayMs *= 2;
+    }
+}
+
+// Whether dir is this walk's to handle: false if it was already walked or
+// reported through another root or another route (a bind mount or loop).
+// Directories that are only classified and turn out not to be projects are
+// left unclaimed, so a symlink to a folder can't keep its real path from being walked.
+bool ClaimDirectory(const PendingDirectory& dir, const ScanOptions& options, const FileIdentity& identity,
+    ProjectType type) {
+    if (!options.visited || !identity.Valid()) {
+        return true;
+    }
+    if (!dir.descend && (type == ProjectType::None || !ShouldClassify(dir, options))) {
+        return true;
+    }
+    return options.visited->Insert(identity);
+}
+
+// Reports a project for dir, if type says it is one. Returns true if the walk should stop here.
+bool ReportProject(const PendingDirectory& dir, ProjectType type, const ScanOptions& options,
+    ScanCounters& counters, const ProjectSink& sink) {
+    if (!ShouldClassify(dir, options) || type == ProjectType::None) {
+        return false;
+    }
+    counters.projectsFound.fetch_add(1, std::memory_order_relaxed);
+    sink({ dir.path.filename().string(), dir.path.string(), type }, dir.key);
+    return StopsAtProject(type, options);
+}
+
+bool HasCachedRecord(const PendingDirectory& dir, const ScanOptions& options) {
+    return options.previous && dir.cached != ScanIndex::kNone;
+}
+
+// Incremental rescan: if dir's current mtime matches the previous index, its
+// entries can't have changed, so its classification and subdirectories are
+// taken from the index instead of listing it again. Directories classified by
+// a content probe are always listed again: a file edited in place leaves the
+// mtime alone. Returns false if it has to be listed.
+bool ReuseCachedDirectory(const PendingDirectory& dir, const ScanOptions& options, ScanCounters& counters,
+    const ProjectSink& sink, int64_t mtime, const FileIdentity& identity, std::vector<PendingDirectory>& subdirectories) {
+    const ScanIndex* previous = options.previous.get();
+    const ScanIndex::Record& record = previous->Get(dir.cached);
+    bool descended = (record.flags & ScanIndex::kFlagDescended) != 0;
+    if (mtime != record.mtime || (descended && !dir.descend) || (record.flags & ScanIndex::kFlagProbed)) {
+        return false;
+    }
+    ProjectType type = ScanIndex::Type(record);
+    if (!ClaimDirectory(dir, options, identity, type)) {
+        return true;
+    }
+    counters.directoriesReused.fetch_add(1, std::memory_order_relaxed);
+    NotifyDirectory(dir, options);
+
+    RecordDirectory(dir, options, mtime, type, descended);
+    if (ReportProject(dir, type, options, counters, sink) || !descended) {
+        return true;
+    }
+
+    bool childrenDescend = ChildrenDescend(dir, options);
+    for (uint32_t i = 0; i < record.childCount; ++i) {
+        const ScanIndex::Record& child = previous->Get(record.firstChild + i);
+        counters.directoriesVisited.fetch_add(1, std::memory_order_relaxed);
+
+        PendingDirectory subdirectory;
+        subdirectory.path = dir.path / std::string(previous->Name(child));
+        subdirectory.key = dir.key;
+        subdirectory.key.push_back(i);
+        subdirectory.symlink = (child.flags & ScanIndex::kFlagSymlink) != 0;
+        subdirectory.descend = childrenDescend && !subdirectory.symlink;
+        subdirectory.cached = record.firstChild + i;
+        subdirectories.push_back(std::move(subdirectory));
+    }
+    return true;
+}
+
+bool VisitCachedDirectory(const PendingDirectory& dir, const ScanOptions& options, ScanCounters& counters,
+    const ProjectSink& sink, std::vector<PendingDirectory>& subdirectories) {
+    if (!HasCachedRecord(dir, options)) {
+        return false;
+    }
+    int64_t mtime = 0;
+    FileIdentity identity;
+    return GetDirectoryMTime(dir.path, mtime, counters, &identity) &&
+        ReuseCachedDirectory(dir, options, counters, sink, mtime, identity, subdirectories);
+}
+
+// Classifies a directory from its one listing and reports the subdirectories
+// still to walk, or records the failure if it couldn't be listed (ec set after
+// attempts tries). The root itself is only reported as a project with
+// options.classifyRoot. Projects are leaves: nothing below one is walked when
+// StopsAtProject says so.
+void HandleListing(const PendingDirectory& dir, const std::vector<DirEntry>& entries, int64_t mtime,
+    const FileIdentity& identity, const std::error_code& ec, int attempts, const ScanOptions& options,
+    ScanCounters& counters, const std::atomic<bool>& cancel, const ProjectSink& sink,
+    std::vector<PendingDirectory>& subdirectories) {
+    if (ec) {
+        if (dir.key.empty()) {
+            throw fs::filesystem_error("directory_iterator::directory_iterator", dir.path, ec);
+        }
+        // Skip it and carry on. Recorded with an mtime that never matches, so
+        // the next incremental scan tries it again instead of reusing nothing.
+        counters.directoriesFailed.fetch_add(1, std::memory_order_relaxed);
+        if (options.errors) {
+            options.errors->Add({ dir.path.string(), ec.message(), attempts });
+        }
+        RecordDirectory(dir, options, 0, ProjectType::None, false);
+        return;
+    }
+
+    bool probed = false;
+    ProjectType type = ShouldClassify(dir, options) ? options.projectTypes->Classify(dir.path, entries, &probed) :
+        ProjectType::None;
+    if (!ClaimDirectory(dir, options, identity, type)) {
+        return;
+    }
+    bool descend = dir.descend && !StopsAtProject(type, options);
+    RecordDirectory(dir, options, mtime, type, descend, probed);
+    if (ReportProject(dir, type, options, counters, sink) || !dir.descend) {
+        return;
+    }
+    // Children at the depth limit are still listed so they can be classified, but not descended into
+    bool childrenDescend = ChildrenDescend(dir, options);
+    CachedChildren cachedChildren(options.previous.get(), dir.cached);
+
+    uint32_t index = 0;
+    for (const auto& entry : entries) {
+        if (cancel.load(std::memory_order_relaxed)) {
+            return;
+        }
+        if (!entry.isDirectory) {
+            continue;
+        }
+        if (IsSkippedDirectory(entry.name, options)) {
+            counters.directoriesSkipped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        counters.directoriesVisited.fetch_add(1, std::memory_order_relaxed);
+
+        PendingDirectory subdirectory;
+        subdirectory.path = dir.path / entry.name;
+        subdirectory.key = dir.key;
+        subdirectory.key.push_back(index++);
+        // Like recursive_directory_iterator, don't follow directory symlinks
+        subdirectory.symlink = entry.isSymlink;
+        subdirectory.descend = childrenDescend && !entry.isSymlink;
+        subdirectory.cached = cachedChildren.Find(entry.name);
+        subdirectories.push_back(std::move(subdirectory));
+    }
+}
+
+// Lists one directory exactly once (unless the previous index vouches for it)
+// and hands the listing to HandleListing.
+void VisitDirectory(const PendingDirectory& dir, const ScanOptions& options, ScanCounters& counters,
+    const std::atomic<bool>& cancel, const ProjectSink& sink, std::vector<PendingDirectory>& subdirectories) {
+    if (VisitCachedDirectory(dir, options, counters, sink, subdirectories)) {
+        return;
+    }
+
+    thread_local std::vector<DirEntry> entries;
+    int64_t mtime = 0;
+    FileIdentity identity;
+    NotifyDirectory(dir, options);
+    std::error_code ec;
+    int attempts = ListWithRetry(dir, options, counters, cancel, entries, mtime, identity, ec);
+    HandleListing(dir, entries, mtime, identity, ec, attempts, options, counters, cancel, sink, subdirectories);
+}
+
+PendingDirectory RootDirectory(const std::string& root, const ScanOptions& options) {
+    PendingDirectory dir;
+    dir.path = fs::path(root);
+    dir.descend = options.maxDepth <= 0 || options.rootDepth < options.maxDepth;
+    dir.cached = options.previous ? options.previous->RootRecord() : ScanIndex::kNone;
+    return dir;
+}
+
+bool WalkSerial(const std::string& root, const ScanOptions& options, ScanCounters& counters, const std::atomic<bool>& cancel, const ProjectSink& sink) {
+    std::vector<PendingDirectory> stack;
+    std::vector<PendingDirectory> subdirectories;
+    stack.push_back(RootDirectory(root, options));
+    while (!stack.empty()) {
+        if (cancel.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        PendingDirectory dir = std::move(stack.back());
+        stack.pop_back();
+
+        subdirectories.clear();
+        VisitDirectory(dir, options, counters, cancel, sink, subdirectories);
+        // Push in reverse so the first subdirectory is walked next
+        for (auto it = subdirectories.rbegin(); it != subdirectories.rend(); ++it) {
+            stack.push_back(std::move(*it));
+        }
+    }
+    return !cancel.load();
+}
+
+bool WalkParallel(const std::string& root, const ScanOptions& options, ScanCounters& counters,
+    const std::atomic<bool>& cancel, const ProjectSink& sink) {
+    WorkStealingPool pool(options.threadCount);
+
+    // The first failure stops the walk and is rethrown on the calling thread
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    std::atomic<bool> stop{false};
+
+    std::function<void(PendingDirectory)> visit = [&](PendingDirectory dir) {
+        if (stop.load(std::memory_order_relaxed) || cancel.load(std::memory_order_relaxed)) {
+            return;
+        }
+        std::vector<PendingDirectory> subdirectories;
+        try {
+            VisitDirectory(dir, options, counters, cancel, sink, subdirectories);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            stop = true;
+            return;
+        }
+        for (auto& subdirectory : subdirectories) {
+            pool.Submit([&visit, subdirectory = std::move(subdirectory)]() mutable {
+                visit(std::move(subdirectory));
+            });
+        }
+    };
+
+    pool.Submit([&visit, &root, &options] { visit(RootDirectory(root, options)); });
+    pool.Wait();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return !cancel.load();
+}
+
+#ifdef __linux__
+
+int64_t StatxNanoseconds(const struct statx_timestamp& time) {
+    return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// The io_uring walker. Each thread keeps up to options.queueDepth directories
+// in flight on a ring of its own: their opens, stats and closes go to the
+// kernel in batches, and the only blocking call left per directory is
+// getdents, which io_uring has no operation for. Directories waiting to be
+// visited sit on one stack shared by every thread. Listings go through the
+// same HandleListing as the other walkers, so the results are the same.
+class UringWalk {
+public:
+    UringWalk(const ScanOptions& options, ScanCounters& counters, const std::atomic<bool>& cancel,
+        const ProjectSink& sink)
+        : m_options(options), m_counters(counters), m_cancel(cancel), m_sink(sink) {}
+
+    bool Run(const std::string& root, unsigned threadCount) {
+        Push({ RootDirectory(root, m_options) });
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < threadCount; ++i) {
+            threads.emplace_back([this] { Worker(); });
+        }
+        Worker();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+        return !m_cancel.load();
+    }
+
+private:
+    static constexpr uint32_t kOpenTag = 0xFFFFFFFF;
+    static constexpr uint32_t kStatTag = 0xFFFFFFFE;
+    static constexpr uint32_t kCloseTag = 0xFFFFFFFD;
+
+    // A stat of one entry whose type the listing didn't give
+    struct EntryStat {
+        uint32_t entry;
+        bool follow; // false: lstat first, to find out whether it is a symlink
+        struct statx result;
+    };
+
+    // One directory in flight
+    struct Probe {
+        PendingDirectory dir;
+        std::string path; // dir.path, kept alive for the kernel
+        int fd = -1;
+        int openResult = 0;
+        int statResult = -1;
+        struct statx stat;
+        bool checking = false; // only the stat for the index check is in flight
+        int pending = 0;       // requests in flight
+        std::vector<DirEntry> entries;
+        std::vector<EntryStat> entryStats; // not resized while any are in flight
+        std::error_code ec;
+    };
+
+    struct Request {
+        uint32_t slot;
+        uint32_t tag; // an index into entryStats, or one of the tags above
+        int fd;       // for kCloseTag
+    };
+
+    // Per-thread state
+    struct Ring {
+        IoUring ring;
+        std::vector<std::unique_ptr<Probe>> probes;
+        std::vector<uint32_t> freeSlots;
+        std::deque<Request> backlog; // couldn't be queued while the ring was full
+        size_t active = 0;
+        uint64_t countedEnters = 0; // ring.Enters() already added to the counters
+    };
+
+    void CountEnters(Ring& ring) {
+        uint64_t enters = ring.ring.Enters() - ring.countedEnters;
+        ring.countedEnters += enters;
+        m_counters.syscalls.fetch_add(enters, std::memory_order_relaxed);
+        TRACE_COUNT(Syscalls, enters);
+    }
+
+    bool Stopping() const {
+        return m_stop.load(std::memory_order_relaxed) || m_cancel.load(std::memory_order_relaxed);
+    }
+
+    void Fail(std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_error) {
+            m_error = error;
+        }
+        m_stop = true;
+        m_wake.notify_all();
+    }
+
+    // Queues directories to visit. Pushed in reverse so the first is visited next.
+    void Push(std::vector<PendingDirectory>&& directories) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+            m_stack.push_back(std::move(*it));
+        }
+        m_outstanding += directories.size();
+        if (!directories.empty()) {
+            m_wake.notify_all();
+        }
+    }
+
+    // A directory taken with Take() has been dealt with, after its subdirectories were pushed.
+    void Done() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_outstanding == 0) {
+            m_wake.notify_all();
+        }
+    }
+
+    // Takes the next directory to visit. With wait, blocks until there is one;
+    // returns false once the walk is over or stopping.
+    bool Take(PendingDirectory& dir, bool wait) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_stack.empty()) {
+            if (!wait || m_outstanding == 0 || Stopping()) {
+                return false;
+            }
+            // Woken on a timer too, so a cancel is noticed
+            m_wake.wait_for(lock, std::chrono::milliseconds(50));
+        }
+        if (Stopping()) {
+            return false;
+        }
+        dir = std::move(m_stack.back());
+        m_stack.pop_back();
+        return true;
+    }
+
+    void Worker() {
+        Ring ring;
+        std::error_code ec;
+        // A ring per thread; without one (locked memory limits on older kernels) this thread lists the blocking way
+        if (!ring.ring.Open(std::max(256u, m_options.queueDepth * 4), ec)) {
+            BlockingWorker();
+            return;
+        }
+        while (true) {
+            Flush(ring);
+            // Start as many directories as there's room for; only wait for one when there's nothing in flight
+            PendingDirectory dir;
+            bool over = false;
+            while (ring.backlog.empty() && ring.active < m_options.queueDepth) {
+                bool wait = ring.active == 0;
+                if (wait && !ring.ring.Submit(0, ec)) {
+                    break;
+                }
+                if (!Take(dir, wait)) {
+                    over = wait;
+                    break;
+                }
+                Start(ring, std::move(dir));
+            }
+            if (ec || (over && ring.active == 0 && ring.backlog.empty())) {
+                break;
+            }
+            bool submitted = ring.ring.Submit(1, ec);
+            CountEnters(ring);
+            if (!submitted) {
+                break;
+            }
+            uint64_t userData = 0;
+            int result = 0;
+            while (ring.ring.PopCompletion(userData, result)) {
+                Complete(ring, (uint32_t)(userData >> 32), (uint32_t)userData, result);
+            }
+        }
+        if (ec) {
+            Fail(std::make_exception_ptr(fs::filesystem_error("io_uring_enter", ec)));
+        }
+        // Closes may still be in flight; the ring has to outlive them
+        while (ring.ring.InFlight() && ring.ring.Submit(1, ec)) {
+            uint64_t userData = 0;
+            int result = 0;
+            while (ring.ring.PopCompletion(userData, result)) {
+            }
+        }
+        CountEnters(ring);
+    }
+
+    void BlockingWorker() {
+        PendingDirectory dir;
+        std::vector<PendingDirectory> subdirectories;
+        while (Take(dir, true)) {
+            subdirectories.clear();
+            try {
+                VisitDirectory(dir, m_options, m_counters, m_cancel, m_sink, subdirectories);
+            } catch (...) {
+                Fail(std::current_exception());
+            }
+            Push(std::move(subdirectories));
+            Done();
+        }
+    }
+
+    void Queue(Ring& ring, uint32_t slot, uint32_t tag, int fd = -1) {
+        ring.backlog.push_back({ slot, tag, fd });
+        Flush(ring);
+    }
+
+    // Moves requests from the backlog into the ring while it has room
+    void Flush(Ring& ring) {
+        while (!ring.backlog.empty()) {
+            const Request& request = ring.backlog.front();
+            uint64_t userData = (uint64_t)request.slot << 32 | request.tag;
+            bool queued;
+            if (request.tag == kCloseTag) {
+                queued = ring.ring.PrepareClose(request.fd, userData);
+            } else {
+                Probe& probe = *ring.probes[request.slot];
+                if (request.tag == kOpenTag) {
+                    queued = ring.ring.PrepareOpenDirectory(probe.path.c_str(), userData);
+                } else if (request.tag == kStatTag) {
+                    queued = ring.ring.PrepareStatx(AT_FDCWD, probe.path.c_str(), 0,
+                        STATX_TYPE | STATX_MTIME | STATX_INO, &probe.stat, userData);
+                } else {
+                    EntryStat& stat = probe.entryStats[request.tag];
+                    queued = ring.ring.PrepareStatx(probe.fd, probe.entries[stat.entry].name.c_str(),
+                        stat.follow ? 0 : AT_SYMLINK_NOFOLLOW, STATX_TYPE, &stat.result, userData);
+                }
+            }
+            if (!queued) {
+                return;
+            }
+            ring.backlog.pop_front();
+        }
+    }
+
+    void Start(Ring& ring, PendingDirectory&& dir) {
+        uint32_t slot;
+        if (!ring.freeSlots.empty()) {
+            slot = ring.freeSlots.back();
+            ring.freeSlots.pop_back();
+        } else {
+            slot = (uint32_t)ring.probes.size();
+            ring.probes.push_back(std::make_unique<Probe>());
+        }
+        ++ring.active;
+        Probe& probe = *ring.probes[slot];
+        probe.dir = std::move(dir);
+        probe.path = probe.dir.path.string();
+        probe.fd = -1;
+        probe.openResult = 0;
+        probe.statResult = -1;
+        probe.pending = 0;
+        probe.entries.clear();
+        probe.entryStats.clear();
+        probe.ec.clear();
+        // On a rescan a stat decides whether the directory has to be listed at all
+        probe.checking = HasCachedRecord(probe.dir, m_options);
+        if (probe.checking) {
+            ++probe.pending;
+            Queue(ring, slot, kStatTag);
+        } else {
+            StartListing(ring, slot);
+        }
+    }
+
+    // The open and the stat of the directory go out together
+    void StartListing(Ring& ring, uint32_t slot) {
+        Probe& probe = *ring.probes[slot];
+        NotifyDirectory(probe.dir, m_options);
+        ++probe.pending;
+        Queue(ring, slot, kOpenTag);
+        if (probe.statResult != 0) {
+            ++probe.pending;
+            Queue(ring, slot, kStatTag);
+        }
+    }
+
+    void Complete(Ring& ring, uint32_t slot, uint32_t tag, int result) {
+        if (tag == kCloseTag) {
+            return;
+        }
+        Probe& probe = *ring.probes[slot];
+        --probe.pending;
+        try {
+            if (tag == kStatTag) {
+                probe.statResult = result;
+                m_counters.statCalls.fetch_add(1, std::memory_order_relaxed);
+                if (probe.checking) {
+                    probe.checking = false;
+                    std::vector<PendingDirectory> subdirectories;
+                    if (result == 0 && ReuseCachedDirectory(probe.dir, m_options, m_counters, m_sink,
+                            StatxNanoseconds(probe.stat.stx_mtime), Identity(probe), subdirectories)) {
+                        Finish(ring, slot, std::move(subdirectories));
+                    } else {
+                        StartListing(ring, slot);
+                    }
+                    return;
+                }
+            } else if (tag == kOpenTag) {
+                probe.openResult = result;
+                probe.fd = result >= 0 ? result : -1;
+            } else {
+                EntryStat& stat = probe.entryStats[tag];
+                DirEntry& entry = probe.entries[stat.entry];
+                m_counters.statCalls.fetch_add(1, std::memory_order_relaxed);
+                bool found = result == 0;
+                if (!stat.follow && found && S_ISLNK(stat.result.stx_mode)) {
+                    entry.isSymlink = true;
+                    stat.follow = true;
+                    ++probe.pending;
+                    Queue(ring, slot, tag);
+                    return;
+                }
+                entry.isDirectory = found && S_ISDIR(stat.result.stx_mode);
+            }
+            if (probe.pending > 0) {
+                return;
+            }
+            if (tag == kOpenTag || tag == kStatTag) {
+                ReadEntries(ring, slot);
+            } else {
+                FinishListing(ring, slot);
+            }
+        } catch (...) {
+            Fail(std::current_exception());
+            if (probe.pending == 0) {
+                Finish(ring, slot, {});
+            }
+        }
+    }
+
+    FileIdentity Identity(const Probe& probe) const {
+        FileIdentity identity;
+        if (probe.statResult == 0) {
+            identity.device = makedev(probe.stat.stx_dev_major, probe.stat.stx_dev_minor);
+            identity.inode = probe.stat.stx_ino;
+        }
+        return identity;
+    }
+
+    // Once the directory is open and stat'ed: reads its entries and sends a
+    // stat for each one whose type getdents didn't give.
+    void ReadEntries(Ring& ring, uint32_t slot) {
+        TRACE_SCOPE("UringReadEntries");
+        Probe& probe = *ring.probes[slot];
+        if (probe.openResult < 0) {
+            std::error_code ec(-probe.openResult, std::generic_category());
+            if (IsTransientError(ec) && m_options.transientRetries > 0) {
+                // Rare enough to retry the blocking way, with its backoff
+                std::vector<DirEntry> entries;
+                int64_t mtime = 0;
+                FileIdentity identity;
+                int attempts = 1 + ListWithRetry(probe.dir, m_options, m_counters, m_cancel, entries, mtime, identity, ec);
+                std::vector<PendingDirectory> subdirectories;
+                HandleListing(probe.dir, entries, mtime, identity, ec, attempts, m_options, m_counters, m_cancel,
+                    m_sink, subdirectories);
+                Finish(ring, slot, std::move(subdirectories));
+                return;
+            }
+            probe.ec = ec;
+            FinishListing(ring, slot);
+            return;
+        }
+        m_counters.directoriesListed.fetch_add(1, std::memory_order_relaxed);
+
+        thread_local std::vector<char> buffer(64 * 1024);
+        uint64_t seen = 0;
+        uint64_t calls = 0;
+        while (true) {
+            ++calls;
+            long read = syscall(SYS_getdents64, probe.fd, buffer.data(), buffer.size());
+            if (read < 0) {
+                probe.ec = std::error_code(errno, std::generic_category());
+                break;
+            }
+            if (read == 0) {
+                break;
+            }
+            for (long offset = 0; offset < read;) {
+                const dirent64* ent = (const dirent64*)(buffer.data() + offset);
+                offset += ent->d_reclen;
+                const char* name = ent->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                    continue;
+                }
+                ++seen;
+                DirEntry entry;
+                entry.name = name;
+                if (ent->d_type == DT_DIR) {
+                    entry.isDirectory = true;
+                } else if (ent->d_type == DT_LNK || ent->d_type == DT_UNKNOWN) {
+                    entry.isSymlink = ent->d_type == DT_LNK;
+                    probe.entryStats.push_back({ (uint32_t)probe.entries.size(), ent->d_type == DT_LNK, {} });
+                }
+                probe.entries.push_back(std::move(entry));
+            }
+        }
+        m_counters.entriesSeen.fetch_add(seen, std::memory_order_relaxed);
+        m_counters.syscalls.fetch_add(calls, std::memory_order_relaxed);
+        TRACE_COUNT(DirectoriesListed, 1);
+        TRACE_COUNT(EntriesSeen, seen);
+        TRACE_COUNT(Syscalls, calls);
+
+        if (!probe.ec) {
+            for (uint32_t i = 0; i < probe.entryStats.size(); ++i) {
+                ++probe.pending;
+                Queue(ring, slot, i);
+            }
+        }
+        if (probe.pending == 0) {
+            FinishListing(ring, slot);
+        }
+    }
+
+    void FinishListing(Ring& ring, uint32_t slot) {
+        Probe& probe = *ring.probes[slot];
+        if (probe.fd >= 0) {
+            Queue(ring, slot, kCloseTag, probe.fd);
+            probe.fd = -1;
+        }
+        int64_t mtime = probe.statResult == 0 ? StatxNanoseconds(probe.stat.stx_mtime) : 0;
+        std::vector<PendingDirectory> subdirectories;
+        try {
+            HandleListing(probe.dir, probe.entries, mtime, Identity(probe), probe.ec, 1, m_options, m_counters,
+                m_cancel, m_sink, subdirectories);
+        } catch (...) {
+            Fail(std::current_exception());
+        }
+        Finish(ring, slot, std::move(subdirectories));
+    }
+
+    void Finish(Ring& ring, uint32_t slot, std::vector<PendingDirectory>&& subdirectories) {
+        if (!Stopping()) {
+            Push(std::move(subdirectories));
+        }
+        Done();
+        ring.freeSlots.push_back(slot);
+        --ring.active;
+    }
+
+    const ScanOptions& m_options;
+    ScanCounters& m_counters;
+    const std::atomic<bool>& m_cancel;
+    const ProjectSink& m_sink;
+    std::atomic<bool> m_stop{false};
+
+    std::mutex m_mutex; // guards everything below
+    std::condition_variable m_wake;
+    std::vector<PendingDirectory> m_stack;
+    size_t m_outstanding = 0; // pushed and not yet Done()
+    std::exception_ptr m_error;
+};
+
+#endif
+
+// Falls back to the blocking walkers where io_uring can't be used.
+bool WalkUring(const std::string& root, const ScanOptions& options, ScanCounters& counters,
+    const std::atomic<bool>& cancel, const ProjectSink& sink) {
+#ifdef __linux__
+    if (IoUringAvailable()) {
+        unsigned threads = options.parallel ? options.threadCount : 1;
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        ScanOptions uringOptions = options;
+        uringOptions.queueDepth = std::max(1u, options.queueDepth);
+        return UringWalk(uringOptions, counters, cancel, sink).Run(root, threads);
+    }
+#endif
+    return options.parallel ? WalkParallel(root, options, counters, cancel, sink)
+        : WalkSerial(root, options, counters, cancel, sink);
+}
+
+}
+
+void ScanErrorLog::Add(ScanFailure failure) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_count;
+    if (m_failures.size() < kMaxKept) {
+        m_failures.push_back(std::move(failure));
+    }
+}
+
+void ScanErrorLog::Clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_failures.clear();
+    m_count = 0;
+}
+
+size_t ScanErrorLog::Count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
+
+std::vector<ScanFailure> ScanErrorLog::Failures() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failures;
+}
+
+const char* ScanBackendName(ScanBackend backend) {
+    return backend == ScanBackend::IoUring ? "io_uring" : "portable";
+}
+
+bool ParseScanBackend(const std::string& name, ScanBackend& backend) {
+    if (name == "portable") {
+        backend = ScanBackend::Portable;
+    } else if (name == "io_uring") {
+        backend = ScanBackend::IoUring;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+ScanBackend EffectiveScanBackend(const ScanOptions& options) {
+    return options.backend == ScanBackend::IoUring && IoUringAvailable() ? ScanBackend::IoUring : ScanBackend::Portable;
+}
+
+bool IsSkippedDirectory(const std::string& name, const ScanOptions& options) {
+    for (const auto& skipped : options.skipDirectories) {
+#ifdef _WIN32
+        if (_stricmp(name.c_str(), skipped.c_str()) == 0) {
+#else
+        if (name == skipped) {
+#endif
+            return true;
+        }
+    }
+    return false;
+}
+
+bool StopsAtProject(ProjectType type, const ScanOptions& options) {
+    return type != ProjectType::None && options.pruneProjects && options.projectTypes->Prunes(type);
+}
+
+bool WalkForProjects(const std::string& root, const ScanOptions& options, ScanCounters& counters,
+    const std::atomic<bool>& cancel, const ProjectSink& sink) {
+    if (!options.projectTypes) {
+        ScanOptions resolved = options;
+        resolved.projectTypes = CurrentProjectTypes();
+        return WalkForProjects(root, resolved, counters, cancel, sink);
+    }
+    if (options.backend == ScanBackend::IoUring) {
+        return WalkUring(root, options, counters, cancel, sink);
+    }
+    if (options.parallel) {
+        return WalkParallel(root, options, counters, cancel, sink);
+    }
+    return WalkSerial(root, options, counters, cancel, sink);
+}
+
+std::vector<RootScanResult> WalkRoots(const std::vector<ScanRoot>& roots, const std::vector<ScanOptions>& options,
+    ScanCounters& counters, const std::atomic<bool>& cancel, const WorkspaceSink& sink) {
+    std::vector<RootScanResult> results(roots.size());
+    if (options.size() != roots.size()) {
+        for (RootScanResult& result : results) {
+            result.error = "no scan options for this root";
+        }
+        return results;
+    }
+
+    FileIdentitySet visited;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < roots.size(); ++i) {
+        threads.emplace_back([&, i] {
+            TRACE_SCOPE("WalkRoot");
+            ScanOptions rootOptions = options[i];
+            if (!rootOptions.visited) {
+                rootOptions.visited = &visited;
+            }
+            if (roots[i].threadCount) {
+                rootOptions.threadCount = roots[i].threadCount;
+            }
+            std::atomic<uint64_t> projects{0};
+            auto start = std::chrono::steady_clock::now();
+            try {
+                results[i].cancelled = !WalkForProjects(roots[i].path, rootOptions, counters, cancel,
+                    [&](ProjectInfo&& project, const ScanOrderKey& key) {
+                        projects.fetch_add(1, std::memory_order_relaxed);
+                        sink(i, std::move(project), key);
+                    });
+            } catch (const std::exception& e) {
+                results[i].error = e.what();
+            }
+            results[i].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            results[i].projects = projects.load();
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return results;
+}
+
+std::vector<std::string> ParseNameList(const std::string& list) {
+    std::vector<std::string> names;
+    std::string name;
+    std::istringstream stream(list);
+    while (std::getline(stream, name, ',')) {
+        size_t first = name.find_first_not_of(" \t");
+        size_t last = name.find_last_not_of(" \t");
+        if (first != std::string::npos) {
+            names.push_back(name.substr(first, last - first + 1));
+        }
+    }
+    return names;
+}
+
+std::vector<size_t> SortByScanOrder(const std::vector<ScanOrderKey>& keys) {
+    std::vector<size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+    return order;
+}
+
+void ApplyScanOrder(std::vector<ProjectInfo>& projects, const std::vector<size_t>& order) {
+    if (order.size() != projects.size()) {
+        return;
+    }
+    std::vector<ProjectInfo> sorted;
+    sorted.reserve(projects.size());
+    for (size_t index : order) {
+        sorted.push_back(std::move(projects[index]));
+    }
+    projects = std::move(sorted);
+}
+
+std::vector<ProjectInfo> ScanForProjects(const std::string& root, const ScanOptions& options) {
+    std::vector<ProjectInfo> projects;
+    std::vector<ScanOrderKey> keys;
+    std::mutex mutex;
+    ScanCounters counters;
+    std::atomic<bool> cancel{false};
+    try {
+        WalkForProjects(root, options, counters, cancel, [&](ProjectInfo&& project, const ScanOrderKey& key) {
+            std::lock_guard<std::mutex> lock(mutex);
+            projects.push_back(std::move(project));
+            keys.push_back(key);
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Error scanning: " << e.what() << std::endl;
+    }
+    ApplyScanOrder(projects, SortByScanOrder(keys));
+    return projects;
+}
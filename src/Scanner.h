@@ -0,0 +1,155 @@
+#pragma once
+
+#include "ProjectInfo.h"
+#include "ScanCounters.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ScanOptions;
+class FileIdentitySet;
+class ProjectMatcher;
+class ScanIndex;
+class ScanIndexBuilder;
+struct DirEntry;
+
+// Directories that are never worth walking into: engine caches, build output and VCS data.
+constexpr const char* kDefaultSkipDirectories = "Library,Intermediate,DerivedDataCache,Saved,.git,node_modules";
+
+// A directory a walk couldn't read. The walk carries on without it.
+struct ScanFailure {
+    std::string path;
+    std::string message;
+    int attempts = 1;
+};
+
+// Failures of one or more walks, shared between their threads. Only the first
+// kMaxKept are kept so a share full of denied folders can't grow it without
+// bound; the rest are only counted.
+class ScanErrorLog {
+public:
+    static constexpr size_t kMaxKept = 256;
+
+    void Add(ScanFailure failure);
+    void Clear();
+    size_t Count() const;
+    std::vector<ScanFailure> Failures() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<ScanFailure> m_failures;
+    size_t m_count = 0;
+};
+
+// How a walk lists directories. Both give the same results.
+enum class ScanBackend {
+    Portable, // one blocking open, read and stat at a time per walker thread
+    IoUring,  // Linux: opens, stats and closes batched through io_uring, many directories in flight per thread
+};
+
+const char* ScanBackendName(ScanBackend backend);
+// Accepts the names ScanBackendName returns. Returns false for anything else.
+bool ParseScanBackend(const std::string& name, ScanBackend& backend);
+// The backend a walk with options would actually use: IoUring falls back to
+// Portable where io_uring isn't available (not Linux, kernel before 5.6, or
+// turned off in a container).
+ScanBackend EffectiveScanBackend(const ScanOptions& options);
+
+// Splits a comma-separated list such as kDefaultSkipDirectories, trimming blanks.
+std::vector<std::string> ParseNameList(const std::string& list);
+
+struct ScanOptions {
+    ScanBackend backend = ScanBackend::Portable;
+    bool parallel = true;     // false selects the single-threaded walker, e.g. for comparison
+    unsigned threadCount = 0; // walker threads when parallel; 0 = one per hardware thread
+    unsigned queueDepth = 64; // IoUring: directories in flight per walker thread
+    int maxDepth = 0;         // deepest directory level below root to classify; 0 = unlimited
+    bool pruneProjects = true; // don't descend into a project, unless its type says to (ProjectTypeDefinition::prune)
+    std::shared_ptr<const ProjectMatcher> projectTypes; // what counts as a project; null = CurrentProjectTypes()
+    std::vector<std::string> skipDirectories = ParseNameList(kDefaultSkipDirectories); // never descended into
+
+    // Incremental rescans: directories whose mtime matches previous aren't listed again.
+    // previous must come from a walk of the same root with the same options.
+    std::shared_ptr<const ScanIndex> previous;
+    // When set, every directory visited is recorded here to build the next index.
+    ScanIndexBuilder* record = nullptr;
+
+    // For walking a subtree of a larger scan: the depth of root in that scan, so
+    // maxDepth keeps its meaning, and whether root itself may be a project.
+    int rootDepth = 0;
+    bool classifyRoot = false;
+    // Called with the path of every directory just before it is listed or reused, from the walking thread.
+    std::function<void(const std::string&)> directoryVisited;
+    // Directories already walked or reported, by (device, inode). Shared between walks
+    // of overlapping roots so no subtree is walked twice; also stops bind-mount loops.
+    FileIdentitySet* visited = nullptr;
+
+    // Directories below the root that can't be read are skipped and added here, if set.
+    ScanErrorLog* errors = nullptr;
+    // Errors typical of a flaky network share (timeouts, resets, stale handles)
+    // are retried this many times, waiting retryDelayMs and doubling it each time.
+    int transientRetries = 3;
+    int retryDelayMs = 50;
+};
+
+// One root of a workspace.
+struct ScanRoot {
+    std::string path;
+    unsigned threadCount = 0; // this root's walkers; 0 = ScanOptions::threadCount. Keep slow shares low.
+};
+
+struct RootScanResult {
+    double seconds = 0;
+    uint64_t projects = 0;
+    std::string error; // empty on success
+    bool cancelled = false;
+};
+
+// Position of a directory in a single-threaded depth-first walk: the index of
+// each ancestor among its parent's subdirectories, root first. Comparing keys
+// lexicographically reproduces the serial walk order whatever order the
+// parallel walker happened to find things in.
+using ScanOrderKey = std::vector<uint32_t>;
+
+// Called once for every project, on the thread that found it.
+using ProjectSink = std::function<void(ProjectInfo&&, const ScanOrderKey&)>;
+
+// Walks root and hands each project to sink as soon as it is classified.
+// Stops early when cancel becomes true. Returns false if the walk was cancelled.
+// A directory below root that can't be read is skipped, counted in
+// counters.directoriesFailed and logged to options.errors; only a root that
+// can't be read throws std::filesystem::filesystem_error.
+bool WalkForProjects(const std::string& root, const ScanOptions& options, ScanCounters& counters,
+    const std::atomic<bool>& cancel, const ProjectSink& sink);
+
+// Called once for every project, with the index of the root it was found under.
+using WorkspaceSink = std::function<void(size_t root, ProjectInfo&&, const ScanOrderKey&)>;
+
+// Walks every root at once, each on its own thread with its own pool of
+// roots[i].threadCount walkers, so a slow network share only holds up its own
+// walk. options[i] applies to roots[i]. Roots share one set of visited
+// directories, so nested or overlapping roots don't walk anything twice; a
+// subtree goes to whichever root reaches it first. A root that fails or is
+// cancelled doesn't stop the others. Returns one result per root.
+std::vector<RootScanResult> WalkRoots(const std::vector<ScanRoot>& roots, const std::vector<ScanOptions>& options,
+    ScanCounters& counters, const std::atomic<bool>& cancel, const WorkspaceSink& sink);
+
+// Whether a walk with options stops below a project of this type. False for ProjectType::None.
+// options.projectTypes must be set.
+bool StopsAtProject(ProjectType type, const ScanOptions& options);
+// Whether a subdirectory with this name is on options.skipDirectories.
+bool IsSkippedDirectory(const std::string& name, const ScanOptions& options);
+
+// Returns the permutation that puts items reported with these keys into serial walk order.
+std::vector<size_t> SortByScanOrder(const std::vector<ScanOrderKey>& keys);
+// Reorders projects by a permutation from SortByScanOrder. Ignored if the sizes don't match.
+void ApplyScanOrder(std::vector<ProjectInfo>& projects, const std::vector<size_t>& order);
+
+// Blocking convenience wrapper: walks the whole tree and returns every project in serial walk order.
+std::vector<ProjectInfo> ScanForProjects(const std::string& root, const ScanOptions& options = ScanOptions());
@@ -0,0 +1,330 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+std::atomic<bool> g_tracingEnabled{false};
+std::atomic<uint64_t> g_traceCounters[(size_t)TraceCounter::Count] = {};
+
+namespace {
+
+constexpr size_t kMaxEventsPerThread = 1 << 16;
+constexpr size_t kMaxCounterSamples = 1 << 16;
+
+struct TraceEvent {
+    const char* name;
+    int64_t start;
+    int64_t micros;
+};
+
+// Spans recorded by one thread. Only that thread appends, so its lock is
+// uncontended except while an export copies the events out.
+struct ThreadBuffer {
+    uint32_t tid = 0;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    uint64_t dropped = 0;
+};
+
+struct CounterSample {
+    int64_t time;
+    uint64_t values[(size_t)TraceCounter::Count];
+};
+
+struct Registry {
+    std::mutex mutex; // guards everything below
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer*> freeBuffers; // left behind by threads that exited
+    std::vector<TraceSite*> sites;
+    std::vector<CounterSample> samples;
+    int64_t epoch = 0; // start of the current recording
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+// A thread's buffer goes back to the registry when the thread exits, so the
+// short-lived threads of each scan don't add a buffer apiece. Its spans stay;
+// the next thread to take it shows up on the same row of the trace.
+struct ThreadSlot {
+    ThreadBuffer* buffer = nullptr;
+
+    ~ThreadSlot() {
+        if (buffer) {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.freeBuffers.push_back(buffer);
+        }
+    }
+};
+
+thread_local ThreadSlot t_slot;
+
+ThreadBuffer& CurrentBuffer() {
+    if (!t_slot.buffer) {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        if (!registry.freeBuffers.empty()) {
+            t_slot.buffer = registry.freeBuffers.back();
+            registry.freeBuffers.pop_back();
+        } else {
+            registry.buffers.push_back(std::make_unique<ThreadBuffer>());
+            t_slot.buffer = registry.buffers.back().get();
+            t_slot.buffer->tid = (uint32_t)registry.buffers.size();
+        }
+    }
+    return *t_slot.buffer;
+}
+
+void WriteJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+const char* const kCounterNames[] = {
+    "directoriesListed",
+    "entriesSeen",
+    "syscalls",
+    "bytesRead",
+    "bytesWritten",
+};
+static_assert(sizeof(kCounterNames) / sizeof(kCounterNames[0]) == (size_t)TraceCounter::Count,
+    "one name per TraceCounter");
+
+}
+
+const char* TraceCounterName(TraceCounter counter) {
+    return kCounterNames[(size_t)counter];
+}
+
+int64_t TraceNowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t ThreadCpuMicros() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    // 100ns ticks
+    uint64_t ticks = ((uint64_t)kernel.dwHighDateTime << 32 | kernel.dwLowDateTime)
+        + ((uint64_t)user.dwHighDateTime << 32 | user.dwLowDateTime);
+    return (int64_t)(ticks / 10);
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+        return 0;
+    }
+    return (int64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+#else
+    return TraceNowMicros();
+#endif
+}
+
+void SetTracing(bool enabled) {
+    if (enabled && !g_tracingEnabled.load()) {
+        ClearTrace();
+    }
+    g_tracingEnabled = enabled;
+}
+
+void ClearTrace() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& buffer : registry.buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->events.clear();
+        buffer->dropped = 0;
+    }
+    for (TraceSite* site : registry.sites) {
+        site->Reset();
+    }
+    for (auto& counter : g_traceCounters) {
+        counter = 0;
+    }
+    registry.samples.clear();
+    registry.epoch = TraceNowMicros();
+}
+
+uint64_t TraceCounterValue(TraceCounter counter) {
+    return g_traceCounters[(size_t)counter].load(std::memory_order_relaxed);
+}
+
+void SampleTraceCounters() {
+    if (!TracingEnabled()) {
+        return;
+    }
+    CounterSample sample;
+    sample.time = TraceNowMicros();
+    for (size_t i = 0; i < (size_t)TraceCounter::Count; ++i) {
+        sample.values[i] = g_traceCounters[i].load(std::memory_order_relaxed);
+    }
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    // Only changes are worth a point on the graph
+    if (!registry.samples.empty() && std::equal(std::begin(sample.values), std::end(sample.values),
+            std::begin(registry.samples.back().values))) {
+        return;
+    }
+    if (registry.samples.size() < kMaxCounterSamples) {
+        registry.samples.push_back(sample);
+    }
+}
+
+TraceSite::TraceSite(const char* name) : m_name(name) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.sites.push_back(this);
+}
+
+void TraceSite::AddSample(int64_t micros) {
+    uint64_t value = micros > 0 ? (uint64_t)micros : 0;
+    int bucket = 0;
+    for (uint64_t v = value >> 1; v && bucket < kBuckets - 1; v >>= 1) {
+        ++bucket;
+    }
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_totalMicros.fetch_add(value, std::memory_order_relaxed);
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = m_maxMicros.load(std::memory_order_relaxed);
+    while (value > max && !m_maxMicros.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+void TraceSite::Record(int64_t startMicros, int64_t micros) {
+    AddSample(micros);
+    ThreadBuffer& buffer = CurrentBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.size() < kMaxEventsPerThread) {
+        buffer.events.push_back({ m_name, startMicros, micros });
+    } else {
+        ++buffer.dropped;
+    }
+}
+
+TraceSite::Stats TraceSite::Snapshot() const {
+    Stats stats;
+    stats.count = m_count.load(std::memory_order_relaxed);
+    stats.totalMicros = m_totalMicros.load(std::memory_order_relaxed);
+    stats.maxMicros = m_maxMicros.load(std::memory_order_relaxed);
+    for (int i = 0; i < kBuckets; ++i) {
+        stats.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void TraceSite::Reset() {
+    m_count = 0;
+    m_totalMicros = 0;
+    m_maxMicros = 0;
+    for (auto& bucket : m_buckets) {
+        bucket = 0;
+    }
+}
+
+void TraceSites(std::vector<TraceSite*>& sites) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    sites.assign(registry.sites.begin(), registry.sites.end());
+}
+
+bool WriteChromeTrace(const std::string& path, std::string& error) {
+    // Copied out first so recording threads are held up only briefly
+    struct ThreadEvents {
+        uint32_t tid;
+        std::vector<TraceEvent> events;
+        uint64_t dropped;
+    };
+    std::vector<ThreadEvents> threads;
+    std::vector<CounterSample> samples;
+    int64_t epoch;
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& buffer : registry.buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            threads.push_back({ buffer->tid, buffer->events, buffer->dropped });
+        }
+        samples = registry.samples;
+        epoch = registry.epoch;
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "can't write " + path;
+        return false;
+    }
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"ProjectNavigator\"}}";
+    for (const ThreadEvents& thread : threads) {
+        for (const TraceEvent& event : thread.events) {
+            out << ",\n{\"name\":";
+            WriteJsonString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.tid
+                << ",\"ts\":" << std::max<int64_t>(event.start - epoch, 0) << ",\"dur\":" << event.micros << "}";
+        }
+        if (thread.dropped) {
+            out << ",\n{\"name\":\"dropped_spans\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.tid
+                << ",\"args\":{\"count\":" << thread.dropped << "}}";
+        }
+    }
+    for (const CounterSample& sample : samples) {
+        for (size_t i = 0; i < (size_t)TraceCounter::Count; ++i) {
+            out << ",\n{\"name\":\"" << kCounterNames[i] << "\",\"ph\":\"C\",\"pid\":1,\"ts\":"
+                << std::max<int64_t>(sample.time - epoch, 0) << ",\"args\":{\"value\":" << sample.values[i] << "}}";
+        }
+    }
+    out << "\n]}\n";
+    if (!out.flush()) {
+        error = "error writing " + path;
+        return false;
+    }
+    return true;
+}
+
+StartupTimer::StartupTimer() : m_start(TraceNowMicros()), m_last(m_start) {}
+
+void StartupTimer::Mark(const char* name) {
+    int64_t now = TraceNowMicros();
+    m_phases.push_back({ name, m_last - m_start, now - m_last });
+    m_last = now;
+}
+
+void StartupTimer::Add(const char* name, int64_t startMicros, int64_t micros) {
+    m_phases.push_back({ name, startMicros - m_start, micros });
+}
+
+std::string StartupTimer::ToJson() const {
+    std::ostringstream out;
+    out << "{\"time\":" << (long long)time(nullptr) << ",\"totalMs\":" << ElapsedMicros() / 1000.0 << ",\"phases\":{";
+    for (size_t i = 0; i < m_phases.size(); ++i) {
+        out << (i ? "," : "");
+        WriteJsonString(out, m_phases[i].name);
+        out << ":" << m_phases[i].micros / 1000.0;
+    }
+    out << "}}";
+    return out.str();
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Built-in instrumentation: named scoped timers with a latency histogram each,
+// a few process-wide counters, and an export to Chrome's trace-event format
+// (load the file in chrome://tracing or ui.perfetto.dev).
+//
+// Nothing is recorded until SetTracing(true). While tracing is off a timer or
+// counter costs one relaxed atomic load; building with
+// PROJECTNAVIGATOR_NO_TRACING compiles the TRACE_ macros out altogether.
+
+enum class TraceCounter {
+    DirectoriesListed,
+    EntriesSeen,
+    Syscalls,     // filesystem calls made by the scanner and the size walker
+    BytesRead,    // index, cache and project files read
+    BytesWritten,
+    Count
+};
+
+const char* TraceCounterName(TraceCounter counter);
+
+extern std::atomic<bool> g_tracingEnabled;
+extern std::atomic<uint64_t> g_traceCounters[(size_t)TraceCounter::Count];
+
+inline bool TracingEnabled() {
+    return g_tracingEnabled.load(std::memory_order_relaxed);
+}
+
+// Turning tracing on starts a fresh recording; turning it off keeps what was
+// recorded so it can still be looked at and exported.
+void SetTracing(bool enabled);
+void ClearTrace();
+
+inline void TraceCount(TraceCounter counter, uint64_t amount = 1) {
+    if (TracingEnabled()) {
+        g_traceCounters[(size_t)counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+uint64_t TraceCounterValue(TraceCounter counter);
+
+// Appends the current counter values to the trace as counter events. Called
+// once per frame by the GUI, so the counters show up as graphs over time.
+void SampleTraceCounters();
+
+// Microseconds on a steady clock, and CPU time used by the calling thread.
+int64_t TraceNowMicros();
+int64_t ThreadCpuMicros();
+
+// One instrumented place in the code. Keeps a histogram of its durations;
+// bucket i counts durations in [2^i, 2^(i+1)) microseconds, bucket 0 everything under 2.
+class TraceSite {
+public:
+    static constexpr int kBuckets = 24;
+
+    struct Stats {
+        uint64_t count = 0;
+        uint64_t totalMicros = 0;
+        uint64_t maxMicros = 0;
+        uint64_t buckets[kBuckets] = {};
+    };
+
+    // name must outlive the program, e.g. a string literal. Registers the site for TraceSites().
+    explicit TraceSite(const char* name);
+
+    TraceSite(const TraceSite&) = delete;
+    TraceSite& operator=(const TraceSite&) = delete;
+
+    const char* Name() const { return m_name; }
+
+    // Adds a duration to the histogram only.
+    void AddSample(int64_t micros);
+    // Adds a duration to the histogram and a span to the calling thread's trace.
+    void Record(int64_t startMicros, int64_t micros);
+
+    Stats Snapshot() const;
+    void Reset();
+
+private:
+    const char* m_name;
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_totalMicros{0};
+    std::atomic<uint64_t> m_maxMicros{0};
+    std::atomic<uint64_t> m_buckets[kBuckets] = {};
+};
+
+// Every site that has run at least once, in the order they first ran. Fills
+// sites, reusing its storage, so a caller polling every frame doesn't allocate.
+void TraceSites(std::vector<TraceSite*>& sites);
+
+// Records the time from construction to destruction against site, if tracing
+// was on at construction.
+class TraceScope {
+public:
+    explicit TraceScope(TraceSite& site)
+        : m_site(TracingEnabled() ? &site : nullptr), m_start(m_site ? TraceNowMicros() : 0) {}
+    ~TraceScope() {
+        if (m_site) {
+            m_site->Record(m_start, TraceNowMicros() - m_start);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceSite* m_site;
+    int64_t m_start;
+};
+
+// Writes everything recorded so far as Chrome trace-event JSON. Spans beyond
+// a per-thread cap are left out (their durations still reach the histograms);
+// the number dropped is written as metadata.
+bool WriteChromeTrace(const std::string& path, std::string& error);
+
+// Durations of the phases of starting up, recorded whether or not tracing is
+// on so every start can be compared with the last. Phases on the calling
+// thread follow each other: Mark() ends the current one and begins the next.
+// Work done on another thread meanwhile is added with Add(). Not thread-safe.
+class StartupTimer {
+public:
+    struct Phase {
+        const char* name;    // must outlive the timer, e.g. a string literal
+        int64_t startMicros; // since the timer was created
+        int64_t micros;
+    };
+
+    StartupTimer();
+
+    void Mark(const char* name);
+    void Add(const char* name, int64_t startMicros, int64_t micros); // TraceNowMicros() times
+
+    const std::vector<Phase>& Phases() const { return m_phases; }
+    // From construction to the end of the last Mark()
+    int64_t ElapsedMicros() const { return m_last - m_start; }
+
+    // The report as one line of JSON: {"time":...,"totalMs":...,"phases":{"name":ms,...}}
+    std::string ToJson() const;
+
+private:
+    int64_t m_start;
+    int64_t m_last;
+    std::vector<Phase> m_phases;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef PROJECTNAVIGATOR_NO_TRACING
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNT(counter, amount) ((void)(amount))
+#else
+// Times the rest of the enclosing block under name.
+#define TRACE_SCOPE(name) \
+    static TraceSite TRACE_CONCAT(traceSite_, __LINE__)(name); \
+    TraceScope TRACE_CONCAT(traceScope_, __LINE__)(TRACE_CONCAT(traceSite_, __LINE__))
+#define TRACE_COUNT(counter, amount) TraceCount(TraceCounter::counter, amount)
+#endif
@@ -0,0 +1,111 @@
+#include "WorkStealingPool.h"
+
+namespace {
+// Identifies the pool and worker the current thread belongs to, so Submit()
+// from inside a task can push onto the caller's own deque.
+thread_local const WorkStealingPool* t_pool = nullptr;
+thread_local unsigned t_workerIndex = 0;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_workers[i]->thread = std::thread(&WorkStealingPool::WorkerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (auto& worker : m_workers) {
+        worker->thread.join();
+    }
+}
+
+void WorkStealingPool::Submit(Task task) {
+    unsigned index;
+    if (t_pool == this) {
+        index = t_workerIndex;
+    } else {
+        index = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % (unsigned)m_workers.size();
+    }
+
+    // Count the task before it becomes visible so m_queued never underflows;
+    // a worker woken early just retries until the push below lands.
+    m_unfinished.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        m_queued.fetch_add(1);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+        m_workers[index]->tasks.push_back(std::move(task));
+    }
+    m_workAvailable.notify_one();
+}
+
+void WorkStealingPool::Wait() {
+    std::unique_lock<std::mutex> lock(m_idleMutex);
+    m_allDone.wait(lock, [this] { return m_unfinished.load() == 0; });
+}
+
+bool WorkStealingPool::TryPop(unsigned index, Task& task) {
+    Worker& worker = *m_workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::TrySteal(unsigned thief, Task& task) {
+    unsigned count = (unsigned)m_workers.size();
+    for (unsigned offset = 1; offset < count; ++offset) {
+        Worker& victim = *m_workers[(thief + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::WorkerLoop(unsigned index) {
+    t_pool = this;
+    t_workerIndex = index;
+
+    Task task;
+    for (;;) {
+        if (TryPop(index, task) || TrySteal(index, task)) {
+            m_queued.fetch_sub(1);
+            task();
+            task = nullptr;
+            if (m_unfinished.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(m_idleMutex);
+                m_allDone.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        m_workAvailable.wait(lock, [this] { return m_stopping || m_queued.load() > 0; });
+        if (m_stopping) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size thread pool where every worker owns a deque of tasks. Workers pop
+// their own newest task first (depth-first, cache friendly) and, when empty,
+// steal the oldest task from another worker. Tasks submitted from inside a
+// task go to the submitting worker's own deque, so a slow subtree only ties up
+// one worker while the others keep draining the rest.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // threadCount == 0 uses one worker per hardware thread.
+    explicit WorkStealingPool(unsigned threadCount = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned ThreadCount() const { return (unsigned)m_workers.size(); }
+
+    void Submit(Task task);
+    // Blocks until every submitted task, including tasks submitted by tasks, has run.
+    void Wait();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void WorkerLoop(unsigned index);
+    bool TryPop(unsigned index, Task& task);
+    bool TrySteal(unsigned thief, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<unsigned> m_nextQueue{0};
+    std::atomic<size_t> m_queued{0};     // tasks sitting in deques
+    std::atomic<size_t> m_unfinished{0}; // tasks queued or running
+    bool m_stopping = false;
+
+    std::mutex m_idleMutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_allDone;
+};
@@ -0,0 +1,389 @@
+// Scanner benchmark: generates a synthetic directory tree with a known mix of
+// Unity and Unreal projects, runs each scan variant over it and prints one
+// JSON object per run so results can be collected and compared over time.
+
+#include "DirectoryLister.h"
+#include "ScanIndex.h"
+#include "Scanner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct TreeShape {
+    int fanout = 8;          // subdirectories per directory
+    int depth = 4;           // levels below the root
+    int filesPerDir = 4;     // plain files in every directory
+    double unityShare = 0.02;  // chance a directory is a Unity project
+    double unrealShare = 0.02; // chance a directory is an Unreal project
+    int projectFiles = 32;   // files inside each project's heavy folders (Library/, Content/)
+    unsigned seed = 1;
+};
+
+struct BenchOptions {
+    TreeShape shape;
+    std::string root;        // the tree goes in a new folder under here; empty = temp directory
+    bool keep = false;       // leave the tree on disk afterwards
+    bool reuse = false;      // scan an existing tree at root instead of generating one
+    unsigned threads = 0;
+    int repeat = 3;
+    std::vector<std::string> variants = { "legacy", "serial", "parallel", "incremental" };
+    std::vector<ScanBackend> backends = { ScanBackend::Portable, ScanBackend::IoUring };
+};
+
+struct TreeStats {
+    uint64_t directories = 0;
+    uint64_t files = 0;
+    uint64_t unity = 0;
+    uint64_t unreal = 0;
+};
+
+void PrintUsage(const char* program) {
+    std::cerr <<
+        "Usage: " << program << " [options]\n"
+        "\n"
+        "Tree shape:\n"
+        "  --fanout=N          subdirectories per directory (default: 8)\n"
+        "  --depth=N           levels below the root (default: 4)\n"
+        "  --files=N           files per directory (default: 4)\n"
+        "  --unity=F           share of directories that are Unity projects (default: 0.02)\n"
+        "  --unreal=F          share of directories that are Unreal projects (default: 0.02)\n"
+        "  --project-files=N   files in each project's cache folder (default: 32)\n"
+        "  --seed=N            generator seed (default: 1)\n"
+        "\n"
+        "Run:\n"
+        "  --root=DIR          generate the tree in a new ProjectNavigatorBench-SEED folder under DIR,\n"
+        "                      e.g. on tmpfs (default: temp directory)\n"
+        "  --reuse             scan the existing tree at --root instead of generating one\n"
+        "  --keep              don't delete the generated tree\n"
+        "  --threads=N         parallel walker threads, 0 = hardware (default: 0)\n"
+        "  --repeat=N          runs per variant (default: 3)\n"
+        "  --variants=A,B      any of legacy,serial,parallel,incremental (default: all)\n"
+        "  --backends=A,B      any of portable,io_uring; every variant but legacy runs on each (default: both)\n";
+}
+
+bool Flag(const char* arg, const char* name, const char** value) {
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+        return false;
+    }
+    *value = arg + length + 1;
+    return true;
+}
+
+int ParseArguments(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = nullptr;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            PrintUsage(argv[0]);
+            return -1;
+        } else if (Flag(arg, "--fanout", &value)) {
+            options.shape.fanout = atoi(value);
+        } else if (Flag(arg, "--depth", &value)) {
+            options.shape.depth = atoi(value);
+        } else if (Flag(arg, "--files", &value)) {
+            options.shape.filesPerDir = atoi(value);
+        } else if (Flag(arg, "--unity", &value)) {
+            options.shape.unityShare = atof(value);
+        } else if (Flag(arg, "--unreal", &value)) {
+            options.shape.unrealShare = atof(value);
+        } else if (Flag(arg, "--project-files", &value)) {
+            options.shape.projectFiles = atoi(value);
+        } else if (Flag(arg, "--seed", &value)) {
+            options.shape.seed = (unsigned)strtoul(value, nullptr, 10);
+        } else if (Flag(arg, "--root", &value)) {
+            options.root = value;
+        } else if (strcmp(arg, "--reuse") == 0) {
+            options.reuse = true;
+        } else if (strcmp(arg, "--keep") == 0) {
+            options.keep = true;
+        } else if (Flag(arg, "--threads", &value)) {
+            options.threads = (unsigned)strtoul(value, nullptr, 10);
+        } else if (Flag(arg, "--repeat", &value)) {
+            options.repeat = atoi(value);
+        } else if (Flag(arg, "--variants", &value)) {
+            options.variants = ParseNameList(value);
+        } else if (Flag(arg, "--backends", &value)) {
+            options.backends.clear();
+            for (const std::string& name : ParseNameList(value)) {
+                ScanBackend backend;
+                if (!ParseScanBackend(name, backend)) {
+                    std::cerr << "Unknown backend: " << name << "\n";
+                    return 2;
+                }
+                options.backends.push_back(backend);
+            }
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 2;
+        }
+    }
+    if (options.shape.fanout < 1 || options.shape.depth < 1 || options.repeat < 1) {
+        std::cerr << "fanout, depth and repeat must be at least 1\n";
+        return 2;
+    }
+    if (options.reuse && options.root.empty()) {
+        std::cerr << "--reuse needs --root\n";
+        return 2;
+    }
+    return 0;
+}
+
+void TouchFile(const fs::path& path) {
+    std::ofstream file(path, std::ios::binary);
+}
+
+void MakeFiles(const fs::path& dir, int count, TreeStats& stats) {
+    for (int i = 0; i < count; ++i) {
+        TouchFile(dir / ("file" + std::to_string(i) + ".dat"));
+    }
+    stats.files += (uint64_t)count;
+}
+
+// Project layouts carry a heavy cache folder so pruning and skip lists have something to skip
+void MakeUnityProject(const fs::path& dir, const TreeShape& shape, TreeStats& stats) {
+    fs::create_directory(dir / "Assets");
+    fs::create_directory(dir / "ProjectSettings");
+    fs::create_directory(dir / "Library");
+    TouchFile(dir / "ProjectSettings" / "ProjectVersion.txt");
+    MakeFiles(dir / "Library", shape.projectFiles, stats);
+    stats.directories += 3;
+    ++stats.unity;
+}
+
+void MakeUnrealProject(const fs::path& dir, const TreeShape& shape, TreeStats& stats) {
+    TouchFile(dir / (dir.filename().string() + ".uproject"));
+    fs::create_directory(dir / "Content");
+    fs::create_directory(dir / "DerivedDataCache");
+    MakeFiles(dir / "DerivedDataCache", shape.projectFiles, stats);
+    stats.directories += 2;
+    ++stats.unreal;
+}
+
+void GenerateTree(const fs::path& dir, int level, const TreeShape& shape, std::mt19937& rng, TreeStats& stats) {
+    std::uniform_real_distribution<double> roll(0.0, 1.0);
+    MakeFiles(dir, shape.filesPerDir, stats);
+    if (level >= shape.depth) {
+        return;
+    }
+    for (int i = 0; i < shape.fanout; ++i) {
+        fs::path child = dir / ("dir" + std::to_string(i));
+        fs::create_directory(child);
+        ++stats.directories;
+
+        double kind = roll(rng);
+        if (kind < shape.unityShare) {
+            MakeUnityProject(child, shape, stats);
+        } else if (kind < shape.unityShare + shape.unrealShare) {
+            MakeUnrealProject(child, shape, stats);
+        } else {
+            GenerateTree(child, level + 1, shape, rng, stats);
+        }
+    }
+}
+
+uint64_t PeakRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return (uint64_t)counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)usage.ru_maxrss * 1024; // kilobytes on Linux
+#endif
+}
+
+// The scanner as it shipped originally: recursive_directory_iterator plus two
+// exists() probes and a second listing per directory. Kept as a baseline; its
+// syscall counts are estimated at two listings (an open, two getdents and a
+// close each) and two probes per directory.
+uint64_t ScanLegacy(const std::string& root, ScanCounters& counters) {
+    uint64_t projects = 0;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (entry.is_directory()) {
+            counters.directoriesVisited.fetch_add(1, std::memory_order_relaxed);
+            counters.directoriesListed.fetch_add(2, std::memory_order_relaxed);
+            counters.statCalls.fetch_add(2, std::memory_order_relaxed);
+            counters.syscalls.fetch_add(2 * 4 + 2, std::memory_order_relaxed);
+            bool hasAssets = fs::exists(entry.path() / "Assets");
+            bool hasSettings = fs::exists(entry.path() / "ProjectSettings");
+            if (hasAssets && hasSettings) {
+                ++projects;
+                continue;
+            }
+            for (const auto& file : fs::directory_iterator(entry.path())) {
+                if (file.path().extension() == ".uproject") {
+                    ++projects;
+                    break;
+                }
+            }
+        }
+    }
+    counters.projectsFound = projects;
+    return projects;
+}
+
+struct RunResult {
+    double seconds = 0.0;
+    uint64_t projects = 0;
+    ScanCounters counters;
+};
+
+void PrintResult(const std::string& variant, ScanBackend backend, int run, const BenchOptions& options,
+    const TreeStats& tree, const RunResult& result) {
+    const ScanCounters& c = result.counters;
+    uint64_t visited = c.directoriesVisited.load();
+    printf("{\"variant\":\"%s\",\"backend\":\"%s\",\"run\":%d,\"threads\":%u,"
+        "\"tree\":{\"fanout\":%d,\"depth\":%d,\"files\":%d,\"seed\":%u,\"directories\":%llu,\"unity\":%llu,\"unreal\":%llu},"
+        "\"seconds\":%.6f,\"directoriesVisited\":%llu,\"directoriesPerSecond\":%.1f,"
+        "\"projects\":%llu,\"directoriesListed\":%llu,\"statCalls\":%llu,\"syscalls\":%llu,"
+        "\"directoriesReused\":%llu,\"peakRssBytes\":%llu}\n",
+        variant.c_str(), ScanBackendName(backend), run, options.threads,
+        options.shape.fanout, options.shape.depth, options.shape.filesPerDir, options.shape.seed,
+        (unsigned long long)tree.directories, (unsigned long long)tree.unity, (unsigned long long)tree.unreal,
+        result.seconds, (unsigned long long)visited, result.seconds > 0 ? visited / result.seconds : 0.0,
+        (unsigned long long)result.projects, (unsigned long long)c.directoriesListed.load(),
+        (unsigned long long)c.statCalls.load(), (unsigned long long)c.syscalls.load(),
+        (unsigned long long)c.directoriesReused.load(), (unsigned long long)PeakRssBytes());
+    fflush(stdout);
+}
+
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    int parsed = ParseArguments(argc, argv, options);
+    if (parsed != 0) {
+        return parsed < 0 ? 0 : parsed;
+    }
+
+    // A generated tree always goes in a folder this run creates, so only that
+    // folder is ever deleted; --root itself may hold anything.
+    fs::path root;
+    if (options.reuse) {
+        root = options.root;
+    } else {
+        fs::path parent = options.root.empty() ? fs::temp_directory_path() : fs::path(options.root);
+        root = parent / ("ProjectNavigatorBench-" + std::to_string(options.shape.seed));
+        std::error_code ec;
+        fs::create_directories(parent, ec);
+        if (!fs::create_directory(root, ec)) {
+            std::cerr << root.string() << (ec ? ": " + ec.message() : std::string(" already exists"))
+                      << "; scan it with --reuse --root=" << root.string() << " or remove it\n";
+            return 1;
+        }
+    }
+
+    TreeStats tree;
+    if (!options.reuse) {
+        auto start = std::chrono::steady_clock::now();
+        std::mt19937 rng(options.shape.seed);
+        GenerateTree(root, 0, options.shape, rng, tree);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Generated " << tree.directories << " directories, " << tree.files << " files, "
+                  << tree.unity << " Unity and " << tree.unreal << " Unreal projects in " << seconds << " s\n";
+    }
+
+    ScanOptions probe;
+    probe.backend = ScanBackend::IoUring;
+    bool uringWanted = std::find(options.backends.begin(), options.backends.end(), ScanBackend::IoUring) !=
+        options.backends.end();
+    if (uringWanted && EffectiveScanBackend(probe) != ScanBackend::IoUring) {
+        std::cerr << "io_uring isn't available here; its runs fall back to the portable backend\n";
+    }
+
+    int exitCode = 0;
+    for (const auto& variant : options.variants) {
+        for (ScanBackend backend : options.backends) {
+            // legacy doesn't go through the walker, so it runs once
+            if (variant == "legacy" && backend != options.backends.front()) {
+                continue;
+            }
+            // incremental measures a warm rescan: one untimed cold scan builds the index first
+            std::shared_ptr<const ScanIndex> index;
+            if (variant == "incremental") {
+                ScanIndexBuilder builder;
+                ScanOptions scan;
+                scan.backend = backend;
+                scan.threadCount = options.threads;
+                scan.record = &builder;
+                ScanCounters counters;
+                std::atomic<bool> cancel{false};
+                WalkForProjects(root.string(), scan, counters, cancel, [](ProjectInfo&&, const ScanOrderKey&) {});
+                index = builder.Build(root.string(), HashScanOptions(scan));
+            }
+
+            for (int run = 0; run < options.repeat; ++run) {
+                RunResult result;
+                std::atomic<uint64_t> projects{0};
+                std::atomic<bool> cancel{false};
+                auto count = [&](ProjectInfo&&, const ScanOrderKey&) { projects.fetch_add(1, std::memory_order_relaxed); };
+
+                ScanOptions scan;
+                scan.backend = variant == "legacy" ? ScanBackend::Portable : backend;
+                scan.threadCount = options.threads;
+                auto start = std::chrono::steady_clock::now();
+                try {
+                    if (variant == "legacy") {
+                        projects = ScanLegacy(root.string(), result.counters);
+                    } else if (variant == "serial") {
+                        scan.parallel = false;
+                        WalkForProjects(root.string(), scan, result.counters, cancel, count);
+                    } else if (variant == "parallel") {
+                        WalkForProjects(root.string(), scan, result.counters, cancel, count);
+                    } else if (variant == "incremental") {
+                        scan.previous = index;
+                        WalkForProjects(root.string(), scan, result.counters, cancel, count);
+                    } else {
+                        std::cerr << "Unknown variant: " << variant << "\n";
+                        exitCode = 2;
+                        break;
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << variant << " failed: " << e.what() << "\n";
+                    exitCode = 1;
+                    break;
+                }
+                result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                result.projects = projects.load();
+                PrintResult(variant, EffectiveScanBackend(scan), run, options, tree, result);
+            }
+        }
+    }
+
+    if (!options.reuse && !options.keep) {
+        std::error_code ec;
+        fs::remove_all(root, ec);
+    } else if (!options.reuse) {
+        std::cerr << "Kept the tree at " << root.string() << "\n";
+    }
+    return exitCode;
+}
@@ -0,0 +1,490 @@
+// Headless front-end: scans one or more roots concurrently and streams every
+// project found as newline-delimited JSON or CSV. No window or GL context is created, so it
+// runs on build agents without a display.
+
+#include "ProjectAnalysis.h"
+#include "ProjectStore.h"
+#include "ProjectTypes.h"
+#include "ScanArguments.h"
+#include "ScanEngine.h"
+#include "ScanService.h"
+#include "Scanner.h"
+#include "Trace.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+enum class OutputFormat { JsonLines, Csv };
+
+struct CliOptions : ScanArguments {
+    OutputFormat format = OutputFormat::JsonLines;
+    std::string outputPath; // empty = stdout
+    bool timings = false;
+    std::string tracePath; // empty = no trace
+    std::string servicePath; // --service; empty = scan here
+    std::string query;       // --query; only with a service
+    bool hasQuery = false;
+    bool analyze = false;
+    std::string indexBase;     // --index; empty = nothing kept between runs
+    std::string analysisCache; // --analysis-cache; empty = next to the index
+    AnalysisOptions analysis;
+};
+
+void PrintUsage(const char* program) {
+    std::cerr <<
+        "Usage: " << program << " [options] <root> [<root>...]\n"
+        "       " << program << " --service[=SOCKET] [--query=TEXT] [options] [<root>...]\n"
+        "       " << program << " --analyze [--index=BASE] [options] <root> [<root>...]\n"
+        "\n"
+        "Scans the roots for projects (Unity, Unreal, Godot, Visual Studio, CMake and any\n"
+        "--type), all at once, and writes one record per project as soon as it is found.\n"
+        "A folder reachable from several roots (nested roots, bind mounts) is only scanned\n"
+        "and reported under the first to reach it.\n"
+        "Folders that can't be read are skipped and listed on stderr; network errors are\n"
+        "retried a few times first.\n"
+        "\n"
+        "Options:\n"
+        "  --format=jsonl|csv   output format (default: jsonl)\n"
+        "  --output=FILE        write to FILE instead of stdout\n";
+    PrintScanArgumentsUsage(std::cerr);
+    std::cerr <<
+        "  --serial             single-threaded walk per root; each root's output comes in directory order\n"
+        "  --timings            print each root's scan time and project count to stderr\n"
+        "  --trace=FILE         record the scan and write it to FILE as a Chrome trace (chrome://tracing)\n"
+        "  --service[=SOCKET]   list what a running ProjectNavigatorDaemon has found instead of\n"
+        "                       scanning (default socket: " << DefaultScanServicePath() << ");\n"
+        "                       roots, if given, keep only the projects under them\n"
+        "  --query=TEXT         with --service, only the projects matching TEXT, best match first\n"
+        "  --analyze            instead of listing projects, report likely duplicates (with the space\n"
+        "                       deleting all but the newest copy frees) and stale projects\n"
+        "  --stale-months=N     with --analyze, stale means nothing inside changed for N months (default: 12)\n"
+        "  --similarity=PCT     with --analyze, how alike asset manifests must be for duplicates (default: 80)\n"
+        "  --index=BASE         with --analyze, keep scan indexes and fingerprints in files named after\n"
+        "                       BASE, so a re-run only re-reads what changed\n"
+        "  --analysis-cache=FILE  with --analyze, where to keep fingerprints (default: BASE.analysis)\n"
+        "  --help               show this message\n";
+}
+
+// Returns 0 to continue, or an exit code.
+int ParseArguments(int argc, char** argv, CliOptions& options) {
+    std::string error;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = nullptr;
+        int number = 0;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            PrintUsage(argv[0]);
+            return -1;
+        } else if (OptionValue(arg, "--format=", &value)) {
+            if (strcmp(value, "jsonl") == 0 || strcmp(value, "json") == 0) {
+                options.format = OutputFormat::JsonLines;
+            } else if (strcmp(value, "csv") == 0) {
+                options.format = OutputFormat::Csv;
+            } else {
+                std::cerr << "Unknown format: " << value << "\n";
+                return 2;
+            }
+        } else if (OptionValue(arg, "--output=", &value)) {
+            options.outputPath = value;
+        } else if (strcmp(arg, "--timings") == 0) {
+            options.timings = true;
+        } else if (OptionValue(arg, "--trace=", &value)) {
+            options.tracePath = value;
+        } else if (strcmp(arg, "--serial") == 0) {
+            options.scan.parallel = false;
+        } else if (strcmp(arg, "--service") == 0) {
+            options.servicePath = DefaultScanServicePath();
+        } else if (OptionValue(arg, "--service=", &value)) {
+            options.servicePath = value;
+        } else if (OptionValue(arg, "--query=", &value)) {
+            options.query = value;
+            options.hasQuery = true;
+        } else if (strcmp(arg, "--analyze") == 0) {
+            options.analyze = true;
+        } else if (OptionValue(arg, "--stale-months=", &value)) {
+            if (!ParseCount(value, number)) {
+                std::cerr << "Invalid month count: " << value << "\n";
+                return 2;
+            }
+            options.analysis.staleMonths = number;
+        } else if (OptionValue(arg, "--similarity=", &value)) {
+            if (!ParseCount(value, number) || number > 100) {
+                std::cerr << "Invalid similarity: " << value << "\n";
+                return 2;
+            }
+            options.analysis.similarity = number / 100.0;
+        } else if (OptionValue(arg, "--index=", &value)) {
+            options.indexBase = value;
+        } else if (OptionValue(arg, "--analysis-cache=", &value)) {
+            options.analysisCache = value;
+        } else {
+            ScanArgument parsed = ParseScanArgument(arg, options, error);
+            if (parsed == ScanArgument::Invalid) {
+                std::cerr << error << "\n";
+                return 2;
+            }
+            if (parsed == ScanArgument::Unknown) {
+                std::cerr << "Unknown option: " << arg << "\n";
+                return 2;
+            }
+        }
+    }
+    if (options.hasQuery && options.servicePath.empty()) {
+        std::cerr << "--query needs --service\n";
+        return 2;
+    }
+    if (options.analyze && !options.servicePath.empty()) {
+        std::cerr << "--analyze scans the roots itself and can't be combined with --service\n";
+        return 2;
+    }
+    if (options.analysisCache.empty() && !options.indexBase.empty()) {
+        options.analysisCache = options.indexBase + ".analysis";
+    }
+    options.analysis.threadCount = options.scan.threadCount;
+    if (options.roots.empty() && options.servicePath.empty()) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+    if (!ApplyCustomTypes(options, error)) {
+        std::cerr << error << "\n";
+        return 2;
+    }
+    return 0;
+}
+
+void WriteJsonString(FILE* out, std::string_view text) {
+    fputc('"', out);
+    for (unsigned char c : text) {
+        switch (c) {
+        case '"': fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out); break;
+        case '\r': fputs("\\r", out); break;
+        case '\t': fputs("\\t", out); break;
+        default:
+            if (c < 0x20) {
+                fprintf(out, "\\u%04x", c);
+            } else {
+                fputc(c, out);
+            }
+        }
+    }
+    fputc('"', out);
+}
+
+void WriteCsvField(FILE* out, std::string_view text) {
+    if (text.find_first_of(",\"\r\n") == std::string::npos) {
+        fwrite(text.data(), 1, text.size(), out);
+        return;
+    }
+    fputc('"', out);
+    for (char c : text) {
+        if (c == '"') {
+            fputc('"', out);
+        }
+        fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+void WriteProject(FILE* out, OutputFormat format, const std::string& root, const ProjectInfo& project) {
+    if (format == OutputFormat::JsonLines) {
+        fputs("{\"root\":", out);
+        WriteJsonString(out, root);
+        fputs(",\"type\":", out);
+        WriteJsonString(out, ProjectTypeName(project.type));
+        fputs(",\"name\":", out);
+        WriteJsonString(out, project.name);
+        fputs(",\"path\":", out);
+        WriteJsonString(out, project.path);
+        fputs("}\n", out);
+    } else {
+        WriteCsvField(out, root);
+        fputc(',', out);
+        WriteCsvField(out, ProjectTypeName(project.type));
+        fputc(',', out);
+        WriteCsvField(out, project.name);
+        fputc(',', out);
+        WriteCsvField(out, project.path);
+        fputc('\n', out);
+    }
+}
+
+// The longest of roots that path is at or below, or null.
+const std::string* RootOf(const std::string& path, const std::vector<std::string>& roots) {
+    const std::string* best = nullptr;
+    for (const std::string& root : roots) {
+        if ((!best || root.size() > best->size()) && IsSameOrUnder(path, root)) {
+            best = &root;
+        }
+    }
+    return best;
+}
+
+// Writes the service's list, or its matches for the query, instead of scanning.
+// The service's own project types replace any --type.
+int ListFromService(const CliOptions& options, FILE* out) {
+    ScanServiceClient client;
+    std::string error;
+    if (!client.Connect(options.servicePath, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    std::vector<ProjectInfo> projects;
+    if (options.hasQuery) {
+        if (!client.Query(options.query, 0, projects, error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+    } else {
+        ProjectStore store;
+        bool replaced = false;
+        client.Drain(store, replaced);
+        projects.reserve(store.Size());
+        for (size_t i = 0; i < store.Size(); ++i) {
+            projects.push_back(store.Get(i));
+        }
+    }
+    std::vector<std::string> roots;
+    for (const ScanRoot& root : options.roots) {
+        roots.push_back(root.path);
+    }
+    std::vector<std::string> serviceRoots = client.Roots();
+    for (const ProjectInfo& project : projects) {
+        const std::string* root = RootOf(project.path, roots.empty() ? serviceRoots : roots);
+        if (root) {
+            WriteProject(out, options.format, *root, project);
+        } else if (roots.empty()) {
+            WriteProject(out, options.format, std::string(), project);
+        }
+    }
+    ScanServiceStatus status = client.Status();
+    if (options.timings) {
+        fprintf(stderr, "service: %s, %llu projects\n", status.scanning ? "scanning" : "idle",
+            (unsigned long long)projects.size());
+    }
+    if (!status.error.empty()) {
+        std::cerr << "The service's last scan failed: " << status.error << "\n";
+    }
+    return 0;
+}
+
+void WriteAnalyzedProject(FILE* out, OutputFormat format, const char* kind, size_t group, const AnalyzedProject& project) {
+    std::string name = std::filesystem::path(project.path).filename().string();
+    if (format == OutputFormat::JsonLines) {
+        fputs("{\"type\":", out);
+        WriteJsonString(out, ProjectTypeName(project.type));
+        fputs(",\"name\":", out);
+        WriteJsonString(out, name);
+        fputs(",\"path\":", out);
+        WriteJsonString(out, project.path);
+        fprintf(out, ",\"allocated\":%llu,\"modified\":%lld}", (unsigned long long)project.size.allocatedBytes,
+            (long long)project.size.modified);
+    } else {
+        fprintf(out, "%s,%zu,", kind, group);
+        WriteCsvField(out, ProjectTypeName(project.type));
+        fputc(',', out);
+        WriteCsvField(out, name);
+        fputc(',', out);
+        WriteCsvField(out, project.path);
+        fprintf(out, ",%llu,%lld\n", (unsigned long long)project.size.allocatedBytes, (long long)project.size.modified);
+    }
+}
+
+// Scans the roots with a ScanEngine (incrementally, given --index), then writes
+// one record per duplicate group and per stale project.
+int AnalyzeRoots(const CliOptions& options, FILE* out) {
+    ScanEngine engine;
+    std::mutex mutex;
+    std::condition_variable wake;
+    engine.SetResultsCallback([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_one();
+    });
+    std::vector<std::string> rootPaths;
+    for (const ScanRoot& root : options.roots) {
+        rootPaths.push_back(root.path);
+    }
+    if (!options.indexBase.empty()) {
+        engine.LoadIndexes(options.indexBase, rootPaths);
+    }
+    engine.Start(options.roots, options.scan);
+    ProjectStore found; // only drained to keep the queue short; the indexes have everything
+    ScanEngine::Finished finished;
+    while (true) {
+        engine.Drain(found);
+        if (engine.PollFinished(finished)) {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait_for(lock, std::chrono::milliseconds(100));
+    }
+
+    int exitCode = 0;
+    for (const ScanFailure& failure : finished.failures) {
+        std::cerr << "Skipped " << failure.path << ": " << failure.message << "\n";
+    }
+    if (!finished.error.empty()) {
+        std::cerr << "Error scanning " << finished.error << "\n";
+        exitCode = 1;
+    }
+    // A root that failed has no index and is left out
+    std::vector<std::shared_ptr<const ScanIndex>> indexes;
+    for (size_t i = 0; i < rootPaths.size() && i < finished.roots.size(); ++i) {
+        if (finished.roots[i].error.empty()) {
+            indexes.push_back(engine.Index(rootPaths[i]));
+        }
+    }
+
+    ProjectAnalyzer analyzer;
+    if (!options.analysisCache.empty()) {
+        analyzer.LoadCache(options.analysisCache);
+    }
+    std::atomic<bool> cancel{false};
+    AnalysisReport report;
+    analyzer.Analyze(indexes, options.analysis, cancel, report);
+    if (!options.analysisCache.empty() && !analyzer.SaveCache()) {
+        std::cerr << "Cannot write " << options.analysisCache << "\n";
+        exitCode = 1;
+    }
+
+    if (options.format == OutputFormat::Csv) {
+        fputs("kind,group,type,name,path,allocated,modified\n", out);
+    }
+    for (size_t g = 0; g < report.duplicates.size(); ++g) {
+        const DuplicateGroup& group = report.duplicates[g];
+        if (options.format == OutputFormat::JsonLines) {
+            fprintf(out, "{\"kind\":\"duplicates\",\"identical\":%s,\"reclaimable\":%llu,\"projects\":[",
+                group.identical ? "true" : "false", (unsigned long long)group.reclaimableBytes);
+        }
+        for (size_t i = 0; i < group.projects.size(); ++i) {
+            if (options.format == OutputFormat::JsonLines && i > 0) {
+                fputc(',', out);
+            }
+            WriteAnalyzedProject(out, options.format, "duplicate", g + 1, report.projects[group.projects[i]]);
+        }
+        if (options.format == OutputFormat::JsonLines) {
+            fputs("]}\n", out);
+        }
+    }
+    for (size_t index : report.stale) {
+        if (options.format == OutputFormat::JsonLines) {
+            fputs("{\"kind\":\"stale\",\"project\":", out);
+            WriteAnalyzedProject(out, options.format, "stale", 0, report.projects[index]);
+            fputs("}\n", out);
+        } else {
+            WriteAnalyzedProject(out, options.format, "stale", 0, report.projects[index]);
+        }
+    }
+    if (options.timings) {
+        uint64_t reclaimable = 0;
+        for (const DuplicateGroup& group : report.duplicates) {
+            reclaimable += group.reclaimableBytes;
+        }
+        fprintf(stderr, "%zu projects: %zu fingerprinted, %zu measured, the rest from the cache\n",
+            report.projects.size(), report.fingerprinted, report.measured);
+        fprintf(stderr, "%zu duplicate groups, %llu bytes reclaimable; %zu stale projects, %llu bytes\n",
+            report.duplicates.size(), (unsigned long long)reclaimable, report.stale.size(),
+            (unsigned long long)report.staleBytes);
+    }
+    return exitCode;
+}
+
+}
+
+int main(int argc, char** argv) {
+    CliOptions options;
+    int parsed = ParseArguments(argc, argv, options);
+    if (parsed != 0) {
+        return parsed < 0 ? 0 : parsed;
+    }
+
+    FILE* out = stdout;
+    if (!options.outputPath.empty()) {
+        out = fopen(options.outputPath.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Cannot open " << options.outputPath << ": " << strerror(errno) << "\n";
+            return 1;
+        }
+    }
+    if (options.format == OutputFormat::Csv && !options.analyze) {
+        fputs("root,type,name,path\n", out);
+    }
+
+    if (!options.servicePath.empty() || options.analyze) {
+        int exitCode = options.analyze ? AnalyzeRoots(options, out) : ListFromService(options, out);
+        fflush(out);
+        if (out != stdout) {
+            fclose(out);
+        }
+        return exitCode;
+    }
+
+    int exitCode = 0;
+    std::mutex outputMutex;
+    std::atomic<bool> cancel{false};
+    ScanCounters counters;
+    ScanErrorLog errors;
+    options.scan.errors = &errors;
+    if (!options.tracePath.empty()) {
+        SetTracing(true);
+        SampleTraceCounters();
+    }
+    std::vector<ScanOptions> rootOptions(options.roots.size(), options.scan);
+    // Each project is written as soon as it is found; nothing is buffered
+    std::vector<RootScanResult> results = WalkRoots(options.roots, rootOptions, counters, cancel,
+        [&](size_t root, ProjectInfo&& project, const ScanOrderKey&) {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            WriteProject(out, options.format, options.roots[root].path, project);
+        });
+    fflush(out);
+    if (!options.tracePath.empty()) {
+        SampleTraceCounters();
+        std::string error;
+        if (!WriteChromeTrace(options.tracePath, error)) {
+            std::cerr << error << "\n";
+            exitCode = 1;
+        }
+    }
+    for (const ScanFailure& failure : errors.Failures()) {
+        std::cerr << "Skipped " << failure.path << ": " << failure.message;
+        if (failure.attempts > 1) {
+            std::cerr << " (" << failure.attempts << " attempts)";
+        }
+        std::cerr << "\n";
+    }
+    if (errors.Count() > ScanErrorLog::kMaxKept) {
+        std::cerr << "... and " << errors.Count() - ScanErrorLog::kMaxKept << " more folders skipped\n";
+    }
+    if (options.timings) {
+        fprintf(stderr, "backend: %s\n", ScanBackendName(EffectiveScanBackend(options.scan)));
+    }
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (!results[i].error.empty()) {
+            std::cerr << "Error scanning " << options.roots[i].path << ": " << results[i].error << "\n";
+            exitCode = 1;
+        }
+        if (options.timings) {
+            fprintf(stderr, "%s: %llu projects in %.3f s\n", options.roots[i].path.c_str(),
+                (unsigned long long)results[i].projects, results[i].seconds);
+        }
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return exitCode;
+}
@@ -0,0 +1,122 @@
+// Scan service: scans a workspace once, keeps it current with file-system
+// watches, and serves the project list to every GUI and CLI instance that
+// connects to its socket (see ScanService.h), so they don't each walk and watch
+// the same roots. Runs until SIGINT or SIGTERM.
+
+#include "ScanArguments.h"
+#include "ScanService.h"
+
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+namespace {
+
+struct DaemonOptions : ScanArguments {
+    std::string socketPath;
+    std::string indexBase; // empty = next to the socket
+    bool noIndex = false;
+    bool shared = false;
+};
+
+void PrintUsage(const char* program) {
+    std::cerr <<
+        "Usage: " << program << " [options] <root> [<root>...]\n"
+        "\n"
+        "Scans the roots for projects, watches them for changes and serves the list over a\n"
+        "Unix domain socket. ProjectNavigator and ProjectNavigatorCli --service connect to it\n"
+        "instead of scanning themselves. Runs until interrupted.\n"
+        "\n"
+        "Options:\n"
+        "  --socket=PATH        socket to listen on (default: $PROJECTNAVIGATOR_SOCKET, or\n"
+        "                       " << DefaultScanServicePath() << ")\n"
+        "  --shared             let every user on the machine connect, not just this one; use a\n"
+        "                       --socket they can reach. Clients only trust a service run by root\n"
+        "                       or by themselves\n"
+        "  --index=BASE         keep scan indexes in files named after BASE (default: the socket\n"
+        "                       path plus .index); the last list is served while the first scan runs\n"
+        "  --no-index           don't load or save scan indexes\n";
+    PrintScanArgumentsUsage(std::cerr);
+    std::cerr <<
+        "  --help               show this message\n";
+}
+
+// Returns 0 to continue, or an exit code.
+int ParseArguments(int argc, char** argv, DaemonOptions& options) {
+    options.socketPath = DefaultScanServicePath();
+    std::string error;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = nullptr;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            PrintUsage(argv[0]);
+            return -1;
+        } else if (OptionValue(arg, "--socket=", &value)) {
+            options.socketPath = value;
+        } else if (strcmp(arg, "--shared") == 0) {
+            options.shared = true;
+        } else if (OptionValue(arg, "--index=", &value)) {
+            options.indexBase = value;
+        } else if (strcmp(arg, "--no-index") == 0) {
+            options.noIndex = true;
+        } else {
+            ScanArgument parsed = ParseScanArgument(arg, options, error);
+            if (parsed == ScanArgument::Invalid) {
+                std::cerr << error << "\n";
+                return 2;
+            }
+            if (parsed == ScanArgument::Unknown) {
+                std::cerr << "Unknown option: " << arg << "\n";
+                return 2;
+            }
+        }
+    }
+    if (options.roots.empty()) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+    if (options.noIndex) {
+        options.indexBase.clear();
+    } else if (options.indexBase.empty()) {
+        options.indexBase = options.socketPath + ".index";
+    }
+    if (!ApplyCustomTypes(options, error)) {
+        std::cerr << error << "\n";
+        return 2;
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    DaemonOptions options;
+    int parsed = ParseArguments(argc, argv, options);
+    if (parsed != 0) {
+        return parsed < 0 ? 0 : parsed;
+    }
+
+    // Blocked before any thread starts so that all of them inherit it and the
+    // signals wait for sigwait below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    ScanService service;
+    std::string error;
+    if (!service.Start(options.socketPath, options.roots, options.scan, options.indexBase, options.shared, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    std::cerr << "Serving " << options.roots.size() << " root(s) on " << options.socketPath << "\n";
+    int received = 0;
+    sigwait(&signals, &received);
+    service.Stop();
+    return 0;
+}
@@ -9,6 +9,24 @@
 #include <fstream>
 #include <map>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cstdlib>
+#include <ctime>
+#include <future>
+#include <new>
+#include "ConfigStore.h"
+#include "ProjectInfo.h"
+#include "ProjectLauncher.h"
+#include "ProjectMetadata.h"
+#include "ProjectSearch.h"
+#include "ProjectStore.h"
+#include "ProjectTypes.h"
+#include "ProjectWatcher.h"
+#include "ScanEngine.h"
+#include "ScanService.h"
+#include "Trace.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -23,73 +41,176 @@ static bool g_draggingWindow = false;
 static ImVec2 g_clickOffset;
 #endif
 
-struct ProjectInfo {
-    std::string name;
+// Set by the window position and size callbacks; the main loop saves the new geometry
+static bool g_windowGeometryChanged = false;
+
+// Heap allocations made by each thread while the frame budget monitor is on.
+// ImGui's are counted through its allocator hooks. Everything else is only
+// counted in builds with PROJECTNAVIGATOR_ALLOC_COUNTING, which replaces global
+// operator new for the whole process.
+static std::atomic<bool> g_countAllocations{false};
+static thread_local uint64_t t_allocations = 0;
+
+static void* CountedAllocate(size_t size) {
+    if (g_countAllocations.load(std::memory_order_relaxed)) {
+        ++t_allocations;
+    }
+    return malloc(size ? size : 1);
+}
+
+static void* CountedImGuiAllocate(size_t size, void*) {
+    return CountedAllocate(size);
+}
+
+static void ImGuiFree(void* block, void*) {
+    free(block);
+}
+
+static uint64_t ThreadAllocations() { return t_allocations; }
+
+#ifdef PROJECTNAVIGATOR_ALLOC_COUNTING
+void* operator new(size_t size) {
+    // As the standard one: call the new-handler until it gives up
+    for (;;) {
+        if (void* block = CountedAllocate(size)) {
+            return block;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* block) noexcept { free(block); }
+void operator delete[](void* block) noexcept { free(block); }
+void operator delete(void* block, size_t) noexcept { free(block); }
+void operator delete[](void* block, size_t) noexcept { free(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { free(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { free(block); }
+#endif
+
+// An editor executable for one engine version, or for every version without its own entry.
+struct EditorSetting {
+    ProjectType engine = ProjectType::Unity;
+    std::string version; // empty = any version
     std::string path;
-    std::string type; // "Unity" or "Unreal"
 };
 
+// Every persisted setting as X(type, name, default). UISettings and its config
+// store keys are both generated from this table, so adding a setting here is all
+// it takes to have it saved and restored.
+#define UI_SETTINGS_FIELDS(X) \
+    /* Colors (schema 3 on; see ResetUnappliedColors) */ \
+    X(ImVec4, windowBgColor, (ImVec4(0.13f, 0.14f, 0.17f, 1.0f))) \
+    X(ImVec4, panelColor, (ImVec4(0.16f, 0.17f, 0.20f, 1.0f))) \
+    X(ImVec4, borderColor, (ImVec4(0.22f, 0.23f, 0.29f, 1.0f))) \
+    X(ImVec4, accentColor, (ImVec4(0.20f, 0.55f, 0.90f, 1.0f))) \
+    X(ImVec4, headerColor, (ImVec4(0.20f, 0.55f, 0.90f, 1.0f))) \
+    X(ImVec4, unityProjectColor, (ImVec4(0.2f, 0.4f, 0.8f, 1.0f))) \
+    X(ImVec4, unrealProjectColor, (ImVec4(0.8f, 0.2f, 0.2f, 1.0f))) \
+    X(ImVec4, buttonColor, (ImVec4(0.20f, 0.55f, 0.90f, 1.0f))) \
+    X(ImVec4, buttonHoverColor, (ImVec4(0.25f, 0.60f, 1.00f, 1.0f))) \
+    X(ImVec4, buttonActiveColor, (ImVec4(0.18f, 0.48f, 0.80f, 1.0f))) \
+    X(ImVec4, textColor, (ImVec4(0.95f, 0.96f, 0.98f, 1.0f))) \
+    X(ImVec4, errorColor, (ImVec4(1.0f, 0.0f, 0.0f, 1.0f))) \
+    X(ImVec4, warningColor, (ImVec4(1.0f, 0.8f, 0.2f, 1.0f))) \
+    X(ImVec4, runningColor, (ImVec4(0.3f, 0.8f, 0.3f, 1.0f))) \
+    X(ImVec4, closeButtonColor, (ImVec4(0.9f, 0.2f, 0.2f, 1.0f))) \
+    X(ImVec4, titleButtonHoverColor, (ImVec4(0.2f, 0.2f, 0.2f, 0.5f))) \
+    X(ImVec4, titleButtonActiveColor, (ImVec4(0.3f, 0.3f, 0.3f, 0.7f))) \
+    /* Layout */ \
+    X(float, windowPadding, 10.0f) \
+    X(float, itemSpacing, 8.0f) \
+    X(float, columnWidth, 0.5f) \
+    X(float, projectListHeight, 400.0f) \
+    X(bool, showProjectType, true) \
+    X(bool, showProjectPath, false) \
+    X(bool, useCompactMode, false) \
+    /* Window */ \
+    X(bool, alwaysOnTop, false) \
+    X(bool, rememberWindowPosition, true) \
+    X(bool, rememberWindowSize, true) \
+    X(ImVec2, windowSize, (ImVec2(1280, 720))) \
+    X(ImVec2, windowPosition, (ImVec2(0, 0))) \
+    /* Behavior */ \
+    X(bool, autoScanOnStart, true) \
+    X(bool, showHiddenFiles, false) \
+    X(bool, sortProjectsByName, true) \
+    X(bool, groupByType, true) \
+    X(int, scanDepth, 5) \
+    X(bool, showScanProgress, true) \
+    X(bool, parallelScan, true) \
+    X(int, scanThreads, 0) /* 0 = one per hardware thread */ \
+    X(int, scanBackend, 0) /* ScanBackend; io_uring falls back to portable where unavailable */ \
+    X(std::string, skipDirectories, kDefaultSkipDirectories) /* comma-separated folder names */ \
+    X(bool, useScanService, false) /* list projects from ProjectNavigatorDaemon instead of scanning */ \
+    X(std::string, scanServicePath, "") /* its socket; empty = DefaultScanServicePath() */ \
+    /* Debugging */ \
+    X(bool, frameBudgetMonitor, false) /* count allocations per frame and warn about slow frames */ \
+    X(float, frameBudgetMs, 8.0f) /* frame CPU time above which the monitor warns */ \
+    /* Editors, on top of the Unity Hub and Epic launcher install locations */ \
+    X(std::vector<EditorSetting>, editors, {}) \
+    /* Project types on top of the built-in ones, as ParseProjectTypeSpec reads them */ \
+    X(std::vector<std::string>, customProjectTypes, {})
+
 struct UISettings {
-    // Colors
-    ImVec4 windowBgColor = ImVec4(0.1f, 0.1f, 0.1f, 1.0f);
-    ImVec4 headerColor = ImVec4(0.2f, 0.2f, 0.2f, 1.0f);
-    ImVec4 unityProjectColor = ImVec4(0.2f, 0.4f, 0.8f, 1.0f);
-    ImVec4 unrealProjectColor = ImVec4(0.8f, 0.2f, 0.2f, 1.0f);
-    ImVec4 buttonColor = ImVec4(0.3f, 0.3f, 0.3f, 1.0f);
-    ImVec4 buttonHoverColor = ImVec4(0.4f, 0.4f, 0.4f, 1.0f);
-    ImVec4 buttonActiveColor = ImVec4(0.5f, 0.5f, 0.5f, 1.0f);
-    ImVec4 textColor = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
-
-    // Layout
-    float windowPadding = 10.0f;
-    float itemSpacing = 8.0f;
-    float columnWidth = 0.5f;
-    float projectListHeight = 400.0f;
-    bool showProjectType = true;
-    bool showProjectPath = false;
-    bool useCompactMode = false;
-
-    // Window
-    bool alwaysOnTop = false;
-    bool rememberWindowPosition = true;
-    bool rememberWindowSize = true;
-    ImVec2 windowSize = ImVec2(1280, 720);
-    ImVec2 windowPosition = ImVec2(0, 0);
-
-    // Behavior
-    bool autoScanOnStart = true;
-    bool showHiddenFiles = false;
-    bool sortProjectsByName = true;
-    bool groupByType = true;
-    int scanDepth = 5;
-    bool showScanProgress = true;
+#define X(type, name, init) type name = init;
+    UI_SETTINGS_FIELDS(X)
+#undef X
 };
 
-std::vector<ProjectInfo> ScanForProjects(const std::string& root) {
-    std::vector<ProjectInfo> projects;
-    try {
-        for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
-            if (entry.is_directory()) {
-                // Unity: has Assets and ProjectSettings
-                bool hasAssets = std::filesystem::exists(entry.path() / "Assets");
-                bool hasSettings = std::filesystem::exists(entry.path() / "ProjectSettings");
-                if (hasAssets && hasSettings) {
-                    projects.push_back({ entry.path().filename().string(), entry.path().string(), "Unity" });
-                    continue;
-                }
-                // Unreal: has .uproject file
-                for (const auto& file : std::filesystem::directory_iterator(entry.path())) {
-                    if (file.path().extension() == ".uproject") {
-                        projects.push_back({ entry.path().filename().string(), entry.path().string(), "Unreal" });
-                        break;
-                    }
-                }
-            }
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Error scanning: " << e.what() << std::endl;
+// Where the user left off, restored at the next start. Saved along with the settings.
+#define APP_STATE_FIELDS(X) \
+    X(std::vector<ScanRoot>, roots, {}) \
+    X(std::vector<std::string>, recentRoots, {}) /* most recent first */ \
+    X(bool, windowPlaced, false) /* settings.windowPosition came from a real window */ \
+    X(std::string, filter, "") \
+    X(bool, showSettings, false) \
+    X(bool, showStats, false)
+
+struct AppState {
+#define X(type, name, init) type name = init;
+    APP_STATE_FIELDS(X)
+#undef X
+};
+
+constexpr size_t kMaxRecentRoots = 10;
+
+EditorPaths ToEditorPaths(const UISettings& settings) {
+    EditorPaths paths;
+    for (const EditorSetting& editor : settings.editors) {
+        (editor.engine == ProjectType::Unreal ? paths.unreal : paths.unity)[editor.version] = editor.path;
+    }
+    return paths;
+}
+
+// The built-in project types followed by the custom ones in settings. A spec
+// that doesn't parse is left out; the Project Types tab shows why.
+ProjectTypeRegistry ToProjectTypes(const UISettings& settings) {
+    ProjectTypeRegistry types = ProjectTypeRegistry::BuiltIn();
+    for (const std::string& spec : settings.customProjectTypes) {
+        std::string error;
+        types.AddCustom(spec, error);
     }
-    return projects;
+    return types;
 }
 
 std::string GetConfigPath() {
@@ -112,115 +233,250 @@ std::string GetConfigPath() {
     return configPath;
 }
 
-std::string LoadLastDirectory() {
-    std::string configPath = GetConfigPath();
-    if (std::filesystem::exists(configPath)) {
-        std::ifstream file(configPath);
-        if (file.is_open()) {
-            std::string line;
-            if (std::getline(file, line)) {
-                return line;
-            }
-        }
-    }
-    return "C:\\"; // Default directory
-}
-
-void SaveLastDirectory(const std::string& directory) {
-    std::string configPath = GetConfigPath();
-    std::ofstream file(configPath);
-    if (file.is_open()) {
-        file << directory;
-    }
-}
-
-void SaveSettings(const UISettings& settings) {
-    std::string configPath = GetConfigPath();
-    std::ofstream file(configPath + ".settings");
-    if (file.is_open()) {
-        // Save all settings
-        file << "windowBgColor " << settings.windowBgColor.x << " " << settings.windowBgColor.y << " " << settings.windowBgColor.z << " " << settings.windowBgColor.w << "\n";
-        file << "headerColor " << settings.headerColor.x << " " << settings.headerColor.y << " " << settings.headerColor.z << " " << settings.headerColor.w << "\n";
-        file << "unityProjectColor " << settings.unityProjectColor.x << " " << settings.unityProjectColor.y << " " << settings.unityProjectColor.z << " " << settings.unityProjectColor.w << "\n";
-        file << "unrealProjectColor " << settings.unrealProjectColor.x << " " << settings.unrealProjectColor.y << " " << settings.unrealProjectColor.z << " " << settings.unrealProjectColor.w << "\n";
-        file << "buttonColor " << settings.buttonColor.x << " " << settings.buttonColor.y << " " << settings.buttonColor.z << " " << settings.buttonColor.w << "\n";
-        file << "buttonHoverColor " << settings.buttonHoverColor.x << " " << settings.buttonHoverColor.y << " " << settings.buttonHoverColor.z << " " << settings.buttonHoverColor.w << "\n";
-        file << "buttonActiveColor " << settings.buttonActiveColor.x << " " << settings.buttonActiveColor.y << " " << settings.buttonActiveColor.z << " " << settings.buttonActiveColor.w << "\n";
-        file << "textColor " << settings.textColor.x << " " << settings.textColor.y << " " << settings.textColor.z << " " << settings.textColor.w << "\n";
-        file << "windowPadding " << settings.windowPadding << "\n";
-        file << "itemSpacing " << settings.itemSpacing << "\n";
-        file << "columnWidth " << settings.columnWidth << "\n";
-        file << "projectListHeight " << settings.projectListHeight << "\n";
-        file << "showProjectType " << settings.showProjectType << "\n";
-        file << "showProjectPath " << settings.showProjectPath << "\n";
-        file << "useCompactMode " << settings.useCompactMode << "\n";
-        file << "alwaysOnTop " << settings.alwaysOnTop << "\n";
-        file << "rememberWindowPosition " << settings.rememberWindowPosition << "\n";
-        file << "rememberWindowSize " << settings.rememberWindowSize << "\n";
-        file << "windowSize " << settings.windowSize.x << " " << settings.windowSize.y << "\n";
-        file << "windowPosition " << settings.windowPosition.x << " " << settings.windowPosition.y << "\n";
-        file << "autoScanOnStart " << settings.autoScanOnStart << "\n";
-        file << "showHiddenFiles " << settings.showHiddenFiles << "\n";
-        file << "sortProjectsByName " << settings.sortProjectsByName << "\n";
-        file << "groupByType " << settings.groupByType << "\n";
-        file << "scanDepth " << settings.scanDepth << "\n";
-        file << "showScanProgress " << settings.showScanProgress << "\n";
-    }
-}
-
-UISettings LoadSettings() {
+// Config store encodings of the types used in the field tables
+void EncodeConfigValue(std::string& out, const ImVec2& value) {
+    EncodeConfigValue(out, value.x);
+    EncodeConfigValue(out, value.y);
+}
+
+bool DecodeConfigValue(ConfigReader& in, ImVec2& value) {
+    return DecodeConfigValue(in, value.x) && DecodeConfigValue(in, value.y);
+}
+
+void EncodeConfigValue(std::string& out, const ImVec4& value) {
+    EncodeConfigValue(out, value.x);
+    EncodeConfigValue(out, value.y);
+    EncodeConfigValue(out, value.z);
+    EncodeConfigValue(out, value.w);
+}
+
+bool DecodeConfigValue(ConfigReader& in, ImVec4& value) {
+    return DecodeConfigValue(in, value.x) && DecodeConfigValue(in, value.y) &&
+        DecodeConfigValue(in, value.z) && DecodeConfigValue(in, value.w);
+}
+
+void EncodeConfigValue(std::string& out, const EditorSetting& value) {
+    EncodeConfigValue(out, (int)value.engine);
+    EncodeConfigValue(out, value.version);
+    EncodeConfigValue(out, value.path);
+}
+
+bool DecodeConfigValue(ConfigReader& in, EditorSetting& value) {
+    int engine = 0;
+    if (!DecodeConfigValue(in, engine) || !DecodeConfigValue(in, value.version) || !DecodeConfigValue(in, value.path)) {
+        return false;
+    }
+    value.engine = engine == (int)ProjectType::Unreal ? ProjectType::Unreal : ProjectType::Unity;
+    return true;
+}
+
+void EncodeConfigValue(std::string& out, const ScanRoot& value) {
+    EncodeConfigValue(out, value.path);
+    EncodeConfigValue(out, value.threadCount);
+}
+
+bool DecodeConfigValue(ConfigReader& in, ScanRoot& value) {
+    return DecodeConfigValue(in, value.path) && DecodeConfigValue(in, value.threadCount);
+}
+
+// Schema 1 was the text files (config.txt and config.txt.settings); files of
+// that schema are migrated by LoadLegacyConfig. Schema 3 started applying the
+// color settings (see ResetUnappliedColors).
+constexpr uint32_t kConfigSchemaVersion = 3;
+
+// Before schema 3 the color settings were saved but never used: the UI was
+// drawn in built-in colors, which are now their defaults. Saved values are
+// dropped so the UI keeps looking the way it did.
+void ResetUnappliedColors(UISettings& settings) {
+    const UISettings defaults;
+    settings.windowBgColor = defaults.windowBgColor;
+    settings.headerColor = defaults.headerColor;
+    settings.unityProjectColor = defaults.unityProjectColor;
+    settings.unrealProjectColor = defaults.unrealProjectColor;
+    settings.buttonColor = defaults.buttonColor;
+    settings.buttonHoverColor = defaults.buttonHoverColor;
+    settings.buttonActiveColor = defaults.buttonActiveColor;
+    settings.textColor = defaults.textColor;
+}
+
+std::string EncodeConfig(const UISettings& settings, const AppState& state) {
+    ConfigEncoder encoder;
+#define X(type, name, init) encoder.Put("settings." #name, settings.name);
+    UI_SETTINGS_FIELDS(X)
+#undef X
+#define X(type, name, init) encoder.Put("state." #name, state.name);
+    APP_STATE_FIELDS(X)
+#undef X
+    return encoder.Finish(kConfigSchemaVersion);
+}
+
+// Values in config.txt.settings, one "key value..." line per setting
+void ReadLegacyValue(std::istream& in, bool& value) { in >> value; }
+void ReadLegacyValue(std::istream& in, int& value) { in >> value; }
+void ReadLegacyValue(std::istream& in, float& value) { in >> value; }
+void ReadLegacyValue(std::istream& in, ImVec2& value) { in >> value.x >> value.y; }
+void ReadLegacyValue(std::istream& in, ImVec4& value) { in >> value.x >> value.y >> value.z >> value.w; }
+void ReadLegacyValue(std::istream& in, std::string& value) { std::getline(in >> std::ws, value); }
+// Lists repeat their key, one entry per line
+void ReadLegacyValue(std::istream& in, std::vector<std::string>& values) {
+    values.emplace_back();
+    std::getline(in >> std::ws, values.back());
+}
+
+// One "editor <engine> <version|*> <path>" line per editor
+void ReadLegacyValue(std::istream& in, std::vector<EditorSetting>& editors) {
+    EditorSetting editor;
+    std::string engine;
+    in >> engine >> editor.version;
+    std::getline(in >> std::ws, editor.path);
+    editor.engine = engine == "Unreal" ? ProjectType::Unreal : ProjectType::Unity;
+    if (editor.version == "*") {
+        editor.version.clear();
+    }
+    editors.push_back(editor);
+}
+
+// Reads the text files earlier versions wrote. Returns false if there are none.
+bool LoadLegacyConfig(const std::string& configPath, UISettings& settings, AppState& state) {
+    bool found = false;
+    std::ifstream settingsFile(configPath + ".settings");
+    std::string line;
+    while (std::getline(settingsFile, line)) {
+        found = true;
+        std::istringstream iss(line);
+        std::string key;
+        iss >> key;
+        if (key == "editor") {
+            key = "editors"; // written one line per editor
+        }
+#define X(type, name, init) if (key == #name) { ReadLegacyValue(iss, settings.name); continue; }
+        UI_SETTINGS_FIELDS(X)
+#undef X
+    }
+
+    // One root per line, optionally followed by a tab and its thread limit. A file
+    // from before workspaces holds a single path, which reads the same way.
+    std::ifstream workspaceFile(configPath);
+    while (std::getline(workspaceFile, line)) {
+        found = true;
+        ScanRoot root;
+        size_t tab = line.find('\t');
+        root.path = line.substr(0, tab);
+        if (tab != std::string::npos) {
+            root.threadCount = (unsigned)std::max(0, atoi(line.c_str() + tab + 1));
+        }
+        if (!root.path.empty()) {
+            state.roots.push_back(root);
+        }
+    }
+    return found;
+}
+
+struct LoadedConfig {
+    std::string configPath;
     UISettings settings;
-    std::string configPath = GetConfigPath();
-    std::ifstream file(configPath + ".settings");
-    if (file.is_open()) {
-        std::string line;
-        while (std::getline(file, line)) {
-            std::istringstream iss(line);
-            std::string key;
-            iss >> key;
-            
-            if (key == "windowBgColor") iss >> settings.windowBgColor.x >> settings.windowBgColor.y >> settings.windowBgColor.z >> settings.windowBgColor.w;
-            else if (key == "headerColor") iss >> settings.headerColor.x >> settings.headerColor.y >> settings.headerColor.z >> settings.headerColor.w;
-            else if (key == "unityProjectColor") iss >> settings.unityProjectColor.x >> settings.unityProjectColor.y >> settings.unityProjectColor.z >> settings.unityProjectColor.w;
-            else if (key == "unrealProjectColor") iss >> settings.unrealProjectColor.x >> settings.unrealProjectColor.y >> settings.unrealProjectColor.z >> settings.unrealProjectColor.w;
-            else if (key == "buttonColor") iss >> settings.buttonColor.x >> settings.buttonColor.y >> settings.buttonColor.z >> settings.buttonColor.w;
-            else if (key == "buttonHoverColor") iss >> settings.buttonHoverColor.x >> settings.buttonHoverColor.y >> settings.buttonHoverColor.z >> settings.buttonHoverColor.w;
-            else if (key == "buttonActiveColor") iss >> settings.buttonActiveColor.x >> settings.buttonActiveColor.y >> settings.buttonActiveColor.z >> settings.buttonActiveColor.w;
-            else if (key == "textColor") iss >> settings.textColor.x >> settings.textColor.y >> settings.textColor.z >> settings.textColor.w;
-            else if (key == "windowPadding") iss >> settings.windowPadding;
-            else if (key == "itemSpacing") iss >> settings.itemSpacing;
-            else if (key == "columnWidth") iss >> settings.columnWidth;
-            else if (key == "projectListHeight") iss >> settings.projectListHeight;
-            else if (key == "showProjectType") iss >> settings.showProjectType;
-            else if (key == "showProjectPath") iss >> settings.showProjectPath;
-            else if (key == "useCompactMode") iss >> settings.useCompactMode;
-            else if (key == "alwaysOnTop") iss >> settings.alwaysOnTop;
-            else if (key == "rememberWindowPosition") iss >> settings.rememberWindowPosition;
-            else if (key == "rememberWindowSize") iss >> settings.rememberWindowSize;
-            else if (key == "windowSize") iss >> settings.windowSize.x >> settings.windowSize.y;
-            else if (key == "windowPosition") iss >> settings.windowPosition.x >> settings.windowPosition.y;
-            else if (key == "autoScanOnStart") iss >> settings.autoScanOnStart;
-            else if (key == "showHiddenFiles") iss >> settings.showHiddenFiles;
-            else if (key == "sortProjectsByName") iss >> settings.sortProjectsByName;
-            else if (key == "groupByType") iss >> settings.groupByType;
-            else if (key == "scanDepth") iss >> settings.scanDepth;
-            else if (key == "showScanProgress") iss >> settings.showScanProgress;
-        }
-    }
-    return settings;
+    AppState state;
+    bool migrated = false; // came from the legacy files and should be written back in the new format
+    bool defaultRoots = false; // no workspace was saved; roots holds the default
+};
+
+// Runs off the UI thread while the window is being set up
+LoadedConfig LoadConfig() {
+    TRACE_SCOPE("LoadConfig");
+    LoadedConfig config;
+    config.configPath = GetConfigPath();
+    if (!config.configPath.empty()) {
+        std::string data;
+        ConfigDecoder decoder;
+        if (ReadWholeFile(config.configPath + ".cfg", data) && decoder.Parse(std::move(data))) {
+            // Keys missing from the file, or of a type it no longer has, keep their defaults
+#define X(type, name, init) decoder.Get("settings." #name, config.settings.name);
+            UI_SETTINGS_FIELDS(X)
+#undef X
+#define X(type, name, init) decoder.Get("state." #name, config.state.name);
+            APP_STATE_FIELDS(X)
+#undef X
+            if (decoder.SchemaVersion() < 3) {
+                ResetUnappliedColors(config.settings);
+                config.migrated = true;
+            }
+        } else {
+            config.migrated = LoadLegacyConfig(config.configPath, config.settings, config.state);
+            ResetUnappliedColors(config.settings);
+        }
+    }
+    if (config.state.roots.empty()) {
+        config.state.roots.push_back({ "C:\\", 0 }); // Default directory
+        config.defaultRoots = true;
+    }
+    return config;
+}
+
+// What the last run left behind, read while the window is being set up so the
+// first frame can show it.
+struct CachedResults {
+    ProjectStore projects;
+    bool indexed = false; // some root had an index, even if it held no projects
+    int64_t startMicros = 0;
+    int64_t micros = 0;
+};
+
+// Runs off the UI thread. Loads the indexes of the last completed scan into
+// engine and the metadata cache into metadata; both are only touched by the UI
+// thread once this has returned.
+CachedResults LoadCachedResults(ScanEngine& engine, MetadataPipeline& metadata, const std::string& configPath,
+    const std::vector<ScanRoot>& roots) {
+    TRACE_SCOPE("LoadCachedResults");
+    CachedResults cached;
+    cached.startMicros = TraceNowMicros();
+    if (!configPath.empty()) {
+        std::vector<std::string> rootPaths;
+        for (const ScanRoot& root : roots) {
+            rootPaths.push_back(root.path);
+        }
+        cached.indexed = engine.LoadIndexes(configPath + ".index", rootPaths) > 0;
+        for (const std::string& root : rootPaths) {
+            if (std::shared_ptr<const ScanIndex> index = engine.Index(root)) {
+                ProjectStore indexed = index->Projects();
+                for (size_t i = 0; i < indexed.Size(); ++i) {
+                    cached.projects.Add(indexed.Path(i), indexed.Type(i));
+                }
+            }
+        }
+        metadata.LoadCache(configPath + ".metadata");
+    }
+    cached.micros = TraceNowMicros() - cached.startMicros;
+    return cached;
+}
+
+constexpr size_t kStartupReportRuns = 100;
+
+// Adds this start's timings to the report next to the config, one JSON line
+// per start, keeping the most recent kStartupReportRuns.
+void SaveStartupReport(BackgroundWriter& writer, const std::string& path, const StartupTimer& startup) {
+    std::string data;
+    ReadWholeFile(path, data);
+    size_t lines = std::count(data.begin(), data.end(), '\n');
+    size_t start = 0;
+    for (; lines >= kStartupReportRuns; --lines) {
+        start = data.find('\n', start) + 1;
+    }
+    data.erase(0, start);
+    data += startup.ToJson();
+    data += '\n';
+    writer.Save(path, std::move(data));
 }
 
 void ApplySettings(const UISettings& settings) {
     ImGuiStyle& style = ImGui::GetStyle();
     // Modern style: rounded corners, accent color, soft background, larger font
-    ImVec4 accent = ImVec4(0.20f, 0.55f, 0.90f, 1.00f); // blue accent
-    ImVec4 bg = ImVec4(0.13f, 0.14f, 0.17f, 1.00f);
-    ImVec4 panel = ImVec4(0.16f, 0.17f, 0.20f, 1.00f);
-    ImVec4 text = ImVec4(0.95f, 0.96f, 0.98f, 1.00f);
-    ImVec4 border = ImVec4(0.22f, 0.23f, 0.29f, 1.00f);
-    ImVec4 button = accent;
-    ImVec4 buttonHover = ImVec4(0.25f, 0.60f, 1.00f, 1.00f);
-    ImVec4 buttonActive = ImVec4(0.18f, 0.48f, 0.80f, 1.00f);
+    const ImVec4& accent = settings.accentColor;
+    const ImVec4& bg = settings.windowBgColor;
+    const ImVec4& panel = settings.panelColor;
+    const ImVec4& text = settings.textColor;
+    const ImVec4& border = settings.borderColor;
+    const ImVec4& buttonHover = settings.buttonHoverColor;
+    const ImVec4& buttonActive = settings.buttonActiveColor;
 
     style.WindowRounding = 8.0f;
     style.ChildRounding = 8.0f;
@@ -261,10 +517,10 @@ void ApplySettings(const UISettings& settings) {
     colors[ImGuiCol_CheckMark] = accent;
     colors[ImGuiCol_SliderGrab] = accent;
     colors[ImGuiCol_SliderGrabActive] = buttonActive;
-    colors[ImGuiCol_Button] = button;
+    colors[ImGuiCol_Button] = settings.buttonColor;
     colors[ImGuiCol_ButtonHovered] = buttonHover;
     colors[ImGuiCol_ButtonActive] = buttonActive;
-    colors[ImGuiCol_Header] = accent;
+    colors[ImGuiCol_Header] = settings.headerColor;
     colors[ImGuiCol_HeaderHovered] = buttonHover;
     colors[ImGuiCol_HeaderActive] = buttonActive;
     colors[ImGuiCol_Separator] = border;
@@ -293,19 +549,45 @@ void ApplySettings(const UISettings& settings) {
     }
 }
 
-void ShowSettingsWindow(UISettings& settings, bool* p_open) {
+// InputText over a std::string. The buffer is filled from value every frame, so Reset shows up.
+bool InputString(const char* label, const char* hint, std::string& value) {
+    char buffer[512];
+    strncpy(buffer, value.c_str(), sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    if (!ImGui::InputTextWithHint(label, hint, buffer, sizeof(buffer))) {
+        return false;
+    }
+    value = buffer;
+    return true;
+}
+
+// Unity and Unreal have color settings; other types use their registry color.
+ImVec4 ProjectTypeColor(const UISettings& settings, ProjectType type) {
+    if (type == ProjectType::Unity) {
+        return settings.unityProjectColor;
+    }
+    if (type == ProjectType::Unreal) {
+        return settings.unrealProjectColor;
+    }
+    uint32_t rgb = ProjectTypeRgb(type);
+    return ImVec4(((rgb >> 16) & 0xFF) / 255.0f, ((rgb >> 8) & 0xFF) / 255.0f, (rgb & 0xFF) / 255.0f, 1.0f);
+}
+
+// Returns true if the settings were applied this frame; the caller saves them.
+bool ShowSettingsWindow(UISettings& settings, bool* p_open) {
     ImGui::SetNextWindowSize(ImVec2(600, 600), ImGuiCond_FirstUseEver);
     if (!ImGui::Begin("Settings", p_open)) {
         ImGui::End();
-        return;
+        return false;
     }
-
-    // Store original settings for comparison
-    UISettings originalSettings = settings;
+    bool applied = false;
 
     if (ImGui::BeginTabBar("SettingsTabs")) {
         if (ImGui::BeginTabItem("Colors")) {
             ImGui::ColorEdit4("Window Background", (float*)&settings.windowBgColor);
+            ImGui::ColorEdit4("Panels", (float*)&settings.panelColor);
+            ImGui::ColorEdit4("Borders", (float*)&settings.borderColor);
+            ImGui::ColorEdit4("Accent", (float*)&settings.accentColor);
             ImGui::ColorEdit4("Header", (float*)&settings.headerColor);
             ImGui::ColorEdit4("Unity Projects", (float*)&settings.unityProjectColor);
             ImGui::ColorEdit4("Unreal Projects", (float*)&settings.unrealProjectColor);
@@ -313,6 +595,12 @@ void ShowSettingsWindow(UISettings& settings, bool* p_open) {
             ImGui::ColorEdit4("Button Hover", (float*)&settings.buttonHoverColor);
             ImGui::ColorEdit4("Button Active", (float*)&settings.buttonActiveColor);
             ImGui::ColorEdit4("Text", (float*)&settings.textColor);
+            ImGui::ColorEdit4("Errors", (float*)&settings.errorColor);
+            ImGui::ColorEdit4("Warnings", (float*)&settings.warningColor);
+            ImGui::ColorEdit4("Running", (float*)&settings.runningColor);
+            ImGui::ColorEdit4("Close Button", (float*)&settings.closeButtonColor);
+            ImGui::ColorEdit4("Title Button Hover", (float*)&settings.titleButtonHoverColor);
+            ImGui::ColorEdit4("Title Button Active", (float*)&settings.titleButtonActiveColor);
             ImGui::EndTabItem();
         }
 
@@ -343,6 +631,103 @@ void ShowSettingsWindow(UISettings& settings, bool* p_open) {
             ImGui::Checkbox("Group By Type", &settings.groupByType);
             ImGui::SliderInt("Scan Depth", &settings.scanDepth, 1, 10);
             ImGui::Checkbox("Show Scan Progress", &settings.showScanProgress);
+            ImGui::Checkbox("Parallel Scan", &settings.parallelScan);
+            ImGui::SliderInt("Scan Threads (0 = auto)", &settings.scanThreads, 0, 64);
+            ImGui::Combo("Scan Backend", &settings.scanBackend, "Portable\0io_uring (Linux)\0");
+            InputString("Skip Directories", "comma-separated folder names", settings.skipDirectories);
+            ImGui::Checkbox("Use Scan Service", &settings.useScanService);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Show what a running ProjectNavigatorDaemon has found instead of scanning here. "
+                    "Takes effect at the next start; without a service, this instance scans as usual.");
+            }
+            static const std::string defaultServicePath = DefaultScanServicePath();
+            InputString("Service Socket", defaultServicePath.c_str(), settings.scanServicePath);
+            ImGui::Checkbox("Frame Budget Monitor", &settings.frameBudgetMonitor);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Count heap allocations per frame and warn when a frame takes longer than the budget. "
+                    "Results show in the Stats window.");
+            }
+            ImGui::SliderFloat("Frame Budget (ms)", &settings.frameBudgetMs, 1.0f, 50.0f, "%.1f");
+            ImGui::EndTabItem();
+        }
+
+        if (ImGui::BeginTabItem("Project Types")) {
+            ImGui::TextWrapped("A folder is a project when it has every marker of a type; the first type that matches wins. "
+                "Add your own as \"Name: rule, rule, ...\" with dir=NAME, file=NAME or ext=.EXT, and contains=TEXT to "
+                "look for TEXT in the file of the rule before it. Changes apply from the next scan.");
+            static const ProjectTypeRegistry builtIn = ProjectTypeRegistry::BuiltIn();
+            static const std::vector<std::string> builtInSpecs = [] {
+                std::vector<std::string> specs;
+                for (const ProjectTypeDefinition& type : builtIn.Types()) {
+                    specs.push_back(FormatProjectTypeSpec(type));
+                }
+                return specs;
+            }();
+            for (size_t i = 0; i < builtInSpecs.size(); ++i) {
+                ImGui::TextColored(ProjectTypeColor(settings, builtIn.Types()[i].type), "%s", builtInSpecs[i].c_str());
+            }
+            ImGui::Separator();
+            // Checked in order against everything before them, as ToProjectTypes
+            // adds them; only again after an edit, not every frame
+            static std::vector<std::string> checkedSpecs;
+            static std::vector<std::string> specErrors;
+            if (checkedSpecs != settings.customProjectTypes) {
+                checkedSpecs = settings.customProjectTypes;
+                specErrors.assign(checkedSpecs.size(), std::string());
+                ProjectTypeRegistry checked = builtIn;
+                for (size_t i = 0; i < checkedSpecs.size(); ++i) {
+                    checked.AddCustom(checkedSpecs[i], specErrors[i]);
+                }
+            }
+            for (size_t i = 0; i < settings.customProjectTypes.size(); ++i) {
+                ImGui::PushID((int)i);
+                ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x - 70);
+                InputString("##Spec", "Name: file=NAME, dir=NAME, ext=.EXT, contains=TEXT", settings.customProjectTypes[i]);
+                ImGui::SameLine();
+                bool remove = ImGui::Button("Remove");
+                if (i < specErrors.size() && !specErrors[i].empty()) {
+                    ImGui::TextColored(settings.errorColor, "%s", specErrors[i].c_str());
+                }
+                ImGui::PopID();
+                if (remove) {
+                    settings.customProjectTypes.erase(settings.customProjectTypes.begin() + i);
+                    break;
+                }
+            }
+            if (ImGui::Button("Add Project Type")) {
+                settings.customProjectTypes.emplace_back();
+            }
+            ImGui::EndTabItem();
+        }
+
+        if (ImGui::BeginTabItem("Editors")) {
+            ImGui::TextWrapped("Editors installed through the Unity Hub or the Epic Games launcher are found on their own. "
+                "Add one here for other install locations; leave the version empty to use it for any version without its own entry.");
+            for (size_t i = 0; i < settings.editors.size(); ++i) {
+                EditorSetting& editor = settings.editors[i];
+                ImGui::PushID((int)i);
+                int engine = editor.engine == ProjectType::Unreal ? 1 : 0;
+                ImGui::SetNextItemWidth(90);
+                if (ImGui::Combo("##Engine", &engine, "Unity\0Unreal\0")) {
+                    editor.engine = engine == 1 ? ProjectType::Unreal : ProjectType::Unity;
+                }
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(110);
+                InputString("##Version", "any version", editor.version);
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x - 70);
+                InputString("##Path", "editor executable", editor.path);
+                ImGui::SameLine();
+                bool remove = ImGui::Button("Remove");
+                ImGui::PopID();
+                if (remove) {
+                    settings.editors.erase(settings.editors.begin() + i);
+                    break;
+                }
+            }
+            if (ImGui::Button("Add Editor")) {
+                settings.editors.emplace_back();
+            }
             ImGui::EndTabItem();
         }
 
@@ -352,19 +737,544 @@ void ShowSettingsWindow(UISettings& settings, bool* p_open) {
     ImGui::Separator();
     if (ImGui::Button("Apply")) {
         ApplySettings(settings);
-        SaveSettings(settings);
+        applied = true;
     }
     ImGui::SameLine();
     if (ImGui::Button("Reset to Defaults")) {
         settings = UISettings();
         ApplySettings(settings);
-        SaveSettings(settings);
+        applied = true;
+    }
+
+    ImGui::End();
+    return applied;
+}
+
+// Editable copy of the workspace roots; ImGui needs a char buffer per field.
+struct RootRow {
+    char path[512] = "";
+    int threads = 0; // 0 = the scan thread setting
+};
+
+std::vector<RootRow> ToRootRows(const std::vector<ScanRoot>& roots) {
+    std::vector<RootRow> rows(roots.size());
+    for (size_t i = 0; i < roots.size(); ++i) {
+        strncpy(rows[i].path, roots[i].path.c_str(), sizeof(rows[i].path) - 1);
+        rows[i].threads = (int)roots[i].threadCount;
+    }
+    return rows;
+}
+
+void AddRecentRoot(std::vector<std::string>& recentRoots, const std::string& path) {
+    recentRoots.erase(std::remove(recentRoots.begin(), recentRoots.end(), path), recentRoots.end());
+    recentRoots.insert(recentRoots.begin(), path);
+    if (recentRoots.size() > kMaxRecentRoots) {
+        recentRoots.resize(kMaxRecentRoots);
+    }
+}
+
+// Copies the window's position and size into settings. A minimized or
+// maximized window is left out, so the next start restores the normal one.
+bool CaptureWindowGeometry(GLFWwindow* window, UISettings& settings) {
+    if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) || glfwGetWindowAttrib(window, GLFW_MAXIMIZED)) {
+        return false;
+    }
+    int x = 0, y = 0, width = 0, height = 0;
+    glfwGetWindowPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    ImVec2 position((float)x, (float)y);
+    ImVec2 size((float)width, (float)height);
+    if (position.x == settings.windowPosition.x && position.y == settings.windowPosition.y &&
+        size.x == settings.windowSize.x && size.y == settings.windowSize.y) {
+        return false;
+    }
+    settings.windowPosition = position;
+    settings.windowSize = size;
+    return true;
+}
+
+// Blank rows are left out.
+std::vector<ScanRoot> ToScanRoots(const std::vector<RootRow>& rows) {
+    std::vector<ScanRoot> roots;
+    for (const RootRow& row : rows) {
+        if (row.path[0]) {
+            roots.push_back({ row.path, (unsigned)std::max(row.threads, 0) });
+        }
+    }
+    return roots;
+}
+
+bool SameRoots(const std::vector<ScanRoot>& a, const std::vector<ScanRoot>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].path != b[i].path || a[i].threadCount != b[i].threadCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Rows of each project panel as indices into the project list. They come from
+// the search index's precomputed orderings and are only rebuilt when the list,
+// the filter or the sort/group settings change, never re-sorted per frame.
+struct ProjectPanels {
+    ProjectSearch search;
+    std::vector<ProjectSearch::Match> matches;
+    std::vector<std::vector<uint32_t>> byType = std::vector<std::vector<uint32_t>>(256); // by ProjectType value
+    std::vector<uint32_t> all; // used when not grouping by type
+    std::string filter;
+    bool matchesCurrent = false;
+    bool rowsCurrent = false;
+    bool sortByName = false;
+    bool groupByType = true;
+    size_t rowCount = 0; // projects reflected in the rows
+
+    // Call after anything other than appending changes the list (reorder, removal, swap).
+    void Invalidate() {
+        search.Clear();
+        matchesCurrent = false;
+        rowsCurrent = false;
+    }
+
+    void Update(const ProjectStore& projects, const char* newFilter, bool newSortByName, bool newGroupByType) {
+        if (projects.Size() < search.Indexed()) {
+            Invalidate();
+        }
+        size_t indexed = search.Indexed();
+        search.Update(projects);
+        bool grew = search.Indexed() != indexed;
+
+        if (!matchesCurrent || filter != newFilter) {
+            filter = newFilter;
+            matches.clear();
+            if (!filter.empty()) {
+                search.Find(projects, filter, matches);
+            }
+            matchesCurrent = true;
+            rowsCurrent = false;
+        } else if (grew && !filter.empty()) {
+            search.Extend(projects, filter, indexed, matches);
+            rowsCurrent = false;
+        } else if (grew && sortByName) {
+            rowsCurrent = false; // new names land anywhere in the order
+        }
+        if (sortByName != newSortByName || groupByType != newGroupByType) {
+            sortByName = newSortByName;
+            groupByType = newGroupByType;
+            rowsCurrent = false;
+        }
+
+        // Unfiltered scan order only ever grows at the end
+        bool appendOnly = rowsCurrent && filter.empty() && !sortByName;
+        if (rowsCurrent && !appendOnly) {
+            return;
+        }
+        if (!rowsCurrent) {
+            for (std::vector<uint32_t>& rows : byType) {
+                rows.clear();
+            }
+            all.clear();
+            rowCount = 0;
+        }
+        auto add = [&](uint32_t project) {
+            if (!groupByType) {
+                all.push_back(project);
+            } else {
+                byType[(uint8_t)projects.Type(project)].push_back(project);
+            }
+        };
+        if (!filter.empty()) {
+            for (const ProjectSearch::Match& match : matches) {
+                add(match.project);
+            }
+        } else if (sortByName) {
+            for (uint32_t project : search.ByName()) {
+                add(project);
+            }
+        } else {
+            for (size_t project = rowCount; project < projects.Size(); ++project) {
+                add((uint32_t)project);
+            }
+        }
+        rowCount = projects.Size();
+        rowsCurrent = true;
+    }
+};
+
+// Decides when the main loop draws. With nothing going on it sleeps in
+// glfwWaitEventsTimeout; input, window events and the glfwPostEmptyEvent sent by
+// the scan and watcher threads wake it, and a few frames follow each wake so
+// hover and click state can settle. While active (a scan is running) it draws
+// every frame at the vsync rate; with only background work going on (refresh)
+// it redraws once per idle timeout, which is enough for a progress readout.
+struct FrameScheduler {
+    static constexpr double kIdleTimeout = 1.0;  // seconds
+    static constexpr double kCaretTimeout = 0.5; // keeps a focused text field's caret blinking
+    static constexpr int kFramesAfterWake = 3;
+
+    int framesLeft = kFramesAfterWake;
+
+    // Returns once there may be something to draw; false means the frame can be skipped.
+    bool Wait(bool active, bool refresh) {
+        if (active || framesLeft > 0) {
+            glfwPollEvents();
+            framesLeft = active ? kFramesAfterWake : framesLeft - 1;
+            return true;
+        }
+        bool typing = ImGui::GetIO().WantTextInput;
+        double timeout = typing ? kCaretTimeout : kIdleTimeout;
+        double start = glfwGetTime();
+        glfwWaitEventsTimeout(timeout);
+        if (glfwGetTime() - start < timeout) {
+            framesLeft = kFramesAfterWake - 1; // woken by an event
+            return true;
+        }
+        return typing || refresh;
+    }
+
+    // Something changed outside of input; draw it.
+    void Wake() {
+        framesLeft = kFramesAfterWake;
+    }
+};
+
+// Recent frame times for the Stats window, oldest first once full.
+struct FrameHistory {
+    static constexpr int kFrames = 240;
+
+    float cpuMs[kFrames] = {};
+    float wallMs[kFrames] = {};
+    int next = 0;
+    int count = 0;
+
+    void Add(float cpu, float wall) {
+        cpuMs[next] = cpu;
+        wallMs[next] = wall;
+        next = (next + 1) % kFrames;
+        count = std::min(count + 1, kFrames);
+    }
+
+    int Offset() const { return count < kFrames ? 0 : next; }
+};
+
+// The frame budget monitor (UISettings::frameBudgetMonitor): heap allocations
+// and CPU time per frame. Once the UI has settled a frame should allocate
+// nothing and stay inside frameBudgetMs; frames that don't are counted, and
+// over-budget ones are reported on stderr at most once a second.
+struct FrameBudget {
+    uint64_t frames = 0;
+    uint64_t allocations = 0; // in the last frame
+    uint64_t maxAllocations = 0;
+    uint64_t allocatingFrames = 0;
+    uint64_t overBudget = 0;
+    float cpuMs = 0.0f; // of the last frame
+    float worstCpuMs = 0.0f;
+    double lastWarning = 0.0;
+
+    void Add(uint64_t frameAllocations, float frameCpuMs, float budgetMs, double now) {
+        ++frames;
+        allocations = frameAllocations;
+        maxAllocations = std::max(maxAllocations, frameAllocations);
+        allocatingFrames += frameAllocations > 0;
+        cpuMs = frameCpuMs;
+        worstCpuMs = std::max(worstCpuMs, frameCpuMs);
+        if (frameCpuMs <= budgetMs) {
+            return;
+        }
+        ++overBudget;
+        if (now - lastWarning >= 1.0) {
+            lastWarning = now;
+            fprintf(stderr, "Frame took %.2f ms of CPU, over the %.1f ms budget (%llu allocations)\n", frameCpuMs,
+                budgetMs, (unsigned long long)frameAllocations);
+        }
+    }
+
+    void Reset() { *this = FrameBudget(); }
+};
+
+void ShowStatsWindow(bool* p_open, const UISettings& settings, const FrameHistory& frames, FrameBudget& budget,
+    const StartupTimer& startup, const std::string& tracePath) {
+    if (!ImGui::Begin("Stats", p_open)) {
+        ImGui::End();
+        return;
     }
+    static std::string exportStatus;
 
+    bool recording = TracingEnabled();
+    if (ImGui::Checkbox("Record", &recording)) {
+        SetTracing(recording);
+    }
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Time scans, size walks and frames. Costs next to nothing while off.");
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+        ClearTrace();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export Trace")) {
+        std::string error;
+        exportStatus = WriteChromeTrace(tracePath, error) ? "Wrote " + tracePath : error;
+    }
+    if (!exportStatus.empty()) {
+        ImGui::TextDisabled("%s", exportStatus.c_str());
+    }
+    if (!recording) {
+        ImGui::TextDisabled("Recording is off.");
+    }
+
+    ImGui::Separator();
+    ImGui::Text("Startup took %.1f ms", startup.ElapsedMicros() / 1000.0);
+    for (const StartupTimer::Phase& phase : startup.Phases()) {
+        ImGui::TextDisabled("%-18s at %7.1f ms  took %7.1f ms", phase.name, phase.startMicros / 1000.0,
+            phase.micros / 1000.0);
+    }
+
+    if (settings.frameBudgetMonitor) {
+        ImGui::Separator();
+        ImGui::Text("Frame budget %.1f ms: %llu of %llu frames over, worst %.2f ms", settings.frameBudgetMs,
+            (unsigned long long)budget.overBudget, (unsigned long long)budget.frames, budget.worstCpuMs);
+        const ImVec4& color = budget.allocations > 0 ? settings.warningColor : ImGui::GetStyle().Colors[ImGuiCol_Text];
+        ImGui::TextColored(color, "Allocations: %llu last frame, at most %llu, in %llu frames",
+            (unsigned long long)budget.allocations, (unsigned long long)budget.maxAllocations,
+            (unsigned long long)budget.allocatingFrames);
+#ifndef PROJECTNAVIGATOR_ALLOC_COUNTING
+        ImGui::TextDisabled("Only ImGui's allocations are counted; build with PROJECTNAVIGATOR_ALLOC_COUNTING for all.");
+#endif
+        if (budget.cpuMs > settings.frameBudgetMs) {
+            ImGui::TextColored(settings.warningColor, "Last frame took %.2f ms of CPU", budget.cpuMs);
+        }
+        if (ImGui::Button("Reset Budget")) {
+            budget.Reset();
+        }
+    }
+
+    ImGui::Separator();
+    if (frames.count > 0) {
+        int last = (frames.next + FrameHistory::kFrames - 1) % FrameHistory::kFrames;
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "CPU %.2f ms, wall %.2f ms", frames.cpuMs[last], frames.wallMs[last]);
+        ImGui::PlotLines("Frame CPU", frames.cpuMs, frames.count, frames.Offset(), overlay, 0.0f, FLT_MAX,
+            ImVec2(0, 60));
+    }
+
+    // Per-second rates, refreshed twice a second so they can be read
+    static uint64_t lastValues[(size_t)TraceCounter::Count] = {};
+    static double rates[(size_t)TraceCounter::Count] = {};
+    static double lastTime = 0.0;
+    double now = ImGui::GetTime();
+    bool refreshRates = now - lastTime >= 0.5;
+    for (size_t i = 0; i < (size_t)TraceCounter::Count; ++i) {
+        uint64_t value = TraceCounterValue((TraceCounter)i);
+        if (refreshRates) {
+            rates[i] = value >= lastValues[i] && lastTime > 0.0 ? (value - lastValues[i]) / (now - lastTime) : 0.0;
+            lastValues[i] = value;
+        }
+        ImGui::Text("%-18s %12llu  %10.0f/s", TraceCounterName((TraceCounter)i), (unsigned long long)value, rates[i]);
+    }
+    if (refreshRates) {
+        lastTime = now;
+    }
+
+    ImGui::Separator();
+    if (ImGui::BeginTable("TraceSites", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("Timer");
+        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("Mean");
+        ImGui::TableSetupColumn("Max");
+        ImGui::TableSetupColumn("Histogram (log2 us)");
+        ImGui::TableHeadersRow();
+        static std::vector<TraceSite*> sites; // reused every frame
+        TraceSites(sites);
+        for (TraceSite* site : sites) {
+            TraceSite::Stats stats = site->Snapshot();
+            if (stats.count == 0) {
+                continue;
+            }
+            float buckets[TraceSite::kBuckets];
+            int used = 8;
+            for (int b = 0; b < TraceSite::kBuckets; ++b) {
+                buckets[b] = (float)stats.buckets[b];
+                if (stats.buckets[b]) {
+                    used = std::max(used, b + 1);
+                }
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(site->Name());
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)stats.count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f us", (double)stats.totalMicros / stats.count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu us", (unsigned long long)stats.maxMicros);
+            ImGui::TableNextColumn();
+            ImGui::PushID(site);
+            ImGui::PlotHistogram("##Histogram", buckets, used, 0, nullptr, 0.0f, FLT_MAX, ImVec2(-1, 24));
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Bar i counts runs that took 2^i to 2^(i+1) microseconds");
+            }
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
     ImGui::End();
 }
 
-void ImGuiCustomTitleBar(GLFWwindow* window, bool* p_open) {
+
+void FormatSize(uint64_t bytes, char* out, size_t outSize) {
+    const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+    double size = (double)bytes;
+    int unit = 0;
+    while (size >= 1024.0 && unit < 4) {
+        size /= 1024.0;
+        ++unit;
+    }
+    snprintf(out, outSize, unit == 0 ? "%.0f %s" : "%.1f %s", size, units[unit]);
+}
+
+// "version  size  date", or an empty string while nothing is known yet.
+void FormatProjectDetails(const ProjectMetadata* metadata, char* out, size_t outSize) {
+    out[0] = '\0';
+    if (!metadata) {
+        return;
+    }
+    char size[32];
+    FormatSize(metadata->size.total.allocatedBytes, size, sizeof(size));
+    char date[32] = "";
+    time_t modified = (time_t)metadata->size.total.modified;
+    if (const tm* local = localtime(&modified)) {
+        strftime(date, sizeof(date), "%Y-%m-%d", local);
+    }
+    snprintf(out, outSize, "%s%s%s  %s", metadata->engineVersion.c_str(), metadata->engineVersion.empty() ? "" : "  ",
+        size, date);
+}
+
+// Where a project's disk space goes, largest top-level folder first.
+void ShowSizeTooltip(const SizeReport& size) {
+    char allocated[32];
+    char apparent[32];
+    ImGui::BeginTooltip();
+    FormatSize(size.total.allocatedBytes, allocated, sizeof(allocated));
+    FormatSize(size.total.apparentBytes, apparent, sizeof(apparent));
+    ImGui::Text("%s on disk, %s apparent, %llu files", allocated, apparent, (unsigned long long)size.total.files);
+    ImGui::Separator();
+    for (const FolderSize& folder : size.folders) {
+        FormatSize(folder.size.allocatedBytes, allocated, sizeof(allocated));
+        FormatSize(folder.size.apparentBytes, apparent, sizeof(apparent));
+        ImGui::Text("%-24s %10s  (%s apparent)", folder.name.c_str(), allocated, apparent);
+    }
+    if (size.errors) {
+        ImGui::TextDisabled("%llu entries couldn't be read", (unsigned long long)size.errors);
+    }
+    ImGui::EndTooltip();
+}
+
+// Draws one project panel. Only the rows scrolled into view are submitted, so
+// the cost per frame depends on the panel height, not on the number of projects.
+// Metadata is asked for as rows are drawn, visible rows first, and a few rows
+// either side are queued behind them so scrolling finds them ready.
+void DrawProjectPanel(const UISettings& settings, const char* id, const char* title, const char* emptyText,
+    const ImVec4& titleColor, const ProjectStore& projects, const std::vector<uint32_t>& rows, float panelWidth, MetadataPipeline& metadata,
+    ProjectLauncher& launcher) {
+    TRACE_SCOPE("DrawProjectPanel");
+    const int kPrefetchRows = 20;
+    static std::string path; // reused, so looking up a row's metadata doesn't allocate
+    ImGui::BeginChild(id, ImVec2(panelWidth, 0), true, ImGuiWindowFlags_None);
+    ImGui::TextColored(titleColor, "%s", title);
+    ImGui::Separator();
+    if (rows.empty()) {
+        ImGui::TextDisabled("%s", emptyText);
+    }
+
+    auto lookup = [&](uint32_t index, bool urgent) {
+        path.clear();
+        projects.AppendPath(index, path);
+        return metadata.Get(path, projects.Type(index), urgent);
+    };
+
+    ImGuiListClipper clipper;
+    clipper.Begin((int)rows.size());
+    int shownStart = (int)rows.size();
+    int shownEnd = 0;
+    while (clipper.Step()) {
+        shownStart = std::min(shownStart, clipper.DisplayStart);
+        shownEnd = std::max(shownEnd, clipper.DisplayEnd);
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            uint32_t index = rows[row];
+            // The project index is a stable ID, so no label strings are built per row
+            ImGui::PushID((int)index);
+            const ProjectMetadata* known = lookup(index, true);
+            ProjectType type = projects.Type(index);
+            // Launches happen on the launcher's thread; nothing here waits on them
+            // Not again while it is open or still starting: that would start a second editor on it
+            bool busy = launcher.IsOpen(path) || launcher.IsStarting(path);
+            auto openInEditor = [&] {
+                if (!busy) {
+                    launcher.OpenInEditor(path, type, known ? known->engineVersion : std::string());
+                }
+            };
+            ImGui::PushStyleColor(ImGuiCol_Text, ProjectTypeColor(settings, type));
+            if (ImGui::Selectable(projects.Name(index).data(), false, ImGuiSelectableFlags_AllowDoubleClick, ImVec2(panelWidth - 80, 0))) {
+                if (ImGui::IsMouseDoubleClicked(0)) {
+                    openInEditor();
+                }
+            }
+            ImGui::PopStyleColor();
+            if (ImGui::BeginPopupContextItem("RowMenu")) {
+                if (ImGui::MenuItem("Open in Editor", nullptr, false, !busy)) {
+                    openInEditor();
+                }
+                if (ImGui::MenuItem("Show in Folder")) {
+                    launcher.OpenFolder(path);
+                }
+                if (ImGui::MenuItem("Copy Path")) {
+                    ImGui::SetClipboardText(path.c_str());
+                }
+                ImGui::EndPopup();
+            }
+            char details[128];
+            FormatProjectDetails(known, details, sizeof(details));
+            uint64_t measured = 0;
+            if (!details[0] && metadata.Measuring(path, measured)) {
+                char size[32];
+                FormatSize(measured, size, sizeof(size));
+                snprintf(details, sizeof(details), "measuring... %s", size);
+            }
+            if (details[0]) {
+                ImGui::SameLine(panelWidth - 88 - ImGui::CalcTextSize(details).x);
+                ImGui::TextDisabled("%s", details);
+                if (known && ImGui::IsItemHovered()) {
+                    ShowSizeTooltip(known->size);
+                }
+            }
+            ImGui::SameLine(panelWidth - 72);
+            if (launcher.IsOpen(path)) {
+                ImGui::TextColored(settings.runningColor, "Running");
+            } else if (launcher.IsStarting(path)) {
+                ImGui::TextDisabled("Starting");
+            } else if (ImGui::Button("Open", ImVec2(60, 0))) {
+                openInEditor();
+            }
+            ImGui::PopID();
+        }
+    }
+    clipper.End();
+    for (int row = shownEnd; row < std::min((int)rows.size(), shownEnd + kPrefetchRows); ++row) {
+        lookup(rows[row], false);
+    }
+    for (int row = std::max(0, shownStart - kPrefetchRows); row < shownStart; ++row) {
+        lookup(rows[row], false);
+    }
+    ImGui::EndChild();
+}
+
+void ImGuiCustomTitleBar(GLFWwindow* window, const UISettings& settings, bool* p_open) {
     ImGui::SetNextWindowPos(ImVec2(0, 0));
     ImGui::SetNextWindowSize(ImVec2(ImGui::GetIO().DisplaySize.x, 36));
     ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
@@ -394,8 +1304,8 @@ void ImGuiCustomTitleBar(GLFWwindow* window, bool* p_open) {
     // Minimize and Close buttons (right side)
     ImGui::SetCursorPos(ImVec2(ImGui::GetWindowWidth() - btnPad - btnSize * 2, 6));
     ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0,0,0,0));
-    ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.2f,0.2f,0.2f,0.5f));
-    ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.3f,0.3f,0.3f,0.7f));
+    ImGui::PushStyleColor(ImGuiCol_ButtonHovered, settings.titleButtonHoverColor);
+    ImGui::PushStyleColor(ImGuiCol_ButtonActive, settings.titleButtonActiveColor);
     if (ImGui::Button("\xef\x81\xb2##minimize", ImVec2(btnSize, btnSize))) {
 #ifdef _WIN32
         HWND hwnd = glfwGetWin32Window(window);
@@ -405,7 +1315,7 @@ void ImGuiCustomTitleBar(GLFWwindow* window, bool* p_open) {
     bool hoveringButtons = ImGui::IsItemHovered();
     ImGui::SameLine(0, 4);
     ImGui::SetCursorPosY(6);
-    ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.9f,0.2f,0.2f,1.0f));
+    ImGui::PushStyleColor(ImGuiCol_Text, settings.closeButtonColor);
     if (ImGui::Button("\xef\x80\x8d##close", ImVec2(btnSize, btnSize))) {
         if (p_open) *p_open = false;
 #ifdef _WIN32
@@ -447,30 +1357,68 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 int main()
 #endif
 {
+    // Startup is staged so the first frame is up as soon as possible: the config
+    // is read while GLFW starts, the last scan's results while the window and
+    // ImGui are set up, and everything the first frame doesn't need (the scan,
+    // the editor paths) waits until it has been drawn.
+    static StartupTimer startup;
+    std::future<LoadedConfig> configLoad = std::async(std::launch::async, LoadConfig);
     glfwInit();
 #ifdef _WIN32
     // Remove the GLFW_DECORATED hint to allow window resizing
     // glfwWindowHint(GLFW_DECORATED, GLFW_FALSE);
 #endif
-    GLFWwindow* window = glfwCreateWindow(1280, 720, "Project Navigator", nullptr, nullptr);
+    startup.Mark("glfwInit");
+    LoadedConfig config = configLoad.get();
+    startup.Mark("config wait");
+    const std::string& configPath = config.configPath;
+    UISettings& settings = config.settings;
+    UISettings appliedSettings = settings; // what gets saved: unapplied edits in the Settings window aren't
+    AppState& appState = config.state;
+    // Before anything is scanned or a cached project's type is named
+    SetProjectTypes(ToProjectTypes(settings));
+    std::shared_ptr<const ProjectMatcher> projectTypes = CurrentProjectTypes();
+
+    static ScanEngine scanEngine;
+    static MetadataPipeline metadata;
+    std::future<CachedResults> cachedLoad = std::async(std::launch::async, LoadCachedResults,
+        std::ref(scanEngine), std::ref(metadata), configPath, appState.roots);
+
+    int windowWidth = 1280, windowHeight = 720;
+    if (settings.rememberWindowSize && settings.windowSize.x >= 1 && settings.windowSize.y >= 1) {
+        windowWidth = (int)settings.windowSize.x;
+        windowHeight = (int)settings.windowSize.y;
+    }
+    // Hidden until the first frame has been drawn, so it never shows up blank
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "Project Navigator", nullptr, nullptr);
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1);
 
-    // Center the window on screen
+    if (settings.rememberWindowPosition && appState.windowPlaced) {
+        glfwSetWindowPos(window, (int)settings.windowPosition.x, (int)settings.windowPosition.y);
+    } else {
+        // Center the window on screen
 #ifdef _WIN32
-    HWND hwnd = glfwGetWin32Window(window);
-    RECT rect;
-    GetWindowRect(hwnd, &rect);
-    int winWidth = rect.right - rect.left;
-    int winHeight = rect.bottom - rect.top;
-    int screenWidth = GetSystemMetrics(SM_CXSCREEN);
-    int screenHeight = GetSystemMetrics(SM_CYSCREEN);
-    int x = (screenWidth - winWidth) / 2;
-    int y = (screenHeight - winHeight) / 2;
-    SetWindowPos(hwnd, nullptr, x, y, 0, 0, SWP_NOSIZE | SWP_NOZORDER);
+        HWND hwnd = glfwGetWin32Window(window);
+        RECT rect;
+        GetWindowRect(hwnd, &rect);
+        int winWidth = rect.right - rect.left;
+        int winHeight = rect.bottom - rect.top;
+        int screenWidth = GetSystemMetrics(SM_CXSCREEN);
+        int screenHeight = GetSystemMetrics(SM_CYSCREEN);
+        int x = (screenWidth - winWidth) / 2;
+        int y = (screenHeight - winHeight) / 2;
+        SetWindowPos(hwnd, nullptr, x, y, 0, 0, SWP_NOSIZE | SWP_NOZORDER);
 #endif
+    }
+    // Installed before ImGui's, which chains to them
+    glfwSetWindowPosCallback(window, [](GLFWwindow*, int, int) { g_windowGeometryChanged = true; });
+    glfwSetWindowSizeCallback(window, [](GLFWwindow*, int, int) { g_windowGeometryChanged = true; });
+    startup.Mark("window");
 
     IMGUI_CHECKVERSION();
+    ImGui::SetAllocatorFunctions(CountedImGuiAllocate, ImGuiFree);
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
     io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
@@ -478,37 +1426,258 @@ int main()
 
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 130");
+    ApplySettings(settings);
+    startup.Mark("imgui");
 
-    // Load the last used directory
-    std::string lastDirectory = LoadLastDirectory();
-    static char dirBuffer[512];
-    strncpy(dirBuffer, lastDirectory.c_str(), sizeof(dirBuffer) - 1);
-    dirBuffer[sizeof(dirBuffer) - 1] = '\0';
+    // Load the workspace roots used last time
+    static std::vector<RootRow> rootRows = ToRootRows(appState.roots);
+    static std::vector<RootScanResult> rootResults; // of the last scan, in scanEngine.Roots() order
 
-    static std::vector<ProjectInfo> projects;
+    static ProjectStore projects;
+    static ProjectStore rescannedProjects; // fills up behind a cached list
+    static bool showingCached = false;
     static bool scanned = false;
     static std::string scanError;
+    static std::vector<ScanFailure> scanFailures; // folders the last scan skipped
+    static size_t scanFailureCount = 0;
+    static bool showScanFailures = false;
     static bool windowOpen = true;
+    static FrameHistory frameHistory;
+    static FrameBudget frameBudget;
+    static TraceSite frameSite("Frame");
+    static TraceSite frameCpuSite("Frame CPU");
+    static std::vector<std::unique_ptr<ProjectWatcher>> projectWatchers; // one per root
+    static ProjectPanels panels;
+    static ProjectLauncher launcher;
+    static ScanServiceClient scanService; // connected when settings.useScanService and a service answers
+    static bool usingService = false;
+    static std::vector<std::string> serviceRoots; // the service's workspace
+    static char filterBuffer[256] = "";
+    strncpy(filterBuffer, appState.filter.c_str(), sizeof(filterBuffer) - 1);
 
-    // Perform initial scan
-    try {
-        projects = ScanForProjects(dirBuffer);
+    // Settings and state go out through a background writer, which folds a burst of saves into one write
+    static BackgroundWriter configWriter;
+    auto saveConfig = [&]() {
+        if (configPath.empty()) {
+            return;
+        }
+        appState.roots = ToScanRoots(rootRows);
+        appState.filter = filterBuffer;
+        configWriter.Save(configPath + ".cfg", EncodeConfig(appliedSettings, appState));
+    };
+    if (config.migrated) {
+        saveConfig();
+    }
+
+    // Show the results of the last completed scan straight away; a rescan then
+    // only re-lists directories that changed since
+    {
+        CachedResults cached = cachedLoad.get();
+        startup.Mark("cache wait");
+        startup.Add("load cache", cached.startMicros, cached.micros);
+        projects.Swap(cached.projects);
+        showingCached = cached.indexed;
+    }
+
+    auto scanOptionsFromSettings = [&]() {
+        ScanOptions options;
+        options.parallel = settings.parallelScan;
+        options.threadCount = (unsigned)std::max(settings.scanThreads, 0);
+        options.backend = settings.scanBackend == 1 ? ScanBackend::IoUring : ScanBackend::Portable;
+        options.maxDepth = settings.scanDepth;
+        options.skipDirectories = ParseNameList(settings.skipDirectories);
+        return options;
+    };
+    static ScanOptions lastScanOptions;
+
+    auto startScan = [&]() {
+        // The service's workspace is the service's to scan
+        if (usingService) {
+            scanService.RequestRescan();
+            return;
+        }
+        projectWatchers.clear();
+        std::vector<ScanRoot> roots = ToScanRoots(rootRows);
+        for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+            AddRecentRoot(appState.recentRoots, it->path);
+        }
+        saveConfig();
+        // A rescan of indexed roots keeps the current list up until it completes
+        showingCached = false;
+        for (const ScanRoot& root : roots) {
+            showingCached = showingCached || scanEngine.Index(root.path) != nullptr;
+        }
+        if (!showingCached) {
+            projects.Clear();
+            panels.Invalidate();
+        }
+        rescannedProjects.Clear();
         scanError.clear();
-        scanned = true;
-    } catch (const std::exception& e) {
-        scanError = e.what();
+        scanFailures.clear();
+        scanFailureCount = 0;
         scanned = false;
-    }
+        lastScanOptions = scanOptionsFromSettings();
+        scanEngine.Start(roots, lastScanOptions);
+    };
+
+    // From here on each root that scanned cleanly is kept current by filesystem events instead of rescans
+    auto startWatchers = [&](const std::vector<RootScanResult>& results) {
+        projectWatchers.clear();
+        const std::vector<ScanRoot>& roots = scanEngine.Roots();
+        for (size_t i = 0; i < roots.size() && i < results.size(); ++i) {
+            std::shared_ptr<const ScanIndex> index = scanEngine.Index(roots[i].path);
+            if (!results[i].error.empty() || results[i].cancelled || !index) {
+                continue;
+            }
+            auto watcher = std::make_unique<ProjectWatcher>();
+            watcher->SetChangesCallback([] { glfwPostEmptyEvent(); });
+            watcher->Start(roots[i].path, lastScanOptions, index);
+            projectWatchers.push_back(std::move(watcher));
+        }
+    };
 
+    // Worker threads wake the main loop when they have something for it
+    scanEngine.SetResultsCallback([] { glfwPostEmptyEvent(); });
+    metadata.SetResultsCallback([] { glfwPostEmptyEvent(); });
+    launcher.SetResultsCallback([] { glfwPostEmptyEvent(); });
+    scanService.SetChangesCallback([] { glfwPostEmptyEvent(); });
+
+    // Runs once the first frame is on screen
+    bool started = false;
+    auto finishStartup = [&]() {
+        started = true;
+        glfwShowWindow(window);
+        startup.Mark("first frame");
+        launcher.SetEditorPaths(ToEditorPaths(settings));
+        if (settings.useScanService) {
+            std::string path = settings.scanServicePath.empty() ? DefaultScanServicePath() : settings.scanServicePath;
+            std::string error;
+            usingService = scanService.Connect(path, error);
+            if (!usingService) {
+                scanError = error + "; scanning here instead";
+            }
+            startup.Mark("connect service");
+        }
+        if (usingService) {
+            // Connect() returned with the service's whole list, so it replaces the cached one now
+            showingCached = false;
+        // Without a saved workspace the root is only the default; walking a whole drive unasked would take ages
+        } else if (settings.autoScanOnStart && !config.defaultRoots) {
+            startScan();
+        }
+        startup.Mark("start scan");
+        if (!configPath.empty()) {
+            SaveStartupReport(configWriter, std::filesystem::path(configPath).replace_filename("startup.jsonl").string(),
+                startup);
+        }
+    };
+
+    // Built once: the loop below shouldn't allocate once the UI has settled
+    const std::string tracePath = std::filesystem::path(configPath).replace_filename("trace.json").string();
+    FrameScheduler frames;
     while (!glfwWindowShouldClose(window) && windowOpen) {
-        glfwPollEvents();
+        // A minimized window shows nothing, so even a running scan doesn't need frames
+        bool active = scanEngine.IsRunning() && !glfwGetWindowAttrib(window, GLFW_ICONIFIED);
+        bool draw = frames.Wait(active, metadata.Busy());
+
+        if (usingService) {
+            bool replaced = false;
+            if (scanService.Drain(projects, replaced)) {
+                if (replaced) {
+                    // Its types came with the list
+                    projectTypes = CurrentProjectTypes();
+                    serviceRoots = scanService.Roots();
+                }
+                panels.Invalidate();
+                frames.Wake();
+            }
+            if (!scanService.IsConnected()) {
+                usingService = false;
+                serviceRoots.clear();
+                scanService.Disconnect();
+                SetProjectTypes(ToProjectTypes(settings));
+                projectTypes = CurrentProjectTypes();
+                startScan();
+                scanError = "Lost the scan service; scanning here instead";
+                frames.Wake();
+            }
+        }
+
+        // Pick up whatever the background scan found since the last frame
+        ProjectStore& scanTarget = showingCached ? rescannedProjects : projects;
+        if (scanEngine.Drain(scanTarget)) {
+            frames.Wake();
+        }
+        ScanEngine::Finished finished;
+        if (scanEngine.PollFinished(finished)) {
+            frames.Wake();
+            // Put streamed results back into the order a single-threaded walk produces
+            scanTarget.Reorder(finished.order);
+            if (&scanTarget == &projects) {
+                panels.Invalidate();
+            }
+            scanError = finished.error;
+            scanFailures = std::move(finished.failures);
+            scanFailureCount = finished.failureCount;
+            scanned = scanError.empty() && !finished.cancelled;
+            rootResults = finished.roots;
+            if (showingCached && scanned) {
+                projects.Swap(rescannedProjects);
+                panels.Invalidate();
+                rescannedProjects.Clear();
+                showingCached = false;
+            }
+            if (!finished.cancelled) {
+                startWatchers(finished.roots);
+            }
+        }
+        bool rescan = false;
+        for (auto& watcher : projectWatchers) {
+            ProjectChanges changes;
+            if (watcher->Drain(changes)) {
+                ApplyProjectChanges(projects, changes);
+                panels.Invalidate();
+                frames.Wake();
+            }
+            rescan = watcher->RescanRequested() || rescan;
+        }
+        if (rescan && !scanEngine.IsRunning()) {
+            startScan();
+            frames.Wake();
+        }
+        if (metadata.Drain()) {
+            frames.Wake();
+        }
+        if (launcher.Drain()) {
+            frames.Wake();
+        }
+        if (g_windowGeometryChanged) {
+            g_windowGeometryChanged = false;
+            if (CaptureWindowGeometry(window, appliedSettings)) {
+                settings.windowPosition = appliedSettings.windowPosition;
+                settings.windowSize = appliedSettings.windowSize;
+                appState.windowPlaced = true;
+                saveConfig();
+            }
+        }
+        if (!draw && frames.framesLeft == 0) {
+            continue;
+        }
+
+        // Everything up to the buffer swap, which may block on vsync
+        bool tracing = TracingEnabled();
+        bool monitoring = settings.frameBudgetMonitor;
+        int64_t frameStart = tracing ? TraceNowMicros() : 0;
+        int64_t frameCpuStart = tracing || monitoring ? ThreadCpuMicros() : 0;
+        g_countAllocations.store(monitoring, std::memory_order_relaxed);
+        uint64_t frameAllocationsStart = ThreadAllocations();
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
         // Custom title bar
-        ImGuiCustomTitleBar(window, &windowOpen);
+        ImGuiCustomTitleBar(window, settings, &windowOpen);
 
         // Modern dockspace layout
         ImGui::DockSpaceOverViewport(0, ImGui::GetMainViewport());
@@ -516,108 +1685,262 @@ int main()
         // Main content window
         ImGui::Begin("ProjectNavigatorMain", nullptr, ImGuiWindowFlags_NoCollapse);
 
-        ImGui::Text("Enter the root directory to scan for Unity and Unreal projects:");
-        ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x - 120);
-        ImGui::InputText("##Root Directory", dirBuffer, sizeof(dirBuffer));
-        ImGui::PopItemWidth();
+        bool rootsEdited = false;
+        const std::vector<ScanRoot>& scannedRoots = scanEngine.Roots();
+        if (usingService) {
+            // The service's workspace; it is changed where the service is started
+            ImGui::Text("Projects from the scan service, which watches:");
+            for (const std::string& root : serviceRoots) {
+                ImGui::BulletText("%s", root.c_str());
+            }
+        } else {
+            ImGui::Text("Root directories to scan for projects:");
+        }
+        for (size_t i = 0; i < rootRows.size() && !usingService; ++i) {
+            RootRow& row = rootRows[i];
+            ImGui::PushID((int)i);
+            ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x - 372);
+            ImGui::InputText("##Root Directory", row.path, sizeof(row.path));
+            rootsEdited = ImGui::IsItemDeactivatedAfterEdit() || rootsEdited;
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            ImGui::PushItemWidth(60);
+            ImGui::InputInt("##Threads", &row.threads, 0);
+            rootsEdited = ImGui::IsItemDeactivatedAfterEdit() || rootsEdited;
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Scan threads for this root (0 = Scan Threads setting). Keep network shares low.");
+            }
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            bool remove = ImGui::Button("Remove", ImVec2(70, 0)) && rootRows.size() > 1;
+            // How this root did in the last scan, if it was part of it
+            if (i < scannedRoots.size() && i < rootResults.size() && scannedRoots[i].path == row.path) {
+                const RootScanResult& result = rootResults[i];
+                ImGui::SameLine();
+                if (!result.error.empty()) {
+                    ImGui::TextColored(settings.errorColor, "failed");
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("%s", result.error.c_str());
+                    }
+                } else {
+                    ImGui::TextDisabled("%llu in %.2f s", (unsigned long long)result.projects, result.seconds);
+                }
+            }
+            ImGui::PopID();
+            if (remove) {
+                rootRows.erase(rootRows.begin() + i);
+                rootsEdited = true;
+                break;
+            }
+        }
+        if (!usingService) {
+            if (ImGui::Button("Add Root", ImVec2(80, 0))) {
+                rootRows.emplace_back();
+            }
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(80);
+            if (ImGui::BeginCombo("##Recent", "Recent")) {
+                if (appState.recentRoots.empty()) {
+                    ImGui::TextDisabled("No roots scanned yet");
+                }
+                for (const std::string& path : appState.recentRoots) {
+                    if (ImGui::Selectable(path.c_str())) {
+                        RootRow row;
+                        strncpy(row.path, path.c_str(), sizeof(row.path) - 1);
+                        rootRows.push_back(row);
+                        rootsEdited = true;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::SameLine();
+        }
+        // Editing the workspace while a scan is running restarts it on the new roots
+        if (rootsEdited) {
+            saveConfig();
+            if (scanEngine.IsRunning() && !SameRoots(scanEngine.Roots(), ToScanRoots(rootRows))) {
+                startScan();
+            }
+        }
+        if (ImGui::Button(usingService ? "Rescan" : "Scan for Projects", ImVec2(120, 0))) {
+            startScan();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Settings", ImVec2(80, 0))) {
+            appState.showSettings = true;
+        }
         ImGui::SameLine();
-        if (ImGui::Button("Scan for Projects", ImVec2(120, 0))) {
-            try {
-                projects = ScanForProjects(dirBuffer);
-                scanError.clear();
-                scanned = true;
-                SaveLastDirectory(dirBuffer);
-            } catch (const std::exception& e) {
-                scanError = e.what();
-                scanned = false;
+        if (ImGui::Button("Stats", ImVec2(60, 0))) {
+            appState.showStats = true;
+        }
+        if (scanEngine.IsRunning() && settings.showScanProgress) {
+            ScanEngine::Progress progress = scanEngine.GetProgress();
+            ImGui::Text("Scanning... %llu directories visited, %llu projects found",
+                (unsigned long long)progress.directoriesVisited, (unsigned long long)progress.projectsFound);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("%llu directory listings, %llu entries, %llu stat calls, %llu unreadable",
+                    (unsigned long long)progress.directoriesListed, (unsigned long long)progress.entriesSeen,
+                    (unsigned long long)progress.statCalls, (unsigned long long)progress.directoriesFailed);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel")) {
+                scanEngine.Cancel();
+            }
+        }
+        if (usingService) {
+            static ScanServiceStatus status; // reused every frame
+            scanService.Status(status);
+            if (status.scanning && settings.showScanProgress) {
+                ImGui::Text("The service is scanning... %llu directories visited, %llu projects found",
+                    (unsigned long long)status.directoriesVisited, (unsigned long long)status.projectsFound);
+            }
+            if (!status.error.empty()) {
+                ImGui::TextColored(settings.errorColor, "Service scan error: %s", status.error.c_str());
+            }
+            if (status.foldersSkipped > 0) {
+                ImGui::TextColored(settings.warningColor, "The service skipped %llu folders it couldn't read",
+                    (unsigned long long)status.foldersSkipped);
             }
         }
+        if (showingCached && !scanEngine.IsRunning()) {
+            ImGui::TextDisabled("Showing the results of the last scan");
+        }
         if (!scanError.empty()) {
-            ImGui::TextColored(ImVec4(1,0,0,1), "Error: %s", scanError.c_str());
+            ImGui::TextColored(settings.errorColor, "Error: %s", scanError.c_str());
+        }
+        if (!launcher.LastError().empty()) {
+            ImGui::TextColored(settings.warningColor, "%s", launcher.LastError().c_str());
+        }
+        // Partial failures: everything else was still scanned
+        if (scanFailureCount > 0) {
+            ImGui::TextColored(settings.warningColor, "%zu folders couldn't be read and were skipped", scanFailureCount);
+            ImGui::SameLine();
+            if (ImGui::SmallButton(showScanFailures ? "Hide" : "Details")) {
+                showScanFailures = !showScanFailures;
+            }
+            if (showScanFailures) {
+                ImGui::BeginChild("ScanFailures", ImVec2(0, 120), true);
+                for (const ScanFailure& failure : scanFailures) {
+                    ImGui::TextUnformatted(failure.path.c_str());
+                    ImGui::SameLine();
+                    if (failure.attempts > 1) {
+                        ImGui::TextDisabled("%s (%d attempts)", failure.message.c_str(), failure.attempts);
+                    } else {
+                        ImGui::TextDisabled("%s", failure.message.c_str());
+                    }
+                }
+                if (scanFailureCount > scanFailures.size()) {
+                    ImGui::TextDisabled("...and %zu more", scanFailureCount - scanFailures.size());
+                }
+                ImGui::EndChild();
+            }
         }
         ImGui::Spacing();
         ImGui::Separator();
         ImGui::Spacing();
 
-        // Responsive panels for Unity and Unreal projects
-        float panelWidth = (ImGui::GetContentRegionAvail().x - 24) * 0.5f;
-        ImGui::BeginChild("UnityPanel", ImVec2(panelWidth, 0), true, ImGuiWindowFlags_None);
-        ImGui::TextColored(ImVec4(0.2f, 0.4f, 0.8f, 1.0f), "Unity Projects");
-        ImGui::Separator();
-        bool hasUnityProjects = false;
-        for (const auto& proj : projects) {
-            if (proj.type == "Unity") {
-                hasUnityProjects = true;
-                ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.2f, 0.4f, 0.8f, 1.0f));
-                if (ImGui::Selectable(proj.name.c_str(), false, ImGuiSelectableFlags_AllowDoubleClick, ImVec2(panelWidth - 80, 0))) {
-                    if (ImGui::IsMouseDoubleClicked(0)) {
-#ifdef _WIN32
-                        std::string cmd = "explorer \"" + proj.path + "\"";
-                        system(cmd.c_str());
-#endif
-                    }
-                }
+        ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x);
+        ImGui::InputTextWithHint("##Filter", "Filter projects by name or path", filterBuffer, sizeof(filterBuffer));
+        if (ImGui::IsItemDeactivatedAfterEdit()) {
+            saveConfig();
+        }
+        ImGui::PopItemWidth();
+        ImGui::Spacing();
+
+        // One tab per registered project type
+        panels.Update(projects, filterBuffer, settings.sortProjectsByName, settings.groupByType);
+        const char* emptyText = filterBuffer[0] ? "No matching projects" : nullptr;
+        if (settings.groupByType && ImGui::BeginTabBar("ProjectTypes")) {
+            for (const ProjectTypeDefinition& type : projectTypes->Registry().Types()) {
+                const std::vector<uint32_t>& rows = panels.byType[(uint8_t)type.type];
+                char label[96];
+                snprintf(label, sizeof(label), "%s (%zu)###%s", type.name.c_str(), rows.size(), type.name.c_str());
+                ImGui::PushStyleColor(ImGuiCol_Text, ProjectTypeColor(settings, type.type));
+                bool open = ImGui::BeginTabItem(label);
                 ImGui::PopStyleColor();
-                ImGui::SameLine();
-                std::string btnId = "Open##Unity" + proj.name;
-                if (ImGui::Button(btnId.c_str(), ImVec2(60, 0))) {
-#ifdef _WIN32
-                    std::string cmd = "explorer \"" + proj.path + "\"";
-                    system(cmd.c_str());
-#endif
+                if (!open) {
+                    continue;
                 }
+                char title[80];
+                char empty[96];
+                snprintf(title, sizeof(title), "%s Projects", type.name.c_str());
+                snprintf(empty, sizeof(empty), "No %s projects found", type.name.c_str());
+                DrawProjectPanel(settings, type.name.c_str(), title, emptyText ? emptyText : empty,
+                    ProjectTypeColor(settings, type.type), projects, rows, ImGui::GetContentRegionAvail().x, metadata,
+                    launcher);
+                ImGui::EndTabItem();
             }
+            ImGui::EndTabBar();
+        } else if (!settings.groupByType) {
+            DrawProjectPanel(settings, "ProjectsPanel", "Projects", emptyText ? emptyText : "No projects found",
+                ImGui::GetStyle().Colors[ImGuiCol_Text], projects, panels.all, ImGui::GetContentRegionAvail().x, metadata, launcher);
         }
-        if (!hasUnityProjects) {
-            ImGui::TextDisabled("No Unity projects found");
-        }
-        ImGui::EndChild();
-        ImGui::SameLine(0, 24);
-        ImGui::BeginChild("UnrealPanel", ImVec2(panelWidth, 0), true, ImGuiWindowFlags_None);
-        ImGui::TextColored(ImVec4(0.8f, 0.2f, 0.2f, 1.0f), "Unreal Projects");
-        ImGui::Separator();
-        bool hasUnrealProjects = false;
-        for (const auto& proj : projects) {
-            if (proj.type == "Unreal") {
-                hasUnrealProjects = true;
-                ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.8f, 0.2f, 0.2f, 1.0f));
-                if (ImGui::Selectable(proj.name.c_str(), false, ImGuiSelectableFlags_AllowDoubleClick, ImVec2(panelWidth - 80, 0))) {
-                    if (ImGui::IsMouseDoubleClicked(0)) {
-#ifdef _WIN32
-                        std::string cmd = "explorer \"" + proj.path + "\"";
-                        system(cmd.c_str());
-#endif
-                    }
+
+        ImGui::End(); // ProjectNavigatorMain
+
+        if (appState.showSettings) {
+            if (ShowSettingsWindow(settings, &appState.showSettings)) {
+                launcher.SetEditorPaths(ToEditorPaths(settings));
+                // While connected the types are the service's
+                if (!usingService) {
+                    SetProjectTypes(ToProjectTypes(settings));
+                    projectTypes = CurrentProjectTypes();
                 }
-                ImGui::PopStyleColor();
-                ImGui::SameLine();
-                std::string btnId = "Open##Unreal" + proj.name;
-                if (ImGui::Button(btnId.c_str(), ImVec2(60, 0))) {
-#ifdef _WIN32
-                    std::string cmd = "explorer \"" + proj.path + "\"";
-                    system(cmd.c_str());
-#endif
+                // Window geometry typed into the settings moves the window
+                if (settings.rememberWindowSize && (settings.windowSize.x != appliedSettings.windowSize.x ||
+                        settings.windowSize.y != appliedSettings.windowSize.y)) {
+                    glfwSetWindowSize(window, (int)settings.windowSize.x, (int)settings.windowSize.y);
                 }
+                if (settings.rememberWindowPosition && (settings.windowPosition.x != appliedSettings.windowPosition.x ||
+                        settings.windowPosition.y != appliedSettings.windowPosition.y)) {
+                    glfwSetWindowPos(window, (int)settings.windowPosition.x, (int)settings.windowPosition.y);
+                }
+                appliedSettings = settings;
+                saveConfig();
             }
         }
-        if (!hasUnrealProjects) {
-            ImGui::TextDisabled("No Unreal projects found");
+        if (appState.showStats) {
+            ShowStatsWindow(&appState.showStats, settings, frameHistory, frameBudget, startup, tracePath);
         }
-        ImGui::EndChild();
-
-        ImGui::End(); // ProjectNavigatorMain
 
         ImGui::Render();
         int display_w, display_h;
         glfwGetFramebufferSize(window, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClearColor(settings.windowBgColor.x, settings.windowBgColor.y, settings.windowBgColor.z, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+        if (tracing || monitoring) {
+            int64_t cpu = ThreadCpuMicros() - frameCpuStart;
+            if (tracing) {
+                int64_t wall = TraceNowMicros() - frameStart;
+                frameSite.Record(frameStart, wall);
+                frameCpuSite.AddSample(cpu);
+                frameHistory.Add(cpu / 1000.0f, wall / 1000.0f);
+                SampleTraceCounters();
+            }
+            if (monitoring) {
+                frameBudget.Add(ThreadAllocations() - frameAllocationsStart, cpu / 1000.0f, settings.frameBudgetMs,
+                    ImGui::GetTime());
+            }
+        }
+
         glfwSwapBuffers(window);
+        if (!started) {
+            finishStartup();
+        }
     }
 
+    projectWatchers.clear();
+    scanEngine.Stop();
+    metadata.Stop();
+    launcher.Stop();
+    metadata.SaveCache();
+    // Also keeps which windows were open; the geometry is already current
+    saveConfig();
+    configWriter.Flush();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();